@@ -31,6 +31,9 @@ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLI
 /*
  * MACROS
  */
+#if (GATT_MAX_NUM_CONN > CGM_CONN_MAX)
+#error "The per-connection bitmaps hold CGM_CONN_MAX connections only"
+#endif
 
 /*
  * CONSTANTS
@@ -81,7 +84,8 @@ CONST uint8 CGMSpecificOpsControlPointUUID[ATT_BT_UUID_SIZE] = {LO_UINT16(CGM_SP
  * LOCAL VARIABLES
  */
 static CGMServiceCB_t CGMServiceCB;		///< The variable to register the CGM service callback function @ingroup gattgrp
-static bool	      cgmMeasDBSendInProgress;	///< An variable to indicate whether the RACP transmission is in progress. @ingroup racpgrp
+static uint8	      cgmMeasDBSendInProgress;	///< The connections, one CGM_CONN_BIT each, whose RACP transmission is in progress. @ingroup racpgrp
+static uint8	      cgmMeasSubscribers;	///< The connections, one CGM_CONN_BIT each, with the CGM measurement notification enabled. It mirrors CGMMeasConfig, see CGM_MeasSubscriberSync. @ingroup glucosemeasgrp
 
 /*
  * Profile Attributes - variables
@@ -320,6 +324,7 @@ bStatus_t CGM_AddService( uint32 services )
   GATTServApp_InitCharCfg( INVALID_CONNHANDLE, CGMMeasConfig );
   GATTServApp_InitCharCfg( INVALID_CONNHANDLE, CGMRacpConfig );
   GATTServApp_InitCharCfg( INVALID_CONNHANDLE, CGMControlConfig );
+  cgmMeasSubscribers = 0;
   // Register with Link DB to receive link status change callback
   VOID linkDB_Register( CGM_HandleConnStatusCB );
   if ( services & CGM_SERVICE )
@@ -362,6 +367,35 @@ bStatus_t CGM_MeasSend( uint16 connHandle, attHandleValueNoti_t *pNoti, uint8 ta
   return bleNotReady;
 }
 
+/**
+   @ingroup glucosemeasgrp
+ * @brief       Send one CGM measurement to every subscribed connection of a set.
+ * @details     The notification is built once by the caller and handed unchanged to each link. Only the
+ *              connections in the subscriber bitmap are visited, so no CCC lookup is made per send.
+ * @param       connMask - the connections to send to, one CGM_CONN_BIT each
+ * @param       pNoti - pointer to notification structure
+ * @return      the connections, one CGM_CONN_BIT each, that are subscribed but had no TX buffer left
+ */
+uint8 CGM_MeasBroadcast( uint8 connMask, attHandleValueNoti_t *pNoti )
+{
+  uint8 busy = 0;
+  uint8 bits = connMask & cgmMeasSubscribers;
+  uint8 connHandle;
+  bStatus_t status;
+
+  pNoti->handle = CGMAttrTbl[CGM_MEAS_VALUE_POS].handle;
+  for ( connHandle = 0; bits != 0; connHandle++, bits >>= 1 )
+  {
+    if ( bits & 0x01 )
+    {
+      status = GATT_Notification( connHandle, pNoti, FALSE );
+      if ( CGM_TX_BUSY( status ) )
+        busy |= CGM_CONN_BIT( connHandle );
+    }
+  }
+  return busy;
+}
+
 /**
    @ingroup cgmcpgrp
  * @fn          CGM_CtlPntIndicate
@@ -438,19 +472,19 @@ static uint8 CGM_ReadAttrCB( uint16 connHandle, gattAttribute_t *pAttr,
       // The rest of the cases deal with CGM service specific characteristic read.
       case CGM_FEATURE_UUID:       
         *pLen = CGM_CHAR_VAL_SIZE_FEATURE;
-         (*CGMServiceCB)(CGM_FEATURE_READ_REQUEST, pValue, pLen, (uint8 *)&status );
+         (*CGMServiceCB)(connHandle, CGM_FEATURE_READ_REQUEST, pValue, pLen, (uint8 *)&status );
       break;
      case CGM_STATUS_UUID:
         *pLen = CGM_CHAR_VAL_SIZE_STATUS;
-         (*CGMServiceCB)(CGM_STATUS_READ_REQUEST, pValue, pLen,(uint8 *)&status);
+         (*CGMServiceCB)(connHandle, CGM_STATUS_READ_REQUEST, pValue, pLen,(uint8 *)&status);
          break;
       case CGM_SES_START_TIME_UUID:
         *pLen = CGM_CHAR_VAL_SIZE_START_TIME;
-        (*CGMServiceCB)(CGM_START_TIME_READ_REQUEST, pValue, pLen,(uint8 *)&status);
+        (*CGMServiceCB)(connHandle, CGM_START_TIME_READ_REQUEST, pValue, pLen,(uint8 *)&status);
       break;
       case CGM_SES_RUN_TIME_UUID:
         *pLen = CGM_CHAR_VAL_SIZE_RUN_TIME;
-        (*CGMServiceCB)(CGM_RUN_TIME_READ_REQUEST, pValue, pLen,(uint8 *)&status);
+        (*CGMServiceCB)(connHandle, CGM_RUN_TIME_READ_REQUEST, pValue, pLen,(uint8 *)&status);
       break;
       default:
         // Should never get here! (characteristics 3 and 4 do not have read permissions)
@@ -481,6 +515,11 @@ static bStatus_t CGM_WriteAttrCB( uint16 connHandle, gattAttribute_t *pAttr,
   {
     return ( ATT_ERR_ATTR_NOT_LONG );
   }
+  // A connection without a bit in the per-connection bitmaps would be mixed up with another one
+  if ( connHandle >= CGM_CONN_MAX )
+  {
+    return ( ATT_ERR_INSUFFICIENT_RESOURCES );
+  }
   uint16 uuid = BUILD_UINT16( pAttr->type.uuid[0], pAttr->type.uuid[1]);
   switch ( uuid )
   {
@@ -496,8 +535,10 @@ static bStatus_t CGM_WriteAttrCB( uint16 connHandle, gattAttribute_t *pAttr,
           uint16 charCfg = BUILD_UINT16( pValue[0], pValue[1] );
           if(pAttr->handle == CGMAttrTbl[CGM_MEAS_CONFIG_POS].handle)
           {
+	    //Keep the subscriber bitmap in step with the CCC written by the collector
+	    CGM_MeasSubscriberSync(connHandle);
 	    //Invoke the service callback to perform additional tasks in response to the change of CCC. These tasks can be defined in the application layer in cgm.c 
-            (*CGMServiceCB)((charCfg == 0) ? CGM_MEAS_NTF_DISABLED : CGM_MEAS_NTF_ENABLED, NULL, NULL,(uint8 *)&status);
+            (*CGMServiceCB)(connHandle, (charCfg == 0) ? CGM_MEAS_NTF_DISABLED : CGM_MEAS_NTF_ENABLED, NULL, NULL,(uint8 *)&status);
           }
         }
       }
@@ -514,13 +555,13 @@ static bStatus_t CGM_WriteAttrCB( uint16 connHandle, gattAttribute_t *pAttr,
 	    if(pAttr->handle == CGMAttrTbl[CGM_CGM_OPCP_CONFIG_POS].handle)
 	    {
 	    //Invoke the service callback to perform additional tasks in response to the change of CCC. These tasks can be defined in the application layer in cgm.c 
-            (*CGMServiceCB)((charCfg == 0) ? CGM_CTL_PNT_IND_DISABLED :
+            (*CGMServiceCB)(connHandle, (charCfg == 0) ? CGM_CTL_PNT_IND_DISABLED :
                                                  CGM_CTL_PNT_IND_ENABLED, NULL, NULL,(uint8 *)&status);
 	    }
 	    else if (pAttr->handle == CGMAttrTbl[CGM_RACP_CONFIG_POS].handle)
 	    {
 	    //Invoke the service callback to perform additional tasks in response to the change of CCC. These tasks can be defined in the application layer in cgm.c 
-            	(*CGMServiceCB)((charCfg == 0) ? CGM_RACP_IND_DISABLED :
+            	(*CGMServiceCB)(connHandle, (charCfg == 0) ? CGM_RACP_IND_DISABLED :
                                                  CGM_RACP_IND_ENABLED, NULL, NULL,(uint8 *)&status);
 	    }
         }
@@ -533,14 +574,14 @@ static bStatus_t CGM_WriteAttrCB( uint16 connHandle, gattAttribute_t *pAttr,
     
   case CGM_SES_START_TIME_UUID:
 	    //Invoke the service callback to perform tasks in response to value written to start time. These tasks can be defined in the application layer in cgm.c 
-       (*CGMServiceCB)(CGM_START_TIME_WRITE_REQUEST, pValue, &len, (uint8 *)&status);
+       (*CGMServiceCB)(connHandle, CGM_START_TIME_WRITE_REQUEST, pValue, &len, (uint8 *)&status);
     break;
     
   case CGM_SPEC_OPS_CTRL_PT_UUID: //if CGM specific control point is written
       if(len >= CGM_CTL_PNT_MIN_SIZE  && len <= CGM_CTL_PNT_MAX_SIZE)
       {
 	//Invoke the service callback to perform tasks in response to value written to OPCP. These tasks can be defined in the application layer in cgm.c 
-        (*CGMServiceCB)(CGM_CTL_PNT_CMD, pValue, &len, (uint8 *)&status); //call back to APP2SERV to process the command received.
+        (*CGMServiceCB)(connHandle, CGM_CTL_PNT_CMD, pValue, &len, (uint8 *)&status); //call back to APP2SERV to process the command received.
       }
       else
       {
@@ -554,7 +595,7 @@ static bStatus_t CGM_WriteAttrCB( uint16 connHandle, gattAttribute_t *pAttr,
       {
 	      uint8 opcode = pValue[0];
 	      //If transfer in progress
-	      if (opcode != CTL_PNT_OP_ABORT && cgmMeasDBSendInProgress)
+	      if (opcode != CTL_PNT_OP_ABORT && (cgmMeasDBSendInProgress & CGM_CONN_BIT(connHandle)))
 	      {
 		      status = CGM_ERR_IN_PROGRESS;
 	      }
@@ -571,7 +612,7 @@ static bStatus_t CGM_WriteAttrCB( uint16 connHandle, gattAttribute_t *pAttr,
 	      else
 	      {
 	    		//Invoke the service callback to perform tasks in response to value written to RACP. These tasks can be defined in the application layer in cgm.c 
-	      	      (*CGMServiceCB)(CGM_RACP_CTL_PNT_CMD,pValue,&len, (uint8 *) &status);
+	      	      (*CGMServiceCB)(connHandle, CGM_RACP_CTL_PNT_CMD,pValue,&len, (uint8 *) &status);
 	      }
       }
       else
@@ -606,19 +647,49 @@ static void CGM_HandleConnStatusCB( uint16 connHandle, uint8 changeType )
       GATTServApp_InitCharCfg( connHandle, CGMControlConfig );
       GATTServApp_InitCharCfg( connHandle, CGMRacpConfig );
       GATTServApp_InitCharCfg( connHandle, CGMMeasConfig );
+      cgmMeasDBSendInProgress &= ~CGM_CONN_BIT(connHandle);
+      cgmMeasSubscribers &= ~CGM_CONN_BIT(connHandle);
+      //Let the application release what it keeps for the connection
+      (*CGMServiceCB)(connHandle, CGM_LINK_DOWN, NULL, NULL, NULL);
+    }
+    else
+    {
+      //The bond manager may have restored the CCC of a bonded collector behind the write callback
+      CGM_MeasSubscriberSync(connHandle);
     }
   }
 }
 
+/**
+   @ingroup glucosemeasgrp
+ * @brief       Reload the subscriber bit of a connection from its CGM measurement CCC.
+ * @details     The bond manager restores the CCC of a bonded collector with GATTServApp_UpdateCharCfg, which does not
+ *              go through CGM_WriteAttrCB. The bit is therefore also reloaded on every link state change, and the
+ *              application reloads it when pairing or bonding completes.
+ * @param       connHandle - connection handle
+ * @return      none
+ */
+void CGM_MeasSubscriberSync( uint16 connHandle )
+{
+  if ( GATTServApp_ReadCharCfg( connHandle, CGMMeasConfig ) & GATT_CLIENT_CFG_NOTIFY )
+    cgmMeasSubscribers |= CGM_CONN_BIT(connHandle);
+  else
+    cgmMeasSubscribers &= ~CGM_CONN_BIT(connHandle);
+}
+
 /**
    @ingroup racpgrp
- * @brief       Set the state of the CGM database transmission indicator
+ * @brief       Set the state of the CGM database transmission indicator of a connection
+ * @param       connHandle - connection handle
  * @param       input - 
  * @return      none
  */
-bool CGM_SetSendState(bool input)
+bool CGM_SetSendState(uint16 connHandle, bool input)
 {
-	cgmMeasDBSendInProgress=input;
-	return cgmMeasDBSendInProgress;
+	if (input)
+		cgmMeasDBSendInProgress |= CGM_CONN_BIT(connHandle);
+	else
+		cgmMeasDBSendInProgress &= ~CGM_CONN_BIT(connHandle);
+	return input;
 }
 
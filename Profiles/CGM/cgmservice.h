@@ -70,6 +70,7 @@ extern "C"
 #define CGM_START_TIME_WRITE_REQUEST		14              ///< Start time write request from the lower layer
 #define	CGM_RACP_IND_DISABLED			15              ///< RACP indication is disabled
 #define	CGM_RACP_IND_ENABLED			16              ///< RACP indication is enabled
+#define CGM_LINK_DOWN				17              ///< The link of a connection is down, the state kept for it may be released
 
 // ATT status values
 #define	CGM_ERR_IN_PROGRESS		     	0xFE            ///< GATT error, transmission in progress
@@ -270,6 +271,10 @@ extern "C"
 #define CGM_SPEC_OP_START_SES			26	///< Start the Session
 #define CGM_SPEC_OP_STOP_SES			27	///< Stop the Session
 #define CGM_SPEC_OP_RESP_CODE			28	///< Response Code
+// Vendor extensions of the CGM specific operation codes, in the range reserved for future use
+#define CGM_SPEC_OP_SET_ALERT_CONFIG		0xF0	///< Set the enable bit and hysteresis of an alert. Operand: the Set opcode of the alert level, the enable bit (0 or 1), the hysteresis as a SFLOAT in the unit of the alert level
+#define CGM_SPEC_OP_GET_ALERT_CONFIG		0xF1	///< Get the enable bit and hysteresis of an alert. Operand: the Set opcode of the alert level
+#define CGM_SPEC_OP_RESP_ALERT_CONFIG		0xF2	///< Alert configuration response. Operand: the Set opcode of the alert level, the enable bit, the hysteresis as a SFLOAT
 
 // CGM specific op code - resposne codes
 #define	CGM_SPEC_OP_RESP_SUCCESS		1	///< Success
@@ -298,11 +303,15 @@ extern "C"
  * TYPEDEFS
  */
 // Glucose Service callback function
-typedef void (*CGMServiceCB_t)(uint8 event, uint8* data, uint8 *dataLen,uint8 *result);
+typedef void (*CGMServiceCB_t)(uint16 connHandle, uint8 event, uint8* data, uint8 *dataLen,uint8 *result);
 
 /*
  * MACROS
  */
+#define CGM_CONN_MAX				8	///< The number of connections the per-connection bitmaps hold. The stack numbers its connections from 0 up to GATT_MAX_NUM_CONN, which must not exceed it
+#define CGM_CONN_BIT(connHandle)		((uint8)((connHandle)<CGM_CONN_MAX ? 1<<(connHandle) : 0))	///< The bit of a connection in the per-connection bitmaps. A handle of CGM_CONN_MAX or more has none, and is refused by the service
+#define CGM_CONN_ALL				0xFF	///< The bitmap of all the connections
+#define CGM_TX_BUSY(status)		((status)==blePending || (status)==MSG_BUFFER_NOT_AVAIL || (status)==bleMemAllocError)	///< The stack refused a PDU for lack of TX buffers, it may be sent again later. The status is evaluated more than once
 
 /*
  * Profile Callbacks
@@ -325,6 +334,23 @@ extern void CGM_Register( CGMServiceCB_t pfnServiceCB);
  */
 extern bStatus_t CGM_MeasSend( uint16 connHandle, attHandleValueNoti_t *pNoti, uint8 taskId );
 
+/**
+ * @fn          CGM_MeasBroadcast
+ * @brief       Send one CGM measurement to every connection of a set that has its notification enabled.
+ * @param       connMask - the connections to send to, one CGM_CONN_BIT each
+ * @param       pNoti - pointer to notification structure
+ * @return      the connections, one CGM_CONN_BIT each, that are subscribed but had no TX buffer left
+ */
+extern uint8 CGM_MeasBroadcast( uint8 connMask, attHandleValueNoti_t *pNoti );
+
+/**
+ * @fn          CGM_MeasSubscriberSync
+ * @brief       Reload the subscriber bit of a connection from its CGM measurement CCC, after the bond manager restored it.
+ * @param       connHandle - connection handle
+ * @return      none
+ */
+extern void CGM_MeasSubscriberSync( uint16 connHandle );
+
 /**
  * @brief       Send a CGM measurement context.
  * @param       connHandle - connection handle
@@ -355,11 +381,12 @@ extern bStatus_t CGM_CtlPntIndicate( uint16 connHandle, attHandleValueInd_t *pIn
 extern bStatus_t CGM_RACPIndicate( uint16 connHandle, attHandleValueInd_t *pInd, uint8 taskId );
 
 /**
- * @brief       Set the state of the CGM database transmission indicator
+ * @brief       Set the state of the CGM database transmission indicator of a connection
+ * @param       connHandle - connection handle
  * @param       input - the state of the transmission
  *		<table><TR><TD>0</TD><TD>data transmission is not in progress</TD></TR><TR><TD>1</TD><TD>data transmission is in progress</TD></TR></table>
  * @return      none*/
-extern bool CGM_SetSendState(bool input);
+extern bool CGM_SetSendState(uint16 connHandle, bool input);
 
 #ifdef __cplusplus
 }
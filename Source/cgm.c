@@ -40,6 +40,10 @@ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLI
 #include "battservice.h"
 #include "cgmsimdata.h"
 #include "crc.h"
+#include "cgmlog.h"
+#include <stddef.h>
+#include "cgmmodel.h"
+#include "sfloat.h"
 
 //Some Doxygen command - defining groups
 /// \defgroup gapgrp Generic Access Profile (GAP)
@@ -78,7 +82,6 @@ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLI
 /*
  * MACROS
  */
-#define	SFLOAT	uint16	///< Using a unsigned 16bit integer to store a SFLOAT
 
 /// \defgroup featureactivation Feature Activation Macros
 /// \brief A set of macro definitions to enable/disable features.
@@ -92,6 +95,10 @@ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLI
 #define FEATURE_GLUCOSE_CRC			1	///< The E2E-CRC support
 #define FEATURE_GLUCOSE_DEVICE_ALERT		1	///< The device alert support
 #define FEATURE_GLUCOSE_TREND                   1       ///< The glucose measurement trending feature
+#define FEATURE_GLUCOSE_VIRTUAL_TIME		0	///< Run the measurement cycle on a virtual clock, back to back instead of waiting for the timer
+#define FEATURE_GLUCOSE_PERSISTENT_LOG		0	///< Keep the measurement history in flash across resets. Mind the flash wear at short measurement periods, see cgmlog.h
+#define FEATURE_GLUCOSE_WIRE_IMAGE_DB		0	///< Keep the history as ready-to-send notification values rather than packed records
+#define FEATURE_GLUCOSE_MODEL			0	///< Draw the glucose values from the physiological model instead of the recorded data set
 ///@}
 // End of featureactivation 
 
@@ -122,6 +129,15 @@ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLI
 
 /// \ingroup glucosemeasgrp
 #define DEFAULT_NOTI_PERIOD                   1000	///< Notification period in ms
+#define CGM_GLUCOSE_INTERPOLATION		CGM_SIM_INTERP_LINEAR	///< How glucose values are drawn from the simulation data between its samples, one of CGM_SIM_INTERP_*
+
+/// \ingroup glucosemeasgrp
+/// \brief Write one byte to an outgoing PDU at p and, with the E2E-CRC feature, feed it to the running CRC crc, so the PDU is only traversed once.
+#if (FEATURE_GLUCOSE_CRC==1)
+#define CGM_PDU_PUT(p,crc,byte)	do { uint8 pduByte=(uint8)(byte); *(p)++=pduByte; CCITT_CRC16_BYTE(crc,pduByte); } while(0)
+#else
+#define CGM_PDU_PUT(p,crc,byte)	(*(p)++=(uint8)(byte))
+#endif /* FEATURE_GLUCOSE_CRC==1*/
 
 
 
@@ -184,11 +200,42 @@ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLI
 #define RATEALERT_INCREASE_MIN			0xF000	///< The minimal rate of increase allowed by the system, which is 0.0 in decimal
 #define RATEALERT_DECREASE_MIN			0xFFFF  ///< The minimal rate of decrease allowed by the system, which is -0.1 in decimal
 #define RATEALERT_DECREASE_MAX			0xF803  ///< The maximal rate of decrease allowed by the system, which is -204.5 in decimal			
-#define RATEALERT_INCREASE_DEFAULT		0xF00A	///< The minimal rate of increase allowed by the system, which is 10.0 in decimal
-#define RATEALERT_DECREASE_DEFAULT		0xFFF6  ///< The minimal rate of decrease allowed by the system, which is -10.0 in decimal
+#define RATEALERT_INCREASE_DEFAULT		0xF00A	///< The default rate of increase alert threshold, which is 1.0 mg/dL/min
+#define RATEALERT_DECREASE_DEFAULT		0xFFF6  ///< The default rate of decrease alert threshold, which is -1.0 mg/dL/min
 #endif /*FEATURE_GLUCOSE_RATEALERT==1*/
 ///@}
 
+/// \ingroup cgmcpgrp
+/// \defgroup alertgrp Alert Evaluation
+/// \brief This is a group of constants, variables, functions evaluating the glucose level and rate of change alerts from one threshold table.
+///@{
+#define CGM_ALERT_PHIGH				0	///< The patient defined high alert in the alert table
+#define CGM_ALERT_PLOW				1	///< The patient defined low alert in the alert table
+#define CGM_ALERT_HYPER				2	///< The hyperglycemia alert in the alert table
+#define CGM_ALERT_HYPO				3	///< The hypoglycemia alert in the alert table
+#define CGM_ALERT_RATE_INCREASE			4	///< The rate of increase alert in the alert table
+#define CGM_ALERT_RATE_DECREASE			5	///< The rate of decrease alert in the alert table
+#define CGM_ALERT_NUM				6	///< The number of alerts in the alert table
+#define CGM_ALERT_ABOVE				0x01	///< The alert is raised above its threshold, otherwise below it
+#define CGM_ALERT_INCLUSIVE			0x02	///< A value equal to the threshold raises the alert
+#define CGM_ALERT_ON_TREND			0x04	///< The alert tests the rate of change, in 0.1 mg/dL/min, instead of the concentration
+#define CGM_ALERT_HYST_GLUCOSE			5	///< The hysteresis of the concentration alerts, in mg/dL
+#define CGM_ALERT_HYST_RATE			5	///< The hysteresis of the rate alerts, in 0.1 mg/dL/min
+#define CGM_ALERT_HOLD_SHIFT			24	///< The position of the hold bits, one per alert, above the annunciation bits of the evaluation results
+/// \brief The number of samples cgmNewGlucoseMeasBatch hands to cgmAlertEvaluate at once. The 8051 evaluates one
+///	   sample at a time, keeping its stack small; other targets evaluate runs that host compilers vectorize.
+///	   It can be overridden from the compiler command line.
+#ifndef CGM_ALERT_BATCH
+#if defined(__ICC8051__)
+#define CGM_ALERT_BATCH				1
+#else
+#define CGM_ALERT_BATCH				32
+#endif
+#endif
+#define CGM_ALERT_MASK				(CGM_STATUS_ANNUNC_HIGH_PATIRNT|CGM_STATUS_ANNUNC_LOW_PATIENT|CGM_STATUS_ANNUNC_HIGH_HYPER \
+						|CGM_STATUS_ANNUNC_LOW_HYPO|CGM_STATUS_ANNUNC_EXCEEDED_INCR_RATE|CGM_STATUS_ANNUNC_EXCEEDED_DESC_RATE)	///< The annunciation bits owned by the alert table
+///@}
+
 
 /*********************************************************************
  * TYPEDEFS
@@ -204,6 +251,98 @@ typedef struct {
 	uint16        trend;				///<The rate of increase or decrease, in the SFLOAT data type. It has the unit of mg/dL/min
 	uint16        quality;				///<The quality of the CGM measurement,
 } cgmMeasC_t;
+#if (FEATURE_GLUCOSE_WIRE_IMAGE_DB==1)
+/// \ingroup racpgrp
+/// \brief The largest CGM measurement notification value this build can produce.
+#define CGM_MEAS_WIRE_MAX	(6+3+2*FEATURE_GLUCOSE_TREND+2*FEATURE_GLUCOSE_QUALITY+2*FEATURE_GLUCOSE_CRC)
+/// \ingroup racpgrp
+/// \brief A CGM measurement as kept in the history database in the wire image mode.
+/// \details The record is the notification value exactly as sent, E2E-CRC included. Its first byte is the size
+///          field, which is also the number of valid bytes. RACP replays it without encoding it again.
+typedef struct {
+	uint8		pdu[CGM_MEAS_WIRE_MAX];		///<The notification value of the measurement.
+} cgmMeasPacked_t;
+#else
+/// \ingroup racpgrp
+/// \brief The packed form of a CGM measurement, as kept in the history database.
+/// \details The size field is not stored since it follows from the flags. Multi-byte fields are kept as 
+///          little endian byte arrays, so the record has no padding on any target. Trend and quality only 
+///          take space when the build can produce them. cgmMeasUnpack restores the exact cgmMeasC_t.
+typedef struct {
+	uint8		flags;				///<The flags field of the measurement, which tells which optional fields are present.
+	uint8		concentration[2];		///<The concentration of glucose estimate, in the SFLOAT data type.
+	uint8		timeoffset[2];			///<The timeoffset from the session start time.
+	uint8		annunciation[3];		///<The sensor status annunciation.
+#if (FEATURE_GLUCOSE_TREND==1)
+	uint8		trend[2];			///<The rate of increase or decrease, in the SFLOAT data type.
+#endif
+#if (FEATURE_GLUCOSE_QUALITY==1)
+	uint8		quality[2];			///<The quality of the CGM measurement.
+#endif
+} cgmMeasPacked_t;
+#endif /*FEATURE_GLUCOSE_WIRE_IMAGE_DB==1*/
+#define CGM_MEAS_DB_GAPS		4	///<The number of spans of deleted records the database keeps track of. Deleting one more span compacts the database at once @ingroup racpgrp
+#define CGM_SESSIONS			GATT_MAX_NUM_CONN	///<The number of collectors served at the same time, at most CGM_CONN_MAX @ingroup racpgrp
+#define CGM_MEAS_DB_COMPACT_STEP	16	///<The number of records moved per measurement interval while the deleted spans are compacted away @ingroup racpgrp
+/// \ingroup racpgrp
+/// \brief An index into the measurement history database, wide enough for CGM_MEAS_DB_SIZE records.
+/// \note  One bit of headroom is kept so that the sum of two indices does not overflow.
+#if (CGM_MEAS_DB_SIZE<0x80)
+typedef uint8	cgmMeasDBIndx_t;
+#elif (CGM_MEAS_DB_SIZE<0x8000)
+typedef uint16	cgmMeasDBIndx_t;
+#else
+typedef uint32	cgmMeasDBIndx_t;
+#endif
+/// \ingroup racpgrp
+/// \brief A span of deleted records, which still take room in the history database until it is compacted.
+typedef struct {
+	cgmMeasDBIndx_t	start;				///<The sequence number of the first deleted record.
+	cgmMeasDBIndx_t	num;				///<The number of deleted records.
+} cgmMeasDBGap_t;
+/// \ingroup racpgrp
+/// \brief The state of the RACP record transfer procedure.
+/// \details The procedure only moves forward between records. The cursor and the count are updated once a record
+///          has been handed to the stack, so the procedure may be suspended after any record, for a live
+///          measurement or until the next connection event, and resumed from where it was, or cancelled at once.
+typedef struct {
+	uint8		state;				///<CGM_RACP_PROC_IDLE or CGM_RACP_PROC_SENDING.
+	uint8		credits;			///<The number of records the transfer may queue in the next connection event.
+	cgmMeasDBIndx_t	cursor;				///<The sequence number of the next record to be sent.
+	cgmMeasDBIndx_t	remaining;			///<The number of records left to send.
+} cgmRACPProc_t;
+/// \ingroup glucosemeasgrp
+/// \brief The state and the counters of the TX scheduler, which shares the measurement characteristic between the
+///	   live measurements and the RACP records. The counters only grow, they are read with a debugger.
+typedef struct {
+	uint8		livePending;			///<The connections, one CGM_CONN_BIT each, that refused the live measurement now waiting in CGMMeas.
+	uint8		liveWait;			///<The number of connection events the waiting live measurement has been deferred.
+	uint8		armed;				///<Non zero while the scheduler runs at the end of every connection event.
+	uint8		liveWaitMax;			///<The longest deferral of a live measurement, in connection events.
+	uint16		liveDeferred;			///<The number of live measurements the stack refused at first.
+	uint16		liveSuperseded;			///<The number of live measurements replaced by a newer one before they were sent.
+	cgmMeasDBIndx_t	depthMax;			///<The largest queue depth seen by a run, the RACP records left plus the waiting live measurement.
+} cgmTxSched_t;
+/// \ingroup racpgrp
+/// \brief The state kept for one connected collector. Each collector runs its own RACP queries and transfers over
+///	   the history database of the sensor, and receives the live measurements.
+typedef struct {
+	uint16		connHandle;			///<The connection handle, INVALID_CONNHANDLE while the session is free.
+	cgmMeasDBIndx_t	measDBSearchStart;		///<The sequence number of the first record meeting the search criterion.
+	cgmMeasDBIndx_t	measDBSearchEnd;		///<The sequence number of the last position covered by the search criterion.
+	cgmMeasDBIndx_t	measDBSearchNum;		///<The number of records meeting the criterion, deleted ones left out.
+	cgmRACPProc_t	racp;				///<The RACP record transfer in progress, if any.
+} cgmSession_t;
+/// \ingroup alertgrp
+/// \brief An entry of the alert table.
+typedef struct {
+	uint32	annunc;					///<The status annunciation bit the alert raises.
+	int16	threshold;				///<The threshold, in mg/dL, or in 0.1 mg/dL/min for the rate alerts.
+	int16	hysteresis;				///<How far back past the threshold the value has to go to clear the alert.
+	SFLOAT	setting;				///<The threshold as set through the CGMCP, returned as is when read back.
+	uint8	flags;					///<The CGM_ALERT_* flags of the alert.
+	uint8	enabled;				///<Non zero when the alert is evaluated.
+} cgmAlert_t;
 /// \ingroup featuregrp
 /// \brief Container for the CGM support feature characteristic
 typedef struct {
@@ -227,6 +366,7 @@ typedef struct {
 /// \brief The container for receiving CGMCP data message from the CGM service layer
 typedef struct {
 	osal_event_hdr_t hdr; 				///< MSG_EVENT and status from the CGM service layer
+	uint16 connHandle;				///< The connection the CGMCP was written on
 	uint8 len;					///< The length of the data being passed
 	uint8 data[CGM_CTL_PNT_MAX_SIZE];		///< The value of the data being passed
 } cgmCtlPntMsg_t;
@@ -234,9 +374,37 @@ typedef struct {
 /// \brief The container for receiving RACP data message from the CGM service layer
 typedef struct {
 	osal_event_hdr_t hdr; 			///< MSG_EVENT and status
+	uint16 connHandle;			///< The connection the RACP was written on
 	uint8 len;				///< The length of the data being passed
 	uint8 data[CGM_RACP_MAX_SIZE];		///< The value of the data being passed
-} cgmRACPMsg_t;				
+} cgmRACPMsg_t;
+/// \ingroup appgrp
+/// \brief The container for the state of one simulated CGM sensor.
+/// \details Everything that evolves while a sensor generates, stores and reports measurements lives here,
+///          so that several independent sensors can be driven by the same code. The BLE facing application
+///          owns a single instance, cgmSensor.
+typedef struct {
+	cgmMeasPacked_t * measDB;			///<Pointer to the glucose measurement history database.
+	cgmMeasDBIndx_t	measDBSize;			///<The number of records the database can hold.
+	cgmMeasDBIndx_t	measDBWriteIndx;		///<Hold the array index of the next place to write record.
+	cgmMeasDBIndx_t	measDBCount;			///<The number of records being stored into the database.
+	cgmMeasDBIndx_t	measDBOldestIndx;		///<The index pointing to the oldest record in the database.
+	cgmSession_t	session[CGM_SESSIONS];		///<The sessions of the connected collectors.
+	cgmTxSched_t	tx;				///<The TX scheduler of the measurement characteristic.
+	uint16		measDBStep;			///<The time offset step between the two newest records.
+	cgmMeasDBIndx_t	measDBStepRun;			///<The number of newest records evenly spaced by measDBStep. When it covers the whole database, time offsets map to positions arithmetically.
+	cgmMeasDBIndx_t	measDBSeqBase;			///<The sequence number of the oldest record. A record keeps its sequence number until it is overwritten or moved by a compaction.
+	cgmMeasDBGap_t	measDBGap[CGM_MEAS_DB_GAPS];	///<The spans of deleted records still in the database, oldest first. They never hold the oldest or the newest record.
+	uint8		measDBGapNum;			///<The number of spans in measDBGap.
+	uint16		commInterval;			///<The glucose measurement update interval in ms
+	cgmStatus_t	status;				///<The status of the sensor.
+	uint16		timeOffset;			///<The time offset from the session start time.
+	uint16		glucoseGen;			///<The most recently generated glucose value.
+	uint16		glucosePreviousGen;		///<The glucose value generated before glucoseGen, used for the trend.
+	cgmSimInterp_t	simData;			///<The position of the sensor in the simulation data set.
+	uint32		simElapsed;			///<The simulated time the sensor has run, in seconds. It sets the position in the simulation data set.
+	cgmMeasC_t	currentMeas;			///<The most current glucose estimate.
+} cgmSensor_t;
 /// \ingroup calibrationgrp
 /// \brief The container for holding a glucose calibration structure
 #if (FEATURE_GLUCOSE_CALIBRATION==1)
@@ -245,7 +413,7 @@ typedef struct {
 	uint16		calibrationTime;	///< The time the calibration value has been measured as relative offset to the Session Start Time in minutes.
 	uint8 		cgmTypeSample;		///< The measurement sample type and location
 	uint16		nextCalibrationTime;	///< The relative offset to the Session Start Time when the next calibration is required by the Server. A value of 0x0000 means that a calibration is required instantly.
-	uint16		recordNumber;		///< The calibration data record number. @details Each Calibration record is identified by a number. A get operation with an operand of 0xFFFF in this field will return the last Calibration Data stored. A value of 0 in this field represents no calibration value is stored. This field is ignored during a Set Glucose Calibration value procedure.
+	uint16		recordNumber;		///< The calibration data record number. @details Each Calibration record is identified by a number. A get operation with an operand of 0xFFFF in this field will return the last Calibration Data stored. A value of "0" in this field represents no calibration value is stored. This field is ignored during a Set Glucose Calibration value procedure.
 	uint8		status;			///< Representing the status of the calibration procedure of the Server related to the Calibration Data Record. @details This field is ignored during the Set Glucose Calibration value procedure. The value of this field represents the status of the calibration process of the Server.
 } cgmCalibrationDataRecord_t;
 #endif /*FEATURE_GLUCOSE_CALIBRATION==1*/
@@ -258,8 +426,6 @@ typedef struct {
  * GLOBAL VARIABLES
  */
 uint8 cgmTaskId;				///< The task ID associated with the CGM simulator application. It is used to schedule task in the OS layer.
-/// \ingroup accessgrp
-uint16 gapConnHandle;				///< The handle for the current GAP connection.
 
 /*
  * EXTERNAL VARIABLES
@@ -302,7 +468,6 @@ static uint8 advertData[] =
 static uint8 attDeviceName[GAP_DEVICE_NAME_LEN] = "CGM Simulator";	///< The device name variable.
 static bool cgmBonded = FALSE;						///< Local variable storing the current bonding stage of the sensor.
 static uint8 cgmBondedAddr[B_ADDR_LEN];					///< Local variable storing the address of the bonded peer.
-static uint16 gapConnHandle;						///< Local version of the GAP connection handle.
 static bool cgmAdvCancelled = FALSE;					///< Denote the advertising state.
 ///@}
 // Indication structures for cgm
@@ -341,19 +506,20 @@ static cgmFeature_t             cgmFeature={ 	CGM_FEATURE_TREND_INFO
 #endif /*(FEATURE_GLUCOSE_DEVICE_ALERT==1)*/
 						, BUILD_UINT8(CGM_SAMPLE_LOC_SUBCUT_TISSUE,CGM_TYPE_ISF)};	///<The features supported by the CGM simulator
 //                                                               ^Sample Location                ^Type
-/// \ingroup glucosemeasgrp
-static uint16                   cgmCommInterval=1000;			///<The glucose measurement update interval in ms
-/// \ingroup statusgrp
-static cgmStatus_t              cgmStatus={0x1234,0x000000}; 		///<The status of the CGM simulator. Default value is for testing purpose.
+#if (FEATURE_GLUCOSE_MODEL==1)
+/// \ingroup appgrp
+static cgmModel_t		cgmModel;				///<The virtual patient the sensor measures.
+/// \ingroup appgrp
+static cgmSimDataSource_t	cgmModelSource;				///<The simulation data source reading cgmModel.
+#endif /*FEATURE_GLUCOSE_MODEL==1*/
+/// \ingroup appgrp
+static cgmSensor_t		cgmSensor;				///<The state of the sensor exposed through the CGM service. It holds the history database, the RACP cursors, the interval, the status and the time offset.
 /// \ingroup starttimegrp
 static cgmSessionStartTime_t    cgmStartTime={{0,0,0,0,0,2000},TIME_ZONE_UTC_M5,DST_STANDARD_TIME};
 									///<The start time of the current session. The default value is 
-/// ingroup glucosemeasgrp
-static cgmMeasC_t        	cgmCurrentMeas;				///< Local variable storing the most current glucose estimate.
 //Time related local variables
 static UTCTime                 	cgmCurrentTime_UTC;			///<The UTC format of the current system time. Appear as the number of seconds from 2000-01-01-00:00:00 @ingroup glucosemeasgrp
 static UTCTime			cgmStartTime_UTC;			///<The UTC format of the start time. Appear as the number of seconds from 2000-01-01-00:00:00 @ingroup starttimegrp
-static uint16			cgmTimeOffset;				///<The time offset from the session start time. @ingroup glucosemeasgrp
 static uint16                   cgmSessionRunTime=0x00A8;		///<The run time of the current sensor. Default value is 7 days. @ingroup runtimegrp
 static bool                     cgmSessionStartIndicator=false;		///<Indicate whether the sesstion has been started @ingroup starttimegrp
 static bool			cgmStartTimeConfigIndicator=false;	///<Indicate whether the session start time has been configured before with the set start time CGMCP command.@ingroup starttimegrp
@@ -361,15 +527,23 @@ static bool			cgmStartTimeConfigIndicator=false;	///<Indicate whether the sessio
 /// @defgroup racpgrp Record Access Control Point (RACP)
 /// @brief The macros, constants, variables, functions that are related to the RACP.
 /// @{
-//RACP Related Variables
-static cgmMeasC_t *	cgmMeasDB;					///<Pointer to the glucose measurement history database.
-static uint8		cgmMeasDBWriteIndx;				///<Hold the array index of the next place to write record.
-static uint8		cgmMeasDBCount;					///<The number of records being stored into the database.
-static uint8		cgmMeasDBOldestIndx;				///<The index pointing to the oldest record in the database.
-static uint8		cgmMeasDBSearchStart; 				///<The starting index records meeting the search criterion.
-static uint8		cgmMeasDBSearchEnd;				///<The ending index of records meeting the search criterion.
-static uint16		cgmMeasDBSearchNum;   				///<The resulting record number that matches the criterion.
-static uint8		cgmMeasDBSendIndx;   				///<The index of the next record to be sent. It is used in RACP reporting record function.
+#define CGM_RACP_BURST			4	///<The maximal number of records queued for one connection event during a RACP transfer, and the initial credit of a transfer. It also bounds the work done between an abort request and its response
+#define CGM_RACP_PROC_IDLE		0	///<No RACP record transfer is in progress
+#define CGM_RACP_PROC_SENDING		1	///<A RACP record transfer is in progress
+#define CGM_MEAS_DB_SLOT(pSensor,indx,pos)	((cgmMeasDBIndx_t)((indx)+(pos))>=(pSensor)->measDBSize ? (cgmMeasDBIndx_t)((indx)+(pos)-(pSensor)->measDBSize) : (cgmMeasDBIndx_t)((indx)+(pos)))	///<The array index pos records after the array index indx, wrapping around the end of the database. pos must not exceed the database size
+#define CGM_MEAS_DB_AT(pSensor,pos)	((pSensor)->measDB+CGM_MEAS_DB_SLOT(pSensor,(pSensor)->measDBOldestIndx,pos))	///<The record at a logical position of the database, counted from the oldest record
+#define CGM_MEAS_DB_SEQ(pSensor,pos)	((cgmMeasDBIndx_t)((pSensor)->measDBSeqBase+(pos)))	///<The sequence number of the record at a logical position
+#define CGM_MEAS_DB_POS(pSensor,seq)	((cgmMeasDBIndx_t)((seq)-(pSensor)->measDBSeqBase))	///<The logical position of the record with a sequence number. It is measDBCount or more when the record is gone
+#ifndef CGM_MEAS_DB_ALLOC
+#define CGM_MEAS_DB_ALLOC(bytes)	((bytes)<=0xFFFF ? osal_mem_alloc((uint16)(bytes)) : NULL)	///<The allocator of the history database. Builds whose history does not fit in the OSAL heap supply their own
+#endif
+#if (FEATURE_GLUCOSE_WIRE_IMAGE_DB==1)
+#define CGM_MEAS_DB_OFFSET(pRecord)	BUILD_UINT16((pRecord)->pdu[4],(pRecord)->pdu[5])	///<The time offset of a stored record, which follows the size, flags and concentration fields
+#define CGM_MEAS_DB_OFFSET_POS		(offsetof(cgmMeasPacked_t,pdu)+4)	///<The position of the time offset within a stored record
+#else
+#define CGM_MEAS_DB_OFFSET(pRecord)	BUILD_UINT16((pRecord)->timeoffset[0],(pRecord)->timeoffset[1])	///<The time offset of a packed record
+#define CGM_MEAS_DB_OFFSET_POS		offsetof(cgmMeasPacked_t,timeoffset)	///<The position of the time offset within a packed record
+#endif /*FEATURE_GLUCOSE_WIRE_IMAGE_DB==1*/
 /// @}
 /// \addtogroup calibrationgrp
 ///@{
@@ -384,31 +558,37 @@ static SFLOAT		cgmCalibration;					///< The most current calibration value.
 #endif /* FEATURE_GLUCOSE_CALIBRATION==1*/
 ///@} 
 //end of calibrationgrp
-/// \addtogroup patienthighlowgrp
+/// \addtogroup alertgrp
 ///@{
+/// The alert table at power up. The alerts whose feature is not built in are never enabled.
+static const cgmAlert_t cgmAlertDefaults[CGM_ALERT_NUM]={
 #if (FEATURE_GLUCOSE_PATIENTHIGHLOW==1)
-static SFLOAT		cgmPatientHigh;					///< The patient high glucose set level.
-static SFLOAT		cgmPatientLow;					///< The patient low glucose set level. 
+	{CGM_STATUS_ANNUNC_HIGH_PATIRNT,	PATIENTHIGH_CONCENTRATION_DEFAULT, CGM_ALERT_HYST_GLUCOSE, PATIENTHIGH_CONCENTRATION_DEFAULT, CGM_ALERT_ABOVE, true},
+	{CGM_STATUS_ANNUNC_LOW_PATIENT,		PATIENTLOW_CONCENTRATION_DEFAULT, CGM_ALERT_HYST_GLUCOSE, PATIENTLOW_CONCENTRATION_DEFAULT, 0, true},
+#else
+	{CGM_STATUS_ANNUNC_HIGH_PATIRNT,	0, CGM_ALERT_HYST_GLUCOSE, 0, CGM_ALERT_ABOVE, false},
+	{CGM_STATUS_ANNUNC_LOW_PATIENT,		0, CGM_ALERT_HYST_GLUCOSE, 0, 0, false},
 #endif /*FEATURE_GLUCOSE_PATIENTHIGHLOW==1*/
-///@}
-/// \addtogroup hyperalertgrp
-/// @{
 #if (FEATURE_GLUCOSE_HYPERALERT==1)
-static SFLOAT		cgmHyperThreshold;				///< The hyperglycemia alert threshold.
-#endif /*FEATURE_GLUCOSE_HYPERALERT*/
-/// @}
-/// \addtogroup hypoalertgrp
-///@{
+	{CGM_STATUS_ANNUNC_HIGH_HYPER,		HYPERALERT_CONCENTRATION_DEFAULT, CGM_ALERT_HYST_GLUCOSE, HYPERALERT_CONCENTRATION_DEFAULT, CGM_ALERT_ABOVE|CGM_ALERT_INCLUSIVE, true},
+#else
+	{CGM_STATUS_ANNUNC_HIGH_HYPER,		0, CGM_ALERT_HYST_GLUCOSE, 0, CGM_ALERT_ABOVE|CGM_ALERT_INCLUSIVE, false},
+#endif /*FEATURE_GLUCOSE_HYPERALERT==1*/
 #if (FEATURE_GLUCOSE_HYPOALERT==1)
-static SFLOAT		cgmHypoThreshold;				///< The hypoglycemia alert threshold.
+	{CGM_STATUS_ANNUNC_LOW_HYPO,		HYPOALERT_CONCENTRATION_DEFAULT, CGM_ALERT_HYST_GLUCOSE, HYPOALERT_CONCENTRATION_DEFAULT, CGM_ALERT_INCLUSIVE, true},
+#else
+	{CGM_STATUS_ANNUNC_LOW_HYPO,		0, CGM_ALERT_HYST_GLUCOSE, 0, CGM_ALERT_INCLUSIVE, false},
 #endif /*FEATURE_GLUCOSE_HYPOALERT==1*/
-///@}
-/// \addtogroup ratealertgrp 
-///@{
 #if (FEATURE_GLUCOSE_RATEALERT==1)
-static SFLOAT		cgmIncreaseThreshold;				///< The rate of increase alert threshold.
-static SFLOAT		cgmDecreaseThreshold;				///< The rate of decrease alert threshold.
+	{CGM_STATUS_ANNUNC_EXCEEDED_INCR_RATE,	10, CGM_ALERT_HYST_RATE, RATEALERT_INCREASE_DEFAULT, CGM_ALERT_ON_TREND|CGM_ALERT_ABOVE, true},
+	{CGM_STATUS_ANNUNC_EXCEEDED_DESC_RATE,	-10, CGM_ALERT_HYST_RATE, RATEALERT_DECREASE_DEFAULT, CGM_ALERT_ON_TREND, true},
+#else
+	{CGM_STATUS_ANNUNC_EXCEEDED_INCR_RATE,	0, CGM_ALERT_HYST_RATE, 0, CGM_ALERT_ON_TREND|CGM_ALERT_ABOVE, false},
+	{CGM_STATUS_ANNUNC_EXCEEDED_DESC_RATE,	0, CGM_ALERT_HYST_RATE, 0, CGM_ALERT_ON_TREND, false},
 #endif /*FEATURE_GLUCOSE_RATEALERT==1*/
+};
+static cgmAlert_t	cgmAlertTable[CGM_ALERT_NUM];			///< The thresholds, hysteresis and enable bits of the alerts.
+static uint32		cgmAlertActive;					///< The annunciation bits of the alerts currently raised.
 ///@}
 /*********************************************************************
  * LOCAL FUNCTIONS
@@ -423,21 +603,57 @@ static uint8 cgmVerifyTime(UTCTimeStruct* pTime);
 static uint8 cgmVerifyTimeZone( int8 input);
 static uint8 cgmVerifyDSTOffset( uint8 input);
 //CGMCP related functions
-static void cgmCtlPntResponse(uint8 opcode, uint8 *roperand,uint8 roperand_len);
+static void cgmCtlPntResponse(uint16 connHandle, uint8 opcode, uint8 *roperand,uint8 roperand_len);
 static void cgmProcessCtlPntMsg( cgmCtlPntMsg_t* pMsg);
 //RACP realted functions
-static uint8 cgmSearchMeasDB(uint8 filter,uint16 operand1, uint16 operand2);
-static void cgmAddRecord(cgmMeasC_t *cgmCurrentMeas);
+static uint8 cgmSearchMeasDB(cgmSensor_t *pSensor, cgmSession_t *pSession, uint8 filter,uint16 operand1, uint16 operand2);
+static cgmMeasDBIndx_t cgmMeasDBLowerBound(cgmSensor_t *pSensor, uint16 offset);
+static cgmMeasDBIndx_t cgmMeasDBUpperBound(cgmSensor_t *pSensor, uint16 offset);
+static void cgmMeasDBSetSearch(cgmSensor_t *pSensor, cgmSession_t *pSession, cgmMeasDBIndx_t first, cgmMeasDBIndx_t last);
+static cgmMeasDBIndx_t cgmMeasDBNextLive(cgmSensor_t *pSensor, cgmMeasDBIndx_t pos);
+static cgmMeasDBIndx_t cgmMeasDBLiveBetween(cgmSensor_t *pSensor, cgmMeasDBIndx_t first, cgmMeasDBIndx_t last);
+static void cgmMeasDBDropOldest(cgmSensor_t *pSensor, cgmMeasDBIndx_t num);
+static void cgmMeasDBCompact(cgmSensor_t *pSensor, cgmMeasDBIndx_t budget);
+static void cgmMeasDBCompactAll(cgmSensor_t *pSensor);
+static void cgmAddRecord(cgmSensor_t *pSensor, cgmMeasC_t *pMeas);
+static void cgmAddRecords(cgmSensor_t *pSensor, cgmMeasC_t *pMeas, uint16 num);
+static void cgmAddPackedRecord(cgmSensor_t *pSensor, cgmMeasPacked_t *pPacked);
+static cgmMeasPacked_t *cgmMeasDBReserve(cgmSensor_t *pSensor, uint16 offset);
+static void cgmMeasPack(cgmMeasPacked_t *pPacked, cgmMeasC_t *pMeas);
+#if (FEATURE_GLUCOSE_WIRE_IMAGE_DB==0)
+static void cgmMeasUnpack(cgmMeasC_t *pMeas, cgmMeasPacked_t *pPacked);
+#endif /*FEATURE_GLUCOSE_WIRE_IMAGE_DB==0*/
 static void cgmProcessRACPMsg( cgmRACPMsg_t * pMsg);
-static void cgmRACPSendNextMeas();
-static void cgmResetMeasDB();
-static uint8 cgmRACPClearRecord(uint8 startindx, uint8 endindx, uint16 count);  
+static void cgmRACPSendNextMeas(cgmSensor_t *pSensor, cgmSession_t *pSession, uint8 sent);
+static bStatus_t cgmRACPSendRecord(cgmSensor_t *pSensor, cgmSession_t *pSession);
+static void cgmRACPStartSend(cgmSensor_t *pSensor, cgmSession_t *pSession);
+static void cgmRACPStopSend(cgmSensor_t *pSensor, cgmSession_t *pSession);
+static cgmSession_t *cgmSessionFind(cgmSensor_t *pSensor, uint16 connHandle, uint8 open);
+static void cgmSessionClose(cgmSensor_t *pSensor, uint16 connHandle);
+static uint8 cgmSessionSending(cgmSensor_t *pSensor);
+static void cgmResetMeasDB(cgmSensor_t *pSensor);
+static uint8 cgmRACPClearRecord(cgmSensor_t *pSensor, cgmMeasDBIndx_t startindx, cgmMeasDBIndx_t endindx, cgmMeasDBIndx_t count);
 //CGM measurement related functions
-static void cgmMeasSend(void);
-static void cgmNewGlucoseMeas(cgmMeasC_t * pMeas);
+static void cgmMeasSend(cgmSensor_t *pSensor);
+static void cgmTxSchedLive(cgmSensor_t *pSensor);
+static void cgmTxSchedRun(cgmSensor_t *pSensor);
+static void cgmTxSchedUpdate(cgmSensor_t *pSensor);
+static uint8 cgmMeasSerialize(cgmMeasC_t *pMeas, uint8 *pBuf);
+static void cgmNewGlucoseMeas(cgmSensor_t *pSensor, cgmMeasC_t * pMeas);
+static void cgmNewGlucoseMeasBatch(cgmSensor_t *pSensor, cgmMeasC_t *pMeas, uint16 num);
+static uint8 cgmMeasSize(uint8 flags);
+static void cgmStartMeasTimer(uint16 interval);
+static void cgmStopMeasTimer(void);
+static bool cgmSessionExpired(void);
 //CGM application level functions
-static void cgmservice_cb(uint8 event, uint8* valueP, uint8 *len, uint8 * result);
+static void cgmservice_cb(uint16 connHandle, uint8 event, uint8* valueP, uint8 *len, uint8 * result);
 static void cgmSimulationAppInit();
+static void cgmSensorInit(cgmSensor_t *pSensor, cgmMeasDBIndx_t dbSize);
+#if (FEATURE_GLUCOSE_PERSISTENT_LOG==1)
+static void cgmLogRestore(cgmSensor_t *pSensor);
+static void cgmLogRestoreRecord(void *pRecord, void *pContext);
+static void cgmLogDeleteRecords(cgmSensor_t *pSensor, cgmMeasDBIndx_t startindx, cgmMeasDBIndx_t endindx, cgmMeasDBIndx_t count);
+#endif /*FEATURE_GLUCOSE_PERSISTENT_LOG==1*/
 static void cgm_ProcessOSALMsg( osal_event_hdr_t *pMsg );
 #if (FEATURE_GLUCOSE_CALIBRATION==1)
 static int8 cgmCaliAddRecord(cgmCalibrationDataRecord_t *inputrecord);
@@ -450,31 +666,26 @@ static void cgmResetCaliDB(void);
 #if (FEATURE_GLUCOSE_PATIENTHIGHLOW==1)
 static void cgmPHighVerifyInput(SFLOAT input, uint8 *result);
 static int8 cgmPHighProcessInput(SFLOAT input);
-static void cgmPHighReset(void);
-static int32 cgmPHighTest(SFLOAT currentConcentration);
 static void cgmPLowVerifyInput(SFLOAT input, uint8 *result);
 static int8 cgmPLowProcessInput(SFLOAT input);
-static void cgmPLowReset(void);
-static int32 cgmPLowTest(SFLOAT currentConcentration);
 #endif /*FEATURE_GLUCOSE_PATIENTHIGHLOW==1*/
 #if (FEATURE_GLUCOSE_HYPERALERT==1)
-static int32 cgmAHyperTest(SFLOAT currentConcentration);
 static void cgmAHyperVerifyInput(SFLOAT input, uint8 *result);
 static int8 cgmAHyperProcessInput(SFLOAT input);
-static void cgmAHyperReset(void);
 #endif /*FEATURE_GLUCOSE_HYPERALERT*/
 #if (FEATURE_GLUCOSE_HYPOALERT==1)
-static int32 cgmAHypoTest(SFLOAT currentConcentration);
 static void cgmAHypoVerifyInput(SFLOAT input, uint8 *result);
 static int8 cgmAHypoProcessInput(SFLOAT input);
-static void cgmAHypoReset(void);
 #endif /*FEATURE_GLUCOSE_HYPOALERT*/
 #if (FEATURE_GLUCOSE_RATEALERT==1)
-static void cgmARateReset(void);
 static int8 cgmARateProcessInput(SFLOAT input, uint8 opcode);
 static void cgmARateVerifyInput(SFLOAT input, uint8 *result);
-static int32 cgmARateTest(SFLOAT currentRate);
 #endif /*FEATURE_GLUCOSE_RATEALERT*/
+static void cgmAlertReset(void);
+static void cgmAlertSet(uint8 alert, SFLOAT input);
+static uint8 cgmAlertFromOpcode(uint8 opcode);
+static uint8 cgmAlertConfigure(uint8 alert, uint8 enable, SFLOAT hysteresis);
+static void cgmAlertEvaluate(const int16 *pGlucose, const int16 *pRate, uint32 *pAlerts, uint16 num);
 #if (FEATURE_GLUCOSE_QUALITY==1)
 static SFLOAT cgmGQuality(SFLOAT input);
 #endif
@@ -492,6 +703,30 @@ static gapRolesCBs_t cgm_PeripheralCBs =
 	cgmGapStateCB,  	///< Profile State Change Callbacks
 	NULL                	///< When a valid RSSI is read from controller
 };
+
+/**
+  @ingroup appgrp
+    @brief   Bring a sensor to its power-up state: an empty history database, the default
+	     measurement interval and status, and the simulation data rewound to the beginning.
+  @param   pSensor - the sensor to initialize.
+  @param   dbSize - the number of records the history database holds, at most CGM_MEAS_DB_SIZE.
+  @return  none*/
+static void cgmSensorInit(cgmSensor_t *pSensor, cgmMeasDBIndx_t dbSize)
+{
+	uint8 i;
+
+	osal_memset(pSensor,0,sizeof(cgmSensor_t));
+	if (dbSize>CGM_MEAS_DB_SIZE)
+		dbSize=CGM_MEAS_DB_SIZE;
+	pSensor->measDB=(cgmMeasPacked_t *)CGM_MEAS_DB_ALLOC((uint32)dbSize*sizeof(cgmMeasPacked_t));
+	if (pSensor->measDB!=NULL)
+		pSensor->measDBSize=dbSize;
+	for (i=0;i<CGM_SESSIONS;i++)
+		pSensor->session[i].connHandle=INVALID_CONNHANDLE;
+	pSensor->commInterval=DEFAULT_NOTI_PERIOD;
+	pSensor->status.timeOffset=0x1234;	//Default value is for testing purpose.
+	pSensor->status.cgmStatus=0x000000;
+}
 /// \ingroup securitygrp
 /// \brief Bond Manager Callbacks
 static const gapBondCBs_t cgmBondCB =
@@ -601,7 +836,7 @@ void CGM_Init( uint8 task_id )
 	osal_set_event( cgmTaskId, START_DEVICE_EVT );
 
 	//this command starts the CGM measurement record generation right after device reset
-	osal_start_timerEx( cgmTaskId, NOTI_TIMEOUT_EVT, cgmCommInterval);	
+	cgmStartMeasTimer(cgmSensor.commInterval);
         cgmSessionStartIndicator=true;
         
 }
@@ -651,19 +886,38 @@ uint16 CGM_ProcessEvent( uint8 task_id, uint16 events )
 	//The event to send CGM measurement
 	if ( events & NOTI_TIMEOUT_EVT )
 	{
+#if (FEATURE_GLUCOSE_VIRTUAL_TIME==1)
+		//The interval has passed on the virtual clock
+		osal_setClock(osal_getClock()+cgmSensor.commInterval/1000);
+#endif /*FEATURE_GLUCOSE_VIRTUAL_TIME==1*/
 		// Send the current value of the CGM reading
 		//Generate New Measurement
-		cgmNewGlucoseMeas(&cgmCurrentMeas);
+		cgmNewGlucoseMeas(&cgmSensor, &cgmSensor.currentMeas);
 		//Add the generated record to database
-		cgmAddRecord(&cgmCurrentMeas);
-		cgmMeasSend();
+		cgmAddRecord(&cgmSensor, &cgmSensor.currentMeas);
+#if (FEATURE_GLUCOSE_PERSISTENT_LOG==1)
+		if (cgmSensor.measDBSize!=0)	//No history, when it could not be allocated
+			cgmLogAppend(cgmSensor.measDB+cgmSensor.measDBWriteIndx);
+#endif /*FEATURE_GLUCOSE_PERSISTENT_LOG==1*/
+		cgmMeasSend(&cgmSensor);
+		//Use the rest of the interval to compact the records deleted through the RACP
+		cgmMeasDBCompact(&cgmSensor, CGM_MEAS_DB_COMPACT_STEP);
+		//Stop generating once the sensor has reached the end of its run time
+		if (cgmSessionExpired())
+		{
+			cgmSensor.status.cgmStatus |= CGM_STATUS_ANNUNC_SES_STOP;
+			cgmSessionStartIndicator=false;
+			return ( events ^ NOTI_TIMEOUT_EVT );
+		}
+		//Start timing for the next update cycle.
+		cgmStartMeasTimer(cgmSensor.commInterval);
 		return ( events ^ NOTI_TIMEOUT_EVT );
 	}
 
-	//The event to send RACP record to the collector
+	//The event to send the waiting live measurement and the RACP records to the collector
 	if ( events & RACP_IND_SEND_EVT)
 	{
-		cgmRACPSendNextMeas();
+		cgmTxSchedRun(&cgmSensor);
 		return (events ^ RACP_IND_SEND_EVT);
 	}
 	return 0;
@@ -749,12 +1003,13 @@ static void cgmProcessCtlPntMsg (cgmCtlPntMsg_t * pMsg)
 	uint8 roperand[CGM_CTL_PNT_MAX_SIZE];//the operand in reuturn char value
 	uint8 roperand_len;//length of the response operand
 	SFLOAT sftemp;//temporary variable to hold a SFLOAT
+	uint8 alert;//the alert table entry of an alert configuration
 
 	switch(opcode)
 	{ 	//Implement the set/get communication interval
 		case CGM_SPEC_OP_GET_INTERVAL:
 			ropcode=CGM_SPEC_OP_RESP_INTERVAL;
-			roperand[0]= (cgmCommInterval/1000)&0xFF;
+			roperand[0]= (cgmSensor.commInterval/1000)&0xFF;
 			roperand_len=1;
 			break;
 		case CGM_SPEC_OP_SET_INTERVAL:
@@ -770,20 +1025,20 @@ static void cgmProcessCtlPntMsg (cgmCtlPntMsg_t * pMsg)
 			{
 				if ((*operand)==0) //input value being 0x00 would stop the timer.
 				{
-					osal_stop_timerEx(cgmTaskId,NOTI_TIMEOUT_EVT);
-                                        cgmCommInterval=0; //PTS TP/CGMCP/BV-05-C requires setting the interval to 0.
+					cgmStopMeasTimer();
+                                        cgmSensor.commInterval=0; //PTS TP/CGMCP/BV-05-C requires setting the interval to 0.
 				}
 				else if((*operand)==0xFF)
 				{
-					cgmCommInterval=1000*1; //fastest
+					cgmSensor.commInterval=1000*1; //fastest
 					if(cgmSessionStartIndicator==true)
-					osal_start_timerEx(cgmTaskId,NOTI_TIMEOUT_EVT,cgmCommInterval);
+					cgmStartMeasTimer(cgmSensor.commInterval);
 				}
 				else              
 				{
-					cgmCommInterval=(uint16)1000*(*operand); // in ms
+					cgmSensor.commInterval=(uint16)1000*(*operand); // in ms
 					if(cgmSessionStartIndicator==true)
-					osal_start_timerEx(cgmTaskId,NOTI_TIMEOUT_EVT,cgmCommInterval);
+					cgmStartMeasTimer(cgmSensor.commInterval);
 				}
 				roperand[0]=opcode;
 				roperand[1]=CGM_SPEC_OP_RESP_SUCCESS; 
@@ -803,7 +1058,7 @@ static void cgmProcessCtlPntMsg (cgmCtlPntMsg_t * pMsg)
                                 break;
 			}
                         //If the communication interval is disabled
-                        if (cgmCommInterval==0){
+                        if (cgmSensor.commInterval==0){
                           ropcode=CGM_SPEC_OP_RESP_CODE;
                           roperand[0]=opcode;
                           roperand[1]=CGM_SPEC_OP_RESP_PROCEDURE_NOT_COMPLETE;
@@ -811,26 +1066,29 @@ static void cgmProcessCtlPntMsg (cgmCtlPntMsg_t * pMsg)
                           break;
                         }
 			//Reset the sensor state
-			cgmResetMeasDB();
+			cgmResetMeasDB(&cgmSensor);
+#if (FEATURE_GLUCOSE_PERSISTENT_LOG==1)
+			cgmLogReset();
+#endif /*FEATURE_GLUCOSE_PERSISTENT_LOG==1*/
 #if (FEATURE_GLUCOSE_CALIBRATION==1)
 			cgmResetCaliDB();
 #endif /*FEATURE_GLUCOSE_CALIBRATION==1)*/
 			cgmSessionStartIndicator=true;
-			cgmStatus.cgmStatus &= (~CGM_STATUS_ANNUNC_SES_STOP);
-			cgmTimeOffset=0;
+			cgmSensor.status.cgmStatus &= (~CGM_STATUS_ANNUNC_SES_STOP);
+			cgmSensor.timeOffset=0;
 			if(cgmStartTimeConfigIndicator==false)
 				cgmStartTime_UTC=0;
 			osal_setClock(0);
-                        osal_start_timerEx(cgmTaskId,NOTI_TIMEOUT_EVT,cgmCommInterval);
+                        cgmStartMeasTimer(cgmSensor.commInterval);
                  	ropcode=CGM_SPEC_OP_RESP_CODE;
 			roperand[0]=opcode;
 			roperand[1]=CGM_SPEC_OP_RESP_SUCCESS;
 			roperand_len=2;
 			break;
 		case CGM_SPEC_OP_STOP_SES:
-			osal_stop_timerEx(cgmTaskId,NOTI_TIMEOUT_EVT);
+			cgmStopMeasTimer();
 			//Change the sensor status
-			cgmStatus.cgmStatus|= CGM_STATUS_ANNUNC_SES_STOP;
+			cgmSensor.status.cgmStatus|= CGM_STATUS_ANNUNC_SES_STOP;
 			cgmSessionStartIndicator=false;
 			ropcode=CGM_SPEC_OP_RESP_CODE;
 			roperand[0]=opcode;
@@ -923,8 +1181,8 @@ static void cgmProcessCtlPntMsg (cgmCtlPntMsg_t * pMsg)
 		case  CGM_SPEC_OP_GET_ALERT_HIGH:
 			//Prepare the response message.		  
 			ropcode = CGM_SPEC_OP_RESP_ALERT_HIGH;
-			roperand[0]=LO_UINT16(cgmPatientHigh);
-			roperand[1]=HI_UINT16(cgmPatientHigh);
+			roperand[0]=LO_UINT16(cgmAlertTable[CGM_ALERT_PHIGH].setting);
+			roperand[1]=HI_UINT16(cgmAlertTable[CGM_ALERT_PHIGH].setting);
 			roperand_len = 2;
 			break;
 		case  CGM_SPEC_OP_SET_ALERT_LOW:		
@@ -945,8 +1203,8 @@ static void cgmProcessCtlPntMsg (cgmCtlPntMsg_t * pMsg)
 		case  CGM_SPEC_OP_GET_ALERT_LOW:		
 			//Prepare the response message.		  
 			ropcode = CGM_SPEC_OP_RESP_ALERT_LOW;
-			roperand[0]=LO_UINT16(cgmPatientLow);
-			roperand[1]=HI_UINT16(cgmPatientLow);
+			roperand[0]=LO_UINT16(cgmAlertTable[CGM_ALERT_PLOW].setting);
+			roperand[1]=HI_UINT16(cgmAlertTable[CGM_ALERT_PLOW].setting);
 			roperand_len = 2;
 			break;
 #endif /*FEATURE_GLUCOSE_PATIENTHIGHLOW==1*/
@@ -967,8 +1225,8 @@ static void cgmProcessCtlPntMsg (cgmCtlPntMsg_t * pMsg)
 		case  CGM_SPEC_OP_GET_ALERT_HYPER:		
 			//Get the local hyperglycemia threshold value and load it into the response message buffer
 			ropcode=CGM_SPEC_OP_RESP_ALERT_HYPER;
-			roperand[0]=LO_UINT16(cgmHyperThreshold);
-			roperand[1]=HI_UINT16(cgmHyperThreshold);
+			roperand[0]=LO_UINT16(cgmAlertTable[CGM_ALERT_HYPER].setting);
+			roperand[1]=HI_UINT16(cgmAlertTable[CGM_ALERT_HYPER].setting);
 			roperand_len=2;
 			break;
 #endif /*FEATURE_GLUCOSE_HYPERALERT==1*/
@@ -989,8 +1247,8 @@ static void cgmProcessCtlPntMsg (cgmCtlPntMsg_t * pMsg)
 		case  CGM_SPEC_OP_GET_ALERT_HYPO:		
 			//Get the local hypoglycemia threshold value and load it into the response message buffer
 			ropcode=CGM_SPEC_OP_RESP_ALERT_HYPO;
-			roperand[0]=LO_UINT16(cgmHypoThreshold);
-			roperand[1]=HI_UINT16(cgmHypoThreshold);
+			roperand[0]=LO_UINT16(cgmAlertTable[CGM_ALERT_HYPO].setting);
+			roperand[1]=HI_UINT16(cgmAlertTable[CGM_ALERT_HYPO].setting);
 			roperand_len=2;
 			break;
 #endif /*FEATURE_GLUCOSE_HYPOALERT==1*/
@@ -1008,26 +1266,55 @@ static void cgmProcessCtlPntMsg (cgmCtlPntMsg_t * pMsg)
 			break;
 		case  CGM_SPEC_OP_GET_ALERT_RATE_DECREASE:		
 			ropcode=CGM_SPEC_OP_RESP_ALERT_RATE_DECREASE;
-			roperand[0]=LO_UINT16(cgmDecreaseThreshold);
-			roperand[1]=HI_UINT16(cgmDecreaseThreshold);
+			roperand[0]=LO_UINT16(cgmAlertTable[CGM_ALERT_RATE_DECREASE].setting);
+			roperand[1]=HI_UINT16(cgmAlertTable[CGM_ALERT_RATE_DECREASE].setting);
 			roperand_len=2;
 			break;
                 case  CGM_SPEC_OP_GET_ALERT_RATE_INCREASE:
                   	ropcode=CGM_SPEC_OP_RESP_ALERT_RATE_INCREASE;
-			roperand[0]=LO_UINT16(cgmIncreaseThreshold);
-			roperand[1]=HI_UINT16(cgmIncreaseThreshold);
+			roperand[0]=LO_UINT16(cgmAlertTable[CGM_ALERT_RATE_INCREASE].setting);
+			roperand[1]=HI_UINT16(cgmAlertTable[CGM_ALERT_RATE_INCREASE].setting);
 			roperand_len=2;
                         break;
 #endif /*FEATURE_GLUCOSE_RATEALERT==1*/
 #if (FEATURE_GLUCOSE_DEVICE_ALERT==1)
 		case CGM_SPEC_OP_RESET_ALERT_DEVICE_SPEC:
-			cgmStatus.cgmStatus ^= CGM_STATUS_ANNUNC_DEVICE_SPEC_ALERT;  
+			cgmSensor.status.cgmStatus ^= CGM_STATUS_ANNUNC_DEVICE_SPEC_ALERT;  
 			ropcode=CGM_SPEC_OP_RESP_CODE;
 			roperand[0]=opcode;
 			roperand[1]=CGM_SPEC_OP_RESP_SUCCESS;
 			roperand_len=2;
 			break;
 #endif /*(FEATURE_GLUCOSE_DEVICE_ALERT==1)*/
+		//Vendor extension: the enable bit and the hysteresis of the alerts
+		case CGM_SPEC_OP_SET_ALERT_CONFIG:
+			alert=(operand_len>=4) ? cgmAlertFromOpcode(pMsg->data[1]) : CGM_ALERT_NUM;
+			ropcode=CGM_SPEC_OP_RESP_CODE;
+			roperand[0]=opcode;
+			if (alert==CGM_ALERT_NUM || pMsg->data[2]>1)
+				roperand[1]=CGM_SPEC_OP_RESP_OPERAND_INVALID;
+			else
+				roperand[1]=cgmAlertConfigure(alert, pMsg->data[2], BUILD_UINT16(pMsg->data[3],pMsg->data[4]));
+			roperand_len=2;
+			break;
+		case CGM_SPEC_OP_GET_ALERT_CONFIG:
+			alert=(operand_len>=1) ? cgmAlertFromOpcode(pMsg->data[1]) : CGM_ALERT_NUM;
+			if (alert==CGM_ALERT_NUM)
+			{
+				ropcode=CGM_SPEC_OP_RESP_CODE;
+				roperand[0]=opcode;
+				roperand[1]=CGM_SPEC_OP_RESP_OPERAND_INVALID;
+				roperand_len=2;
+				break;
+			}
+			sftemp=sfloatEncode(cgmAlertTable[alert].hysteresis, (cgmAlertTable[alert].flags & CGM_ALERT_ON_TREND) ? -1 : 0);
+			ropcode=CGM_SPEC_OP_RESP_ALERT_CONFIG;
+			roperand[0]=pMsg->data[1];
+			roperand[1]=cgmAlertTable[alert].enabled ? 1 : 0;
+			roperand[2]=LO_UINT16(sftemp);
+			roperand[3]=HI_UINT16(sftemp);
+			roperand_len=4;
+			break;
 		//Other functions are not implemented
 		default:
 			ropcode=CGM_SPEC_OP_RESP_CODE;
@@ -1036,7 +1323,7 @@ static void cgmProcessCtlPntMsg (cgmCtlPntMsg_t * pMsg)
 			roperand_len=2;
 			break;
 	}
-	cgmCtlPntResponse(ropcode,roperand,roperand_len);
+	cgmCtlPntResponse(pMsg->connHandle,ropcode,roperand,roperand_len);
 }
 
 
@@ -1050,6 +1337,10 @@ static void cgmGapStateCB( gaprole_States_t newState )
 	// if connected
 	if ( newState == GAPROLE_CONNECTED )
 	{
+		uint16 connHandle;
+		// Open the session of the new link, so that it gets the live measurements also when its CCC is restored from a bond
+		GAPRole_GetParameter( GAPROLE_CONNHANDLE, &connHandle );
+		cgmSessionFind(&cgmSensor, connHandle, true);
 	}
 	// if disconnected
 	else if (gapProfileState == GAPROLE_CONNECTED &&
@@ -1117,12 +1408,15 @@ static void cgmGapStateCB( gaprole_States_t newState )
   @return  none*/
 static void cgmPairStateCB( uint16 connHandle, uint8 state, uint8 status )
 {
+	//The bond manager restores the CCCs of a bonded collector without the service write callback
+	if ( state == GAPBOND_PAIRING_STATE_COMPLETE || state == GAPBOND_PAIRING_STATE_BONDED )
+		CGM_MeasSubscriberSync( connHandle );
 	if ( state == GAPBOND_PAIRING_STATE_COMPLETE )
 	{
 		if ( status == SUCCESS )
 		{
 			linkDBItem_t  *pItem;
-			if ( (pItem = linkDB_Find( gapConnHandle )) != NULL )
+			if ( (pItem = linkDB_Find( connHandle )) != NULL )
 			{
 				// Store bonding state of pairing
 				cgmBonded = ( (pItem->stateFlags & LINK_BOUND) == LINK_BOUND );
@@ -1148,73 +1442,278 @@ static void cgmPasscodeCB( uint8 *deviceAddr, uint16 connectionHandle, uint8 uiI
 
 /**
   @ingroup glucosemeasgrp
- *   @brief   Send the most current record stored in cgmCurrentMeas as a GATT notification to the CGM measurement characteristic.
+    @brief   Schedule the next glucose measurement cycle.
+    @details With FEATURE_GLUCOSE_VIRTUAL_TIME enabled no timer is started. The measurement event is raised 
+             right away, and the OSAL clock is moved forward by the interval when the event is handled, as if the 
+             timer had expired. Scheduling again while the event is pending, e.g. on an interval change, thus does 
+             not move the clock twice. The time offset, the clock and the session run time advance exactly as on 
+             the real timer, only at CPU speed.
+  @param   interval - the time until the next measurement in ms.
+  @return  none*/
+static void cgmStartMeasTimer(uint16 interval)
+{
+#if (FEATURE_GLUCOSE_VIRTUAL_TIME==1)
+	VOID interval; // The clock is moved forward by the interval when the event is handled
+	osal_set_event(cgmTaskId, NOTI_TIMEOUT_EVT);
+#else
+	osal_start_timerEx(cgmTaskId, NOTI_TIMEOUT_EVT, interval);
+#endif /*FEATURE_GLUCOSE_VIRTUAL_TIME==1*/
+}
+
+/**
+  @ingroup glucosemeasgrp
+    @brief   Cancel the pending glucose measurement cycle, whether it is waiting on the timer or already raised on the virtual clock.
+  @return  none*/
+static void cgmStopMeasTimer(void)
+{
+	osal_stop_timerEx(cgmTaskId, NOTI_TIMEOUT_EVT);
+#if (FEATURE_GLUCOSE_VIRTUAL_TIME==1)
+	osal_clear_event(cgmTaskId, NOTI_TIMEOUT_EVT);
+#endif /*FEATURE_GLUCOSE_VIRTUAL_TIME==1*/
+}
+
+/**
+  @ingroup runtimegrp
+    @brief   Check whether the current session has lasted for the sensor run time.
+    @details The OSAL clock is reset to 0 when a session starts, so it holds the session age in seconds 
+             on both the real and the virtual clock. The run time is kept in hours.
+  @return  true if the session has expired, false otherwise*/
+static bool cgmSessionExpired(void)
+{
+	return (osal_getClock() >= (UTCTime)cgmSessionRunTime*3600);
+}
+
+/**
+  @ingroup glucosemeasgrp
+ *   @brief   Send the most current record stored in the sensor as a GATT notification to the CGM measurement characteristic.
+  @param   pSensor - the sensor whose current measurement is sent.
+  @return  none*/
+static void cgmMeasSend(cgmSensor_t *pSensor)
+{
+	CGMMeas.len=cgmMeasSerialize(&pSensor->currentMeas, CGMMeas.value);
+	cgmTxSchedLive(pSensor);
+}
+
+/**
+  @ingroup glucosemeasgrp
+    @brief   Hand the live measurement in CGMMeas to the stack, ahead of any RACP record.
+  @details The measurement is serialized once and broadcast to every subscribed connection. The records of a
+  	    RACP transfer may hold all the TX buffers of a link. A measurement the stack refuses waits for the end
+  	    of the next connection event, where cgmTxSchedRun sends it before any record. A newer measurement
+  	    replaces one still waiting, so only the freshest is sent, well within one interval.
+  @param   pSensor - the sensor whose measurement is sent.
+  @return  none*/
+static void cgmTxSchedLive(cgmSensor_t *pSensor)
+{
+	if (pSensor->tx.livePending)
+		pSensor->tx.liveSuperseded++;
+	pSensor->tx.livePending=CGM_MeasBroadcast(CGM_CONN_ALL, &CGMMeas);
+	if (pSensor->tx.livePending)
+	{
+		pSensor->tx.liveWait=0;
+		pSensor->tx.liveDeferred++;
+	}
+	cgmTxSchedUpdate(pSensor);
+}
+
+/**
+  @ingroup glucosemeasgrp
+    @brief   Fill the TX buffers released at the end of a connection event, by priority.
+  @details On the link of each session, the waiting live measurement goes first. The RACP transfer of the
+  	    session then takes what is left of its credits. When the stack still refuses the live measurement,
+  	    nothing else is sent on that link in this event.
+  @param   pSensor - the sensor whose measurements are sent.
+  @return  none*/
+static void cgmTxSchedRun(cgmSensor_t *pSensor)
+{
+	uint8 waiting=pSensor->tx.livePending;
+	uint8 bit;
+	uint8 i;
+	cgmSession_t *pSession;
+	cgmMeasDBIndx_t depth=0;
+
+	for (i=0;i<CGM_SESSIONS;i++)
+		depth+=pSensor->session[i].racp.remaining;
+	for (bit=waiting;bit;bit&=bit-1)
+		depth++;
+	if (depth>pSensor->tx.depthMax)
+		pSensor->tx.depthMax=depth;
+	if (waiting)
+	{
+		if (pSensor->tx.liveWait<0xFF)
+			pSensor->tx.liveWait++;
+		if (pSensor->tx.liveWait>pSensor->tx.liveWaitMax)
+			pSensor->tx.liveWaitMax=pSensor->tx.liveWait;
+		pSensor->tx.livePending=CGM_MeasBroadcast(waiting, &CGMMeas);
+	}
+	for (i=0,pSession=pSensor->session;i<CGM_SESSIONS;i++,pSession++)
+	{
+		if (pSession->connHandle==INVALID_CONNHANDLE)
+			continue;
+		bit=CGM_CONN_BIT(pSession->connHandle);
+		if (pSensor->tx.livePending & bit)
+			continue;
+		cgmRACPSendNextMeas(pSensor, pSession, (waiting & bit) ? 1 : 0);
+	}
+	cgmTxSchedUpdate(pSensor);
+}
+
+/**
+  @ingroup glucosemeasgrp
+    @brief   Run the TX scheduler at the end of every connection event while it has anything to send, and stop
+  	    it otherwise.
+  @param   pSensor - the sensor whose measurements are sent.
+  @return  none*/
+static void cgmTxSchedUpdate(cgmSensor_t *pSensor)
+{
+	uint8 busy=(pSensor->tx.livePending || cgmSessionSending(pSensor));
+
+	if (busy==pSensor->tx.armed)
+		return;
+	pSensor->tx.armed=busy;
+	if (busy)
+		HCI_EXT_ConnEventNoticeCmd(cgmTaskId, RACP_IND_SEND_EVT);
+	else
+	{
+		HCI_EXT_ConnEventNoticeCmd(cgmTaskId, 0);
+		osal_clear_event(cgmTaskId, RACP_IND_SEND_EVT);
+	}
+}
+
+/**
+  @ingroup racpgrp
+    @brief   Find the session of a connection.
+  @param   pSensor - the sensor serving the connection.
+  @param   connHandle - the connection handle.
+  @param   open - non zero to open a session when the connection has none.
+  @return  the session, NULL if there is none and none can be opened.*/
+static cgmSession_t *cgmSessionFind(cgmSensor_t *pSensor, uint16 connHandle, uint8 open)
+{
+	cgmSession_t *pFree=NULL;
+	uint8 i;
+
+	for (i=0;i<CGM_SESSIONS;i++)
+	{
+		if (pSensor->session[i].connHandle==connHandle)
+			return pSensor->session+i;
+		if (pFree==NULL && pSensor->session[i].connHandle==INVALID_CONNHANDLE)
+			pFree=pSensor->session+i;
+	}
+	if (!open || pFree==NULL || connHandle>=CGM_CONN_MAX)
+		return NULL;
+	osal_memset(pFree,0,sizeof(cgmSession_t));
+	pFree->connHandle=connHandle;
+	return pFree;
+}
+
+/**
+  @ingroup racpgrp
+    @brief   Close the session of a connection whose link is down, ending its RACP transfer.
+  @param   pSensor - the sensor serving the connection.
+  @param   connHandle - the connection handle.
   @return  none*/
-static void cgmMeasSend(void)
-{
-	//att value notification structure
-	uint8 *p=CGMMeas.value;
-	uint8 flags=cgmCurrentMeas.flags;
-	//load data into the package buffer
-	*p++ = cgmCurrentMeas.size;
-	*p++ = flags;
-	*p++ = LO_UINT16(cgmCurrentMeas.concentration);
-	*p++ = HI_UINT16(cgmCurrentMeas.concentration);
-	*p++ = LO_UINT16(cgmCurrentMeas.timeoffset);
-	*p++ = HI_UINT16(cgmCurrentMeas.timeoffset);
+static void cgmSessionClose(cgmSensor_t *pSensor, uint16 connHandle)
+{
+	cgmSession_t *pSession=cgmSessionFind(pSensor, connHandle, false);
+
+	if (pSession==NULL)
+		return;
+	pSensor->tx.livePending&=~CGM_CONN_BIT(connHandle);
+	cgmRACPStopSend(pSensor, pSession);
+	pSession->connHandle=INVALID_CONNHANDLE;
+}
+
+/**
+  @ingroup racpgrp
+    @brief   Check whether any session has a RACP transfer in progress.
+  @param   pSensor - the sensor owning the sessions.
+  @return  non zero when a transfer is in progress.*/
+static uint8 cgmSessionSending(cgmSensor_t *pSensor)
+{
+	uint8 i;
+
+	for (i=0;i<CGM_SESSIONS;i++)
+		if (pSensor->session[i].racp.state!=CGM_RACP_PROC_IDLE)
+			return true;
+	return false;
+}
+
+/**
+  @ingroup glucosemeasgrp
+    @brief   Encode a CGM measurement in its on-air format, straight into the value of an outgoing PDU.
+  @details This is the only encoder of the CGM measurement characteristic, used by both the live notifications
+  	    and the RACP transfers. The optional fields follow the flags, and the E2E-CRC is calculated while
+  	    the bytes are written.
+  @param   pMeas - the measurement to be encoded.
+  @param   pBuf - the PDU value to write to. It must hold pMeas->size bytes.
+  @return  the number of bytes written.*/
+static uint8 cgmMeasSerialize(cgmMeasC_t *pMeas, uint8 *pBuf)
+{
+	uint8 *p=pBuf;
+	uint8 flags=pMeas->flags;
+#if (FEATURE_GLUCOSE_CRC==1)
+	uint16 crc_temp=CCITT_CRC16_INIT;
+#endif /* FEATURE_GLUCOSE_CRC==1*/
+	//load data into the package buffer, calculating the CCITT-CRC on the way
+	CGM_PDU_PUT(p, crc_temp, pMeas->size);
+	CGM_PDU_PUT(p, crc_temp, flags);
+	CGM_PDU_PUT(p, crc_temp, LO_UINT16(pMeas->concentration));
+	CGM_PDU_PUT(p, crc_temp, HI_UINT16(pMeas->concentration));
+	CGM_PDU_PUT(p, crc_temp, LO_UINT16(pMeas->timeoffset));
+	CGM_PDU_PUT(p, crc_temp, HI_UINT16(pMeas->timeoffset));
 	//The following portion is optionally present depending on the flag field of the record
 	if (flags & CGM_STATUS_ANNUNC_STATUS_OCT)
-		*p++ = (cgmCurrentMeas.annunciation) & 0xFF;
+		CGM_PDU_PUT(p, crc_temp, (pMeas->annunciation) & 0xFF);
 	if (flags & CGM_STATUS_ANNUNC_WARNING_OCT)
-		*p++ = (cgmCurrentMeas.annunciation>>16) & 0xFF;
+		CGM_PDU_PUT(p, crc_temp, (pMeas->annunciation>>16) & 0xFF);
 	if (flags & CGM_STATUS_ANNUNC_CAL_TEMP_OCT)
-		*p++ = (cgmCurrentMeas.annunciation>>8)  & 0xFF;
+		CGM_PDU_PUT(p, crc_temp, (pMeas->annunciation>>8)  & 0xFF);
 	if (flags & CGM_TREND_INFO_PRES)
-	{  *p++ = LO_UINT16(cgmCurrentMeas.trend);
-		*p++ = HI_UINT16(cgmCurrentMeas.trend);
+	{  
+		CGM_PDU_PUT(p, crc_temp, LO_UINT16(pMeas->trend));
+		CGM_PDU_PUT(p, crc_temp, HI_UINT16(pMeas->trend));
 	}
 	if (flags & CGM_QUALITY_PRES)
 	{ 
-		*p++ = LO_UINT16(cgmCurrentMeas.quality);
-		*p++ = HI_UINT16(cgmCurrentMeas.quality);
+		CGM_PDU_PUT(p, crc_temp, LO_UINT16(pMeas->quality));
+		CGM_PDU_PUT(p, crc_temp, HI_UINT16(pMeas->quality));
 	}	
-	CGMMeas.len=cgmCurrentMeas.size;
 #if (FEATURE_GLUCOSE_CRC==1)
-	uint16 crc_temp=0;
-	//Calculate the CCITT-CRC
-	crc_temp=ccitt_crc16(CGMMeas.value,CGMMeas.len);
 	//Append the CRC to the message
+	crc_temp=ccitt_crc16_final(crc_temp);
 	*p++ = LO_UINT16(crc_temp);
 	*p++ = HI_UINT16(crc_temp);
 #endif /* FEATURE_GLUCOSE_CRC==1*/
-	CGM_MeasSend(gapConnHandle, &CGMMeas,  cgmTaskId);
-	//Start timing for the next update cycle.
-	osal_start_timerEx(cgmTaskId, NOTI_TIMEOUT_EVT, cgmCommInterval);
+	return (uint8)(p-pBuf);
 }
 
 /**
   @ingroup cgmcpgrp
     @brief   Send a record control point response
+  @param   connHandle - the connection the request was written on
   @param   opcode - response opcode 
   @param   roperand - address of the array storing the response operand
   @param   roperand_len - the length of the response operand array
   @return  none*/
-static void cgmCtlPntResponse(uint8 opcode, uint8 * roperand, uint8 roperand_len)
+static void cgmCtlPntResponse(uint16 connHandle, uint8 opcode, uint8 * roperand, uint8 roperand_len)
 {
         
 	cgmCtlPntRsp.value[0]=opcode;
 	cgmCtlPntRsp.len=1+roperand_len;
-	osal_memcpy(cgmCtlPntRsp.value+1,roperand, roperand_len);
  #if (FEATURE_GLUCOSE_CRC==1)
-	uint16 crc_temp=0;
-	//Calculate the CCITT-CRC
-	crc_temp=ccitt_crc16(CGMMeas.value,CGMMeas.len);
+	uint16 crc_temp=CCITT_CRC16_INIT;
+	//Copy the operand while calculating the CCITT-CRC
+	CCITT_CRC16_BYTE(crc_temp,opcode);
+	crc_temp=ccitt_crc16_copy(crc_temp, cgmCtlPntRsp.value+1, roperand, roperand_len);
+	crc_temp=ccitt_crc16_final(crc_temp);
 	//Append the CRC to the message
 	*(cgmCtlPntRsp.value+cgmCtlPntRsp.len) = LO_UINT16(crc_temp);
 	*(cgmCtlPntRsp.value+cgmCtlPntRsp.len+1) = HI_UINT16(crc_temp);
         cgmCtlPntRsp.len+=2;
+#else
+	osal_memcpy(cgmCtlPntRsp.value+1,roperand, roperand_len);
 #endif /* FEATURE_GLUCOSE_CRC==1*/
-	CGM_CtlPntIndicate(gapConnHandle, &cgmCtlPntRsp, cgmTaskId);
+	CGM_CtlPntIndicate(connHandle, &cgmCtlPntRsp, cgmTaskId);
 }
 
 
@@ -1222,12 +1721,13 @@ static void cgmCtlPntResponse(uint8 opcode, uint8 * roperand, uint8 roperand_len
   @ingroup gattgrp
     @brief   The callback function in the application layer when the GATT service layer receives
   	    read/write operation to one of the CGM service characteristic
+  @param   connHandle - the connection the operation came from
   @param   event - service event. Enumeration can be found in cgmservice.h  
   @param   valueP - data value past from the GATT layer to the Application Layer, or vice versa.
   @param   result - the address to the memory to pass the processing result back to the GATT layer
   @param   len - pointer to the length of the data residing in valueP
   @return  none */
-static void cgmservice_cb(uint8 event, uint8* valueP, uint8 *len, uint8 * result)
+static void cgmservice_cb(uint16 connHandle, uint8 event, uint8* valueP, uint8 *len, uint8 * result)
 {
         uint8* initP=valueP; // The pointer for the initial value
 #if (FEATURE_GLUCOSE_CRC==1)
@@ -1238,8 +1738,14 @@ static void cgmservice_cb(uint8 event, uint8* valueP, uint8 *len, uint8 * result
 	{
 		//when CGM measurement characteristic notification is enabled/disabled by the collector APP
 		case CGM_MEAS_NTF_ENABLED:
+				cgmSessionFind(&cgmSensor, connHandle, true);
+				break;
 		case CGM_MEAS_NTF_DISABLED:
 				break;
+		//when a collector is gone, along with its RACP transfer and the live measurement waiting for it
+		case CGM_LINK_DOWN:
+				cgmSessionClose(&cgmSensor, connHandle);
+				break;
 		//when the CGM feture characteristic is read by the collector APP
 		case CGM_FEATURE_READ_REQUEST:
 			{
@@ -1261,12 +1767,12 @@ static void cgmservice_cb(uint8 event, uint8* valueP, uint8 *len, uint8 * result
 		//when the CGM status characteristic is read by the collector APP
 		case CGM_STATUS_READ_REQUEST:
 			{
-				cgmStatus.timeOffset=(uint16)osal_getClock();
-				*valueP = LO_UINT16(cgmStatus.timeOffset);
-				*(++valueP) = HI_UINT16(cgmStatus.timeOffset);
-				*(++valueP) = BREAK_UINT32(cgmStatus.cgmStatus,0);
-				*(++valueP) = BREAK_UINT32(cgmStatus.cgmStatus,1);
-				*(++valueP) = BREAK_UINT32(cgmStatus.cgmStatus,2);
+				cgmSensor.status.timeOffset=(uint16)osal_getClock();
+				*valueP = LO_UINT16(cgmSensor.status.timeOffset);
+				*(++valueP) = HI_UINT16(cgmSensor.status.timeOffset);
+				*(++valueP) = BREAK_UINT32(cgmSensor.status.cgmStatus,0);
+				*(++valueP) = BREAK_UINT32(cgmSensor.status.cgmStatus,1);
+				*(++valueP) = BREAK_UINT32(cgmSensor.status.cgmStatus,2);
 #if (FEATURE_GLUCOSE_CRC==1)
                                 crc_temp = ccitt_crc16 (initP, 5);
                                 *(++valueP) =  LO_UINT16(crc_temp);
@@ -1370,19 +1876,23 @@ static void cgmservice_cb(uint8 event, uint8* valueP, uint8 *len, uint8 * result
 				if ( msgPtr )
 				{
 					msgPtr->hdr.event = CTL_PNT_MSG;
+					msgPtr->connHandle = connHandle;
 					msgPtr->len = *len;
-					osal_memcpy(msgPtr->data, valueP, *len);
 #if (FEATURE_GLUCOSE_CRC==1)
+					//Copy the written value while running the CRC over it
+					crc_temp=ccitt_crc16_copy(CCITT_CRC16_INIT, msgPtr->data, valueP, *len);
                                 //Test the presence of CRC
 			        if (cgmCtlPntMsgFindCRC(msgPtr)==0){
 					*result = ATT_ERR_MISSING_CRC;
 					break;
 				}
-                                //Test the validity of the CRC
-				if (ccitt_crc16_test(msgPtr->data,*len)==0){
+                                //Test the validity of the CRC, which leaves 0 when run over the message and its CRC
+				if (ccitt_crc16_final(crc_temp)!=0){
 					*result = ATT_ERR_INVALID_CRC;
 					break;
 				}
+#else
+					osal_memcpy(msgPtr->data, valueP, *len);
 #endif /* FEATURE_GLUCOSE_CRC==1*/ 
 				osal_msg_send( cgmTaskId, (uint8 *)msgPtr );
 				}
@@ -1397,12 +1907,21 @@ static void cgmservice_cb(uint8 event, uint8* valueP, uint8 *len, uint8 * result
 				if ( msgPtr )
 				{
 					msgPtr->hdr.event = RACP_MSG;
+					msgPtr->connHandle = connHandle;
 					msgPtr->len = *len;
 					osal_memcpy(msgPtr->data, valueP, *len);
 					osal_msg_send( cgmTaskId, (uint8 *)msgPtr );
 				}
 			}
 			break;
+		//The other events need nothing from the application. They are listed so that two events sharing a code do not build
+		case CGM_CONTEXT_NTF_ENABLED:
+		case CGM_CONTEXT_NTF_DISABLED:
+		case CGM_CTL_PNT_IND_ENABLED:
+		case CGM_CTL_PNT_IND_DISABLED:
+		case CGM_SESSION_START_TIME_CHANGED:
+		case CGM_RACP_IND_ENABLED:
+		case CGM_RACP_IND_DISABLED:
 		default:
 			break;
 	}
@@ -1465,113 +1984,148 @@ static uint8 cgmVerifyDSTOffset( uint8 input)
 /**
   @ingroup glucosemeasgrp
     @brief   Update with the lastest reading while updating the internal database
+  @param   pSensor - the sensor generating the measurement.
   @param   pMeas - address to store the generated cgm measurement.
   @return  none*/
-static void cgmNewGlucoseMeas(cgmMeasC_t * pMeas)
-{
-	//generate the glucose reading.
-	static uint16	glucoseGen=0x0000;	//The current glucose being generated	
-	static uint16	glucosePreviousGen=0;	//The previous glucose value
-	uint8		flag=0;			//The flag field of the glucose measurement characteristic
-	uint8		size=6;			//The size field of the glucose measurement characteristic
-	uint16		trend;			//The trend field of the glucose measurement characteristic
+static void cgmNewGlucoseMeas(cgmSensor_t *pSensor, cgmMeasC_t * pMeas)
+{
+	cgmNewGlucoseMeasBatch(pSensor, pMeas, 1);
+}
+
+/**
+  @ingroup glucosemeasgrp
+    @brief   Generate a run of consecutive glucose measurements, one communication interval apart.
+  @details The flags and size common to every record, and the interval, are worked out once for the run; only the
+	   concentration and the trend are done per record. The alerts are evaluated with one cgmAlertEvaluate call
+	   per chunk of up to CGM_ALERT_BATCH records. The sensor ends up as if cgmNewGlucoseMeas had been called num
+	   times.
+  @param   pSensor - the sensor generating the measurements.
+  @param   pMeas - the array receiving the measurements, in time order.
+  @param   num - the number of measurements to generate.
+  @return  none*/
+static void cgmNewGlucoseMeasBatch(cgmSensor_t *pSensor, cgmMeasC_t *pMeas, uint16 num)
+{
+	uint16		glucoseGen;		//The current glucose being generated
+	uint8		baseFlag=0;		//The flag bits shared by all the records of the run
+	uint8		baseSize;		//The size of a record without any annunciation octet
+	uint8		flag;			//The flag field of the glucose measurement characteristic
+	uint16		trend=0;		//The trend field of the glucose measurement characteristic
 	uint16		quality=0;		//The quality field of the glucose measurement characteristic
-	uint32		*annunciation=&(cgmStatus.cgmStatus);		//The annunciation field of the current glucose measurement characteristic
-	int32		currentGlucose_cal=0;	//The signed version of the current glucose value for caluculation of trend
-	int32		previousGlucose_cal=0;	//The signed version of the previous glucose value for calculation of trend 
-	uint16		offset_dif;		//The offset between current and previous record calculating trend 
+	uint32		*annunciation=&(pSensor->status.cgmStatus);		//The annunciation field of the current glucose measurement characteristic
+	uint16		offset_dif=pSensor->commInterval/1000;	//The offset between current and previous record calculating trend. EXTRA: currnt communication interval counts in ms.
 	int32		trend_cal;		//The signed version for trend calculation, which will be later converted to SFLOAT
+	int16		rate=0;			//The rate of change tested by the alerts, in 0.1 mg/dL/min
+	int16		levels[CGM_ALERT_BATCH];	//The concentrations of the chunk tested by the alerts
+	int16		rates[CGM_ALERT_BATCH];		//The rates of change of the chunk tested by the alerts
+	uint32		alerts[CGM_ALERT_BATCH];	//The alerts raised by each measurement of the chunk
+	uint16		chunk;			//The number of measurements of the chunk
+	uint16		i;
+
+	//Prepare the flag bits and the size, which do not depend on the values
+#if (FEATURE_GLUCOSE_TREND==1)
+	baseFlag |= CGM_TREND_INFO_PRES;
+#endif
+#if (FEATURE_GLUCOSE_QUALITY==1)
+	baseFlag |= CGM_QUALITY_PRES;
+#endif
+	baseSize=cgmMeasSize(baseFlag);
 
-	//Prepare the CGM measurement concentration value
-	glucosePreviousGen=glucoseGen;		// Store the current CGM measurement, which will be the previous value in the next call
-	glucoseGen =cgmGetNextData();		// Call the function to generate the next glucose value data point. Currently it is a simulation program drawing glucose value from a patient database
-	glucoseGen =( glucoseGen % 0x07FD); 	//Make sure the generated value fit into SFLOAT. In this application we fix the exponent of the SFLOAT to be 0
-	pMeas->concentration=glucoseGen;	//Write the value into the buffer 
-	
-	//Prepare the time offset 
-	pMeas->timeoffset=cgmTimeOffset & 0xFFFF;
-	cgmTimeOffset += cgmCommInterval/1000;	//Update the time offset for the next call. 
-	
-	//Prepare the trend field
-	if(cgmTimeOffset!=0)
+	for (;num>0;num-=chunk,pMeas+=chunk)
 	{
-		{ 
-			currentGlucose_cal=(glucoseGen & 0x07FF);
-			previousGlucose_cal=(glucosePreviousGen & 0x07FF);
-			offset_dif=cgmCommInterval/1000;	//EXTRA: currnt communication interval counts in ms.
-			trend_cal=(currentGlucose_cal-previousGlucose_cal)*10/offset_dif; //elevate the power by 10 to gain 1 digit accuracy, the highest resolution is 0.1mg/dl/min
-			//convert the calculation result to SFLOAT. For simplicity, we fix the exponent to be -1.
-			if (trend_cal>2045) 		//when exponent is -1, the mantissa can be at most 2045
-				trend=0x07FE;		//representing +infinity
-			else if (trend_cal<-2045)	//repeat the above for the negative region
-				trend=0x0F02;//-infinity
-			else
-				trend= (trend_cal & 0x0FFF) | 0xF000;
-		}
-	} 
+		chunk=(num<CGM_ALERT_BATCH) ? num : CGM_ALERT_BATCH;
+		//Generate the values of the chunk, collecting the inputs of the alerts
+		for (i=0;i<chunk;i++)
+		{
+			//Prepare the CGM measurement concentration value
+			pSensor->glucosePreviousGen=pSensor->glucoseGen;	// Store the current CGM measurement, which will be the previous value in the next call
+			glucoseGen =cgmSimInterpAt(&pSensor->simData, pSensor->simElapsed, CGM_GLUCOSE_INTERPOLATION);	// Call the function to generate the glucose value at the current time. Currently it is a simulation program drawing glucose value from a patient database
+			pSensor->simElapsed += offset_dif;
+			pSensor->glucoseGen=glucoseGen;
+			pMeas[i].concentration=SFLOAT_FROM_UNSIGNED(glucoseGen);	//Write the value into the buffer as a SFLOAT of exponent 0. A value beyond the mantissa reads as +infinity
+
+			//Prepare the time offset 
+			pMeas[i].timeoffset=pSensor->timeOffset & 0xFFFF;
+			pSensor->timeOffset += offset_dif;	//Update the time offset for the next call. 
+
+			//Prepare the trend field
+			if(pSensor->timeOffset!=0)
+			{
+				trend_cal=((int32)glucoseGen-(int32)pSensor->glucosePreviousGen)*600/offset_dif; //per minute, and elevate the power by 10 to gain 1 digit accuracy, the highest resolution is 0.1mg/dl/min
+				//convert the calculation result to SFLOAT, with the exponent -1 as long as the mantissa fits, a larger one otherwise
+				trend=SFLOAT_ENCODE(trend_cal, -1);
+				rate=(trend_cal>0x7FFF) ? 0x7FFF : ((trend_cal<-0x7FFF) ? -0x7FFF : (int16)trend_cal);
+			}
 #if (FEATURE_GLUCOSE_QUALITY==1)
-	//Prepare the quality field
-	quality=cgmGQuality(glucoseGen);
+			//Prepare the quality field
+			quality=cgmGQuality(glucoseGen);
 #endif
 #if (FEATURE_GLUCOSE_CALIBRATION==1)
-	//If the calibration feature is enabled. The newly generated glucose reading will be read to determine if the device needs calibration.
-	(*annunciation) |= cgmCaliTestCalibration(glucoseGen);
+			//If the calibration feature is enabled. The newly generated glucose reading will be read to determine if the device needs calibration.
+			(*annunciation) |= cgmCaliTestCalibration(glucoseGen);
 #endif /*FEATURE_GLUCOSE_CALIBRATION==1)*/
-#if (FEATURE_GLUCOSE_PATIENTHIGHLOW==1)
-	//If the patient high/low feature is enabled. The newly generated glucose reading will be read to determine if the reading exceeds normal range.
-	(*annunciation) |= cgmPHighTest(glucoseGen);
-	(*annunciation) |= cgmPLowTest(glucoseGen);
-#endif /*FEATURE_GLUCOSE_PATIENTHIGHLOW==1*/
-#if (FEATURE_GLUCOSE_HYPERALERT==1)
-	(*annunciation) |= cgmAHyperTest(glucoseGen);
-#endif /*FEATURE_GLUCOSE_HYPERALERT==1*/
-#if (FEATURE_GLUCOSE_HYPOALERT==1)
-	(*annunciation) |= cgmAHypoTest(glucoseGen);
-#endif /*FEATURE_GLUCOSE_HYOALERT==1*/
-#if (FEATURE_GLUCOSE_RATEALERT==1)
-	(*annunciation) |= cgmARateTest(trend);
-#endif /*FEATURE_GLUCOSE_RATEALERT==1*/
+			pMeas[i].annunciation=*annunciation;	//The alert bits are filled in below
+			pMeas[i].trend=trend;
+			pMeas[i].quality=quality;
+			levels[i]=(int16)glucoseGen;
+			rates[i]=rate;
+		}
 
-	//update the annuciation field
-	pMeas->annunciation=*annunciation;
+		//Evaluate the level and rate alerts of the whole chunk. They clear by themselves once the value is back past their hysteresis.
+		cgmAlertEvaluate(levels, rates, alerts, chunk);
 
-	//Prepare the flag
-#if (FEATURE_GLUCOSE_TREND==1)
-	flag |= CGM_TREND_INFO_PRES;
-#endif
-#if (FEATURE_GLUCOSE_QUALITY==1)
-	flag |= CGM_QUALITY_PRES;
-#endif
-	//Update the flag bits corresponding to each annunciation
-	if((*annunciation & 0x0000FF)!=0)
-		flag|=CGM_STATUS_ANNUNC_STATUS_OCT;
-	if((*annunciation & 0x00FF00)!=0)
-		flag|=CGM_STATUS_ANNUNC_CAL_TEMP_OCT;
-	if((*annunciation & 0xFF0000)!=0)
-		flag|=CGM_STATUS_ANNUNC_WARNING_OCT;
-
-	//Update the flag field
-	if (flag & CGM_TREND_INFO_PRES)
-	{
-		size+=2;
-		pMeas->trend=trend;
+		for (i=0;i<chunk;i++)
+		{
+			//update the annuciation field
+			pMeas[i].annunciation=(pMeas[i].annunciation & ~(uint32)CGM_ALERT_MASK) | alerts[i];
+
+			//Update the flag bits corresponding to each annunciation
+			flag=baseFlag;
+			pMeas[i].size=baseSize;
+			if((pMeas[i].annunciation & 0x0000FF)!=0)
+			{
+				flag|=CGM_STATUS_ANNUNC_STATUS_OCT;
+				pMeas[i].size++;
+			}
+			if((pMeas[i].annunciation & 0x00FF00)!=0)
+			{
+				flag|=CGM_STATUS_ANNUNC_CAL_TEMP_OCT;
+				pMeas[i].size++;
+			}
+			if((pMeas[i].annunciation & 0xFF0000)!=0)
+			{
+				flag|=CGM_STATUS_ANNUNC_WARNING_OCT;
+				pMeas[i].size++;
+			}
+
+			//Update the flag field
+			pMeas[i].flags= (flag);  
+		}
+		(*annunciation)=pMeas[chunk-1].annunciation;
 	}
-	if (flag & CGM_QUALITY_PRES)
-	{
+}
+
+/**
+  @ingroup glucosemeasgrp
+    @brief   Work out the size field of a CGM measurement from its flags.
+  @param   flags - the flags field of the measurement.
+  @return  the number of bytes of the measurement on the air, including the E2E-CRC when supported.*/
+static uint8 cgmMeasSize(uint8 flags)
+{
+	uint8 size=6;
+	if (flags & CGM_TREND_INFO_PRES)
 		size+=2;
-		pMeas->quality=quality;
-	}
-	if (flag & CGM_STATUS_ANNUNC_WARNING_OCT)
+	if (flags & CGM_QUALITY_PRES)
+		size+=2;
+	if (flags & CGM_STATUS_ANNUNC_WARNING_OCT)
 		size++;
-	if (flag & CGM_STATUS_ANNUNC_CAL_TEMP_OCT)
+	if (flags & CGM_STATUS_ANNUNC_CAL_TEMP_OCT)
 		size++;
-	if (flag & CGM_STATUS_ANNUNC_STATUS_OCT)
+	if (flags & CGM_STATUS_ANNUNC_STATUS_OCT)
 		size++;
 #if (FEATURE_GLUCOSE_CRC==1)
 	size+=2;
 #endif /* FEATURE_GLUCOSE_CRC==1*/
-	pMeas->size=size;  
-	pMeas->flags= (flag);  
+	return size;
 }
 
 /**
@@ -1580,28 +2134,20 @@ static void cgmNewGlucoseMeas(cgmMeasC_t * pMeas)
   @return  none*/
 static void cgmSimulationAppInit()				
 {
-	cgmMeasDB=(cgmMeasC_t *)osal_mem_alloc(CGM_MEAS_DB_SIZE*sizeof(cgmMeasC_t));
-	cgmMeasDBCount=0;
-	cgmMeasDBWriteIndx=0;
-	cgmMeasDBOldestIndx=0;
+#if (FEATURE_GLUCOSE_MODEL==1)
+	cgmModelInit(&cgmModel, &cgmModelDefault);
+	cgmModelSourceInit(&cgmModelSource, &cgmModel);
+	cgmSimDataSetSource(&cgmModelSource);
+#endif /*FEATURE_GLUCOSE_MODEL==1*/
+	cgmSensorInit(&cgmSensor, CGM_MEAS_DB_SIZE);
+#if (FEATURE_GLUCOSE_PERSISTENT_LOG==1)
+	cgmLogRestore(&cgmSensor);
+#endif /*FEATURE_GLUCOSE_PERSISTENT_LOG==1*/
 	cgmStartTimeConfigIndicator=false;
-	cgmSimDataReset();
 #if (FEATURE_GLUCOSE_CALIBRATION==1)
 	cgmResetCaliDB();
 #endif
-#if (FEATURE_GLUCOSE_PATIENTHIGHLOW==1)
-        cgmPHighReset();
-        cgmPLowReset();
-#endif
-#if (FEATURE_GLUCOSE_HYPERALERT==1)
-	cgmAHyperReset();
-#endif
-#if (FEATURE_GLUCOSE_HYPOALERT==1)
-	cgmAHypoReset();
-#endif
-#if (FEATURE_GLUCOSE_RATEALERT==1)
-	cgmARateReset();
-#endif
+	cgmAlertReset();
         
         //-----------PTS Specific Code------------------
         //For the PTS Test, introduce an initial record.
@@ -1626,166 +2172,440 @@ static void cgmSimulationAppInit()
 
 /**
   @ingroup racpgrp
-  @brief   This function implements the search function for the gluocose measurement. 
-  @details It assumes the measurement database consists of continous records arranged in ascending order.
-  	    The current version is based on the sequential search for demo purpose. Therefore, we assume
-  	    records are arranged in ascending order based on offset time.
-  @param   filter - the filter type in searching
-  @param   operand1 - the primary operand to the search operation.
-  @param   operand2 - the scrondary operand to the search operation, it is currently used only in searching for a range of record.
-  @return  the result code*/
-static uint8 cgmSearchMeasDB(uint8 filter,uint16 operand1, uint16 operand2)
+  @brief   Find the first record whose time offset is not less than offset.
+  @details Records are appended in ascending time offset order, so the database is sorted in its logical
+  	    order, oldest first. The 16-bit time offsets wrap around, so they are compared by their distance
+  	    from the oldest record, which holds as long as the records span less than one wrap. An offset
+  	    outside of the records belongs to the nearer end: the half of the gap after the newest record is
+  	    taken as later than all records, the half before the oldest as earlier. When all records are
+  	    evenly spaced the position is computed directly from the distance and the step, otherwise it is
+  	    found by a binary search. A position within a span of deleted records is compared by the record
+  	    following the span, since a compaction in progress leaves stale records there.
+  @param   pSensor - the sensor owning the database.
+  @param   offset - the time offset searched for.
+  @return  the logical position of the record, counted from the oldest one, which may be deleted. measDBCount if there is none.*/
+static cgmMeasDBIndx_t cgmMeasDBLowerBound(cgmSensor_t *pSensor, uint16 offset)
 {
-	uint8 i=0;
-	uint8 j=0;
-	
-	if(cgmMeasDBCount==0)
-		return  RACP_SEARCH_RSP_NO_RECORD;
+	uint16 first;
+	uint16 dist;
+	uint16 span;
+	cgmMeasDBIndx_t lo=0;
+	cgmMeasDBIndx_t hi=pSensor->measDBCount;
+	cgmMeasDBIndx_t mid;
+
+	if (pSensor->measDBCount==0)
+		return 0;
+	first=CGM_MEAS_DB_OFFSET(CGM_MEAS_DB_AT(pSensor,0));
+	dist=(uint16)(offset-first);
+	span=(uint16)(CGM_MEAS_DB_OFFSET(CGM_MEAS_DB_AT(pSensor,pSensor->measDBCount-1))-first);
+	if (dist==0)
+		return 0;
+	if (dist>span)
+		return ((uint16)(dist-span)>(uint16)(0xFFFF-span)/2) ? 0 : pSensor->measDBCount;
+	//Evenly spaced records: direct mapping
+	if (pSensor->measDBStep!=0 && pSensor->measDBStepRun>=pSensor->measDBCount)
+	{
+		uint16 pos=(uint16)(((uint32)dist+pSensor->measDBStep-1)/pSensor->measDBStep);
+		return (pos<pSensor->measDBCount) ? pos : pSensor->measDBCount;
+	}
+	//Binary search over the logical order
+	while (lo<hi)
+	{
+		mid=lo+(hi-lo)/2;
+		if ((uint16)(CGM_MEAS_DB_OFFSET(CGM_MEAS_DB_AT(pSensor,cgmMeasDBNextLive(pSensor,mid)))-first)<dist)
+			lo=mid+1;
+		else
+			hi=mid;
+	}
+	return lo;
+}
 
-	switch (filter)
+/**
+  @ingroup racpgrp
+  @brief   Find the first record whose time offset is greater than offset.
+  @param   pSensor - the sensor owning the database.
+  @param   offset - the time offset searched for.
+  @return  the logical position of the record, counted from the oldest one. measDBCount if there is none.*/
+static cgmMeasDBIndx_t cgmMeasDBUpperBound(cgmSensor_t *pSensor, uint16 offset)
+{
+	if (offset==0xFFFF)
+		return pSensor->measDBCount;
+	return cgmMeasDBLowerBound(pSensor,offset+1);
+}
+
+/**
+  @ingroup racpgrp
+  @brief   Store a search result, given as a run of logical positions. The deleted records within are left out.
+  @param   pSensor - the sensor owning the database.
+  @param   pSession - the session receiving the result.
+  @param   first - the logical position of the first matching record.
+  @param   last - the logical position following the last matching record, greater than first.
+  @return  none*/
+static void cgmMeasDBSetSearch(cgmSensor_t *pSensor, cgmSession_t *pSession, cgmMeasDBIndx_t first, cgmMeasDBIndx_t last)
+{
+	first=cgmMeasDBNextLive(pSensor,first);
+	pSession->measDBSearchStart=CGM_MEAS_DB_SEQ(pSensor,first);
+	pSession->measDBSearchEnd=CGM_MEAS_DB_SEQ(pSensor,last-1);
+	pSession->measDBSearchNum=(first<last) ? cgmMeasDBLiveBetween(pSensor,first,last) : 0;
+}
+
+/**
+  @ingroup racpgrp
+  @brief   Find the first record not deleted at or after a logical position.
+  @details The spans of deleted records are never next to one another, and the newest record is never deleted, so
+  	    the record following a span is always there.
+  @param   pSensor - the sensor owning the database.
+  @param   pos - the logical position.
+  @return  the logical position of the record.*/
+static cgmMeasDBIndx_t cgmMeasDBNextLive(cgmSensor_t *pSensor, cgmMeasDBIndx_t pos)
+{
+	cgmMeasDBIndx_t start;
+	uint8 i;
+
+	for (i=0;i<pSensor->measDBGapNum;i++)
 	{
-		// All records
-		case CTL_PNT_OPER_ALL:
-			{
-				cgmMeasDBSearchStart=cgmMeasDBOldestIndx;
-				cgmMeasDBSearchEnd=(cgmMeasDBOldestIndx+cgmMeasDBCount-1)%CGM_MEAS_DB_SIZE;
-				cgmMeasDBSearchNum=cgmMeasDBCount;
-				return RACP_SEARCH_RSP_SUCCESS;
-			}
+		start=CGM_MEAS_DB_POS(pSensor,pSensor->measDBGap[i].start);
+		if (pos<start)
+			break;
+		if (pos<start+pSensor->measDBGap[i].num)
+			return start+pSensor->measDBGap[i].num;
+	}
+	return pos;
+}
+
+/**
+  @ingroup racpgrp
+  @brief   Count the records not deleted within a run of logical positions.
+  @param   pSensor - the sensor owning the database.
+  @param   first - the first logical position of the run.
+  @param   last - the logical position following the run, not less than first.
+  @return  the number of records.*/
+static cgmMeasDBIndx_t cgmMeasDBLiveBetween(cgmSensor_t *pSensor, cgmMeasDBIndx_t first, cgmMeasDBIndx_t last)
+{
+	cgmMeasDBIndx_t num=last-first;
+	cgmMeasDBIndx_t start, end;
+	uint8 i;
+
+	for (i=0;i<pSensor->measDBGapNum;i++)
+	{
+		start=CGM_MEAS_DB_POS(pSensor,pSensor->measDBGap[i].start);
+		end=start+pSensor->measDBGap[i].num;
+		if (start<first)
+			start=first;
+		if (end>last)
+			end=last;
+		if (start<end)
+			num-=end-start;
+	}
+	return num;
+}
+
+/**
+  @ingroup racpgrp
+  @brief   Remove the oldest records from the database, together with a span of deleted records left at its front.
+  @param   pSensor - the sensor owning the database.
+  @param   num - the number of records to remove, at most measDBCount.
+  @return  none*/
+static void cgmMeasDBDropOldest(cgmSensor_t *pSensor, cgmMeasDBIndx_t num)
+{
+	uint8 i;
+
+	pSensor->measDBOldestIndx=CGM_MEAS_DB_SLOT(pSensor,pSensor->measDBOldestIndx,num);
+	pSensor->measDBSeqBase=CGM_MEAS_DB_SEQ(pSensor,num);
+	pSensor->measDBCount-=num;
+	if (pSensor->measDBGapNum>0 && CGM_MEAS_DB_POS(pSensor,pSensor->measDBGap[0].start)==0)
+	{
+		num=pSensor->measDBGap[0].num;
+		pSensor->measDBOldestIndx=CGM_MEAS_DB_SLOT(pSensor,pSensor->measDBOldestIndx,num);
+		pSensor->measDBSeqBase=CGM_MEAS_DB_SEQ(pSensor,num);
+		pSensor->measDBCount-=num;
+		pSensor->measDBGapNum--;
+		for (i=0;i<pSensor->measDBGapNum;i++)
+			pSensor->measDBGap[i]=pSensor->measDBGap[i+1];
+	}
+	if (pSensor->measDBStepRun>pSensor->measDBCount)
+		pSensor->measDBStepRun=pSensor->measDBCount;
+}
+
+/**
+  @ingroup racpgrp
+  @brief   Compact the deleted records away, a few at a time.
+  @details Each call moves the span of deleted records nearest to either end of the database towards that end, by
+  	    copying the records in between across it, and removes the span once it gets there. It is left alone
+  	    while a RACP transfer is in progress, since the records moved get new sequence numbers.
+  @param   pSensor - the sensor owning the database.
+  @param   budget - the largest number of records to copy.
+  @return  none*/
+static void cgmMeasDBCompact(cgmSensor_t *pSensor, cgmMeasDBIndx_t budget)
+{
+	cgmMeasDBGap_t *pGap;
+	cgmMeasDBGap_t *pLast;
+	cgmMeasDBIndx_t start;
+
+	if (pSensor->measDBGapNum==0 || cgmSessionSending(pSensor))
+		return;
+	//The positions no longer follow the time offsets evenly
+	pSensor->measDBStepRun=0;
+	pGap=pSensor->measDBGap;
+	pLast=pSensor->measDBGap+pSensor->measDBGapNum-1;
+	start=CGM_MEAS_DB_POS(pSensor,pGap->start);
+	//Work on the end with the fewer records to move
+	if (start<=pSensor->measDBCount-CGM_MEAS_DB_POS(pSensor,pLast->start)-pLast->num)
+	{
+		//Move the oldest records forward across the first span
+		for (;budget>0 && start>0;budget--)
+		{
+			start--;
+			osal_memcpy(CGM_MEAS_DB_AT(pSensor,start+pGap->num),CGM_MEAS_DB_AT(pSensor,start),sizeof(cgmMeasPacked_t));
+		}
+		pGap->start=CGM_MEAS_DB_SEQ(pSensor,start);
+		if (start==0)
+			cgmMeasDBDropOldest(pSensor,0);
+	}
+	else
+	{
+		//Move the newest records backward across the last span
+		pGap=pLast;
+		start=CGM_MEAS_DB_POS(pSensor,pGap->start);
+		for (;budget>0 && start+pGap->num<pSensor->measDBCount;budget--,start++)
+			osal_memcpy(CGM_MEAS_DB_AT(pSensor,start),CGM_MEAS_DB_AT(pSensor,start+pGap->num),sizeof(cgmMeasPacked_t));
+		pGap->start=CGM_MEAS_DB_SEQ(pSensor,start);
+		if (start+pGap->num==pSensor->measDBCount)
+		{
+			pSensor->measDBCount=start;
+			pSensor->measDBGapNum--;
+		}
+	}
+}
+
+/**
+  @ingroup racpgrp
+  @brief   Compact all the deleted records away at once, moving every record following a span.
+  @param   pSensor - the sensor owning the database.
+  @return  none*/
+static void cgmMeasDBCompactAll(cgmSensor_t *pSensor)
+{
+	cgmMeasDBIndx_t from, to;
+
+	for (from=0,to=0;from<pSensor->measDBCount;from=cgmMeasDBNextLive(pSensor,from+1),to++)
+		if (to!=from)
+			osal_memcpy(CGM_MEAS_DB_AT(pSensor,to),CGM_MEAS_DB_AT(pSensor,from),sizeof(cgmMeasPacked_t));
+	pSensor->measDBCount=to;
+	pSensor->measDBGapNum=0;
+	pSensor->measDBStepRun=0;
+}
+
+/**
+  @ingroup racpgrp
+  @brief   This function implements the search function for the gluocose measurement. 
+  @details It assumes the measurement database consists of continous records arranged in ascending order
+  	    based on offset time, and looks the boundaries up with cgmMeasDBLowerBound and cgmMeasDBUpperBound.
+  	    The oldest and the newest records are never deleted, so the first and last ones are found directly.
+  @param   pSensor - the sensor owning the database.
+  @param   filter - the filter type in searching
+  @param   operand1 - the primary operand to the search operation.
+  @param   operand2 - the scrondary operand to the search operation, it is currently used only in searching for a range of record.
+  @return  the result code*/
+static uint8 cgmSearchMeasDB(cgmSensor_t *pSensor, cgmSession_t *pSession, uint8 filter,uint16 operand1, uint16 operand2)
+{
+	cgmMeasDBIndx_t first;
+	cgmMeasDBIndx_t last;
+	
+	if(pSensor->measDBCount==0)
+		return  RACP_SEARCH_RSP_NO_RECORD;
+
+	switch (filter)
+	{
+		// All records
+		case CTL_PNT_OPER_ALL:
+			cgmMeasDBSetSearch(pSensor,pSession,0,pSensor->measDBCount);
+			return RACP_SEARCH_RSP_SUCCESS;
 		// Records greater or equal to operand1
 		case CTL_PNT_OPER_GREATER_EQUAL:
-			{
-				do
-				{
-					j=(cgmMeasDBOldestIndx+i)%CGM_MEAS_DB_SIZE;
-					if( (cgmMeasDB+j)->timeoffset >= operand1)
-					{
-						cgmMeasDBSearchStart=j;
-						break;
-					}
-					i++;
-					if (i>=cgmMeasDBCount)
-					{
-						cgmMeasDBSearchNum=0;
-						return RACP_SEARCH_RSP_NO_RECORD;
-					}
-				}while(1);
-				cgmMeasDBSearchEnd=(cgmMeasDBOldestIndx+cgmMeasDBCount-1)%CGM_MEAS_DB_SIZE;
-				if(cgmMeasDBSearchEnd>=cgmMeasDBSearchStart)
-				{
-					cgmMeasDBSearchNum= (cgmMeasDBSearchEnd-cgmMeasDBSearchStart+1);
-				}
-				else
-				{
-					cgmMeasDBSearchNum= -(cgmMeasDBSearchStart-cgmMeasDBSearchEnd-1)+CGM_MEAS_DB_SIZE;
-				}
-				return RACP_SEARCH_RSP_SUCCESS;
-			}
+			first=cgmMeasDBLowerBound(pSensor,operand1);
+			last=pSensor->measDBCount;
+			break;
 		// The first record
 		case CTL_PNT_OPER_FIRST:
-			{
-				cgmMeasDBSearchStart=cgmMeasDBOldestIndx;
-				cgmMeasDBSearchEnd=cgmMeasDBOldestIndx;
-				cgmMeasDBSearchNum=1;
-				return RACP_SEARCH_RSP_SUCCESS;
-			}
+			cgmMeasDBSetSearch(pSensor,pSession,0,1);
+			return RACP_SEARCH_RSP_SUCCESS;
 		// The last record
 		case CTL_PNT_OPER_LAST:
-			{
-				cgmMeasDBSearchStart=(cgmMeasDBOldestIndx+cgmMeasDBCount-1)%CGM_MEAS_DB_SIZE;
-				cgmMeasDBSearchEnd=cgmMeasDBSearchStart;
-				cgmMeasDBSearchNum=1;
-				return RACP_SEARCH_RSP_SUCCESS;
-			}
+			cgmMeasDBSetSearch(pSensor,pSession,pSensor->measDBCount-1,pSensor->measDBCount);
+			return RACP_SEARCH_RSP_SUCCESS;
 		// The records which are less than or equal to operand1
 		case CTL_PNT_OPER_LESS_EQUAL:
-			{
-				do
-				{
-					j=(cgmMeasDBOldestIndx+i)%CGM_MEAS_DB_SIZE;
-					if ( (cgmMeasDB+j)->timeoffset > operand1)
-					{
-						if(i==0)//no record has a smaller offset value
-						{
-							cgmMeasDBSearchNum=0;
-							return RACP_SEARCH_RSP_NO_RECORD;
-						}
-						cgmMeasDBSearchEnd=(j+CGM_MEAS_DB_SIZE-1)%CGM_MEAS_DB_SIZE;
-						break;
-					}
-					i++;
-					if ( i >= cgmMeasDBCount)
-					{
-						cgmMeasDBSearchEnd=(cgmMeasDBOldestIndx+cgmMeasDBCount-1)%CGM_MEAS_DB_SIZE;
-						break;
-					}
-				}while(1);
-				cgmMeasDBSearchStart=cgmMeasDBOldestIndx;
-				if(cgmMeasDBSearchEnd>=cgmMeasDBSearchStart)
-				{
-					cgmMeasDBSearchNum= (cgmMeasDBSearchEnd-cgmMeasDBSearchStart+1);
-				}
-				else
-				{
-					cgmMeasDBSearchNum= -(cgmMeasDBSearchStart-cgmMeasDBSearchEnd-1)+CGM_MEAS_DB_SIZE;
-				}
-				return RACP_SEARCH_RSP_SUCCESS;
-			}
+			first=0;
+			last=cgmMeasDBUpperBound(pSensor,operand1);
+			break;
 		// Records that are with in the range of [operand1, operand2]
 		case CTL_PNT_OPER_RANGE:
-			{
-				if (operand1>operand2)
-					return RACP_SEARCH_RSP_INVALID_OPERAND;
-				uint8 startindx,endindx;
-				if (cgmSearchMeasDB(CTL_PNT_OPER_GREATER_EQUAL,operand1,0)!=RACP_SEARCH_RSP_NO_RECORD)
-				{
-					startindx=cgmMeasDBSearchStart;
-				}
-				else
-				{
-					return RACP_SEARCH_RSP_NO_RECORD;
-				}
-				if(cgmSearchMeasDB(CTL_PNT_OPER_LESS_EQUAL,operand2,0)!= RACP_SEARCH_RSP_NO_RECORD)
-				{
-					endindx=cgmMeasDBSearchEnd;
-				}
-				else
-				{
-					return RACP_SEARCH_RSP_NO_RECORD;
-				}
-				cgmMeasDBSearchStart=startindx;
-				cgmMeasDBSearchEnd=endindx;
-				if(cgmMeasDBSearchEnd>=cgmMeasDBSearchStart)
-				{
-					cgmMeasDBSearchNum= (cgmMeasDBSearchEnd-cgmMeasDBSearchStart+1);
-				}
-				else
-				{
-					cgmMeasDBSearchNum= -(cgmMeasDBSearchStart-cgmMeasDBSearchEnd-1)+CGM_MEAS_DB_SIZE;
-				}
-				return RACP_SEARCH_RSP_SUCCESS;
-			}
-		default:
+			if (operand1>operand2)
+				return RACP_SEARCH_RSP_INVALID_OPERAND;
+			first=cgmMeasDBLowerBound(pSensor,operand1);
+			last=cgmMeasDBUpperBound(pSensor,operand2);
 			break;
+		default:
+			return RACP_SEARCH_RSP_NOT_COMPLETE;	
 	}
-	return RACP_SEARCH_RSP_NOT_COMPLETE;	
+	//The matching records are the logical positions [first, last), less the deleted ones
+	if (first>=last)
+	{
+		pSession->measDBSearchNum=0;
+		return RACP_SEARCH_RSP_NO_RECORD;
+	}
+	cgmMeasDBSetSearch(pSensor,pSession,first,last);
+	return (pSession->measDBSearchNum>0) ? RACP_SEARCH_RSP_SUCCESS : RACP_SEARCH_RSP_NO_RECORD;
 }
 
 /**
   @ingroup racpgrp
     @brief  Add record to the database 
-  @param   cgmCurrentMeas - the add of the current measurement to be added to the database.*/
-static void cgmAddRecord(cgmMeasC_t *cgmCurrentMeas)
-{
-	cgmMeasDBWriteIndx=(cgmMeasDBOldestIndx+cgmMeasDBCount)%CGM_MEAS_DB_SIZE;
-	if ((cgmMeasDBWriteIndx==cgmMeasDBOldestIndx) && cgmMeasDBCount>0)
-		cgmMeasDBOldestIndx=(cgmMeasDBOldestIndx+1)%CGM_MEAS_DB_SIZE;
-	osal_memcpy(cgmMeasDB+cgmMeasDBWriteIndx,cgmCurrentMeas,sizeof(cgmMeasC_t));
-	cgmMeasDBCount++;
-	if (cgmMeasDBCount>CGM_MEAS_DB_SIZE)
-		cgmMeasDBCount=CGM_MEAS_DB_SIZE;
+  @param   pSensor - the sensor owning the database.
+  @param   pMeas - the add of the current measurement to be added to the database.*/
+static void cgmAddRecord(cgmSensor_t *pSensor, cgmMeasC_t *pMeas)
+{
+	cgmAddRecords(pSensor,pMeas,1);
+}	
+
+/**
+  @ingroup racpgrp
+    @brief  Add a run of records to the database, oldest first.
+  @details Each record is packed straight into its slot of the database. When the run is longer than the database,
+	   the records that would be overwritten within the run are skipped.
+  @param   pSensor - the sensor owning the database.
+  @param   pMeas - the records to be added, in time order.
+  @param   num - the number of records.*/
+static void cgmAddRecords(cgmSensor_t *pSensor, cgmMeasC_t *pMeas, uint16 num)
+{
+	if (num>pSensor->measDBSize)
+	{
+		pMeas+=num-pSensor->measDBSize;
+		num=pSensor->measDBSize;
+	}
+	for (;num>0;num--,pMeas++)
+		cgmMeasPack(cgmMeasDBReserve(pSensor,pMeas->timeoffset),pMeas);
 }	
 
+/**
+  @ingroup racpgrp
+    @brief  Add a record which is already in the packed form to the database 
+  @param   pSensor - the sensor owning the database.
+  @param   pPacked - the record to be added.*/
+static void cgmAddPackedRecord(cgmSensor_t *pSensor, cgmMeasPacked_t *pPacked)
+{
+	if (pSensor->measDBSize==0)
+		return;
+	osal_memcpy(cgmMeasDBReserve(pSensor,CGM_MEAS_DB_OFFSET(pPacked)),pPacked,sizeof(cgmMeasPacked_t));
+}	
+
+/**
+  @ingroup racpgrp
+    @brief  Make room for a new record at the end of the database, overwriting the oldest one when it is full.
+  @param   pSensor - the sensor owning the database. Its database must not be empty sized.
+  @param   offset - the time offset of the new record.
+  @return  the slot the new record is to be written to.*/
+static cgmMeasPacked_t *cgmMeasDBReserve(cgmSensor_t *pSensor, uint16 offset)
+{
+	uint8 i;
+
+	//Keep track of how many of the newest records are evenly spaced
+	if (pSensor->measDBCount>0)
+	{
+		uint16 step=offset-CGM_MEAS_DB_OFFSET(CGM_MEAS_DB_AT(pSensor,pSensor->measDBCount-1));
+		if (pSensor->measDBStepRun>1 && step==pSensor->measDBStep)
+		{
+			if (pSensor->measDBStepRun<pSensor->measDBSize)
+				pSensor->measDBStepRun++;
+		}
+		else
+		{
+			pSensor->measDBStep=step;
+			pSensor->measDBStepRun=2;
+		}
+	}
+	else
+		pSensor->measDBStepRun=1;
+	if (pSensor->measDBCount<pSensor->measDBSize)
+	{
+		pSensor->measDBWriteIndx=CGM_MEAS_DB_SLOT(pSensor,pSensor->measDBOldestIndx,pSensor->measDBCount);
+		pSensor->measDBCount++;
+	}
+	else
+	{	//The database is full, the oldest record is overwritten, along with a span of deleted records behind it
+		cgmMeasDBDropOldest(pSensor,1);
+		//A transfer waiting for the overwritten record goes on with the next one
+		for (i=0;i<CGM_SESSIONS;i++)
+		{
+			if (pSensor->session[i].racp.remaining>0 && CGM_MEAS_DB_POS(pSensor,pSensor->session[i].racp.cursor)>=pSensor->measDBCount)
+			{
+				pSensor->session[i].racp.cursor=pSensor->measDBSeqBase;
+				pSensor->session[i].racp.remaining--;
+			}
+		}
+		pSensor->measDBWriteIndx=CGM_MEAS_DB_SLOT(pSensor,pSensor->measDBOldestIndx,pSensor->measDBCount);
+		pSensor->measDBCount++;
+	}
+	return pSensor->measDB+pSensor->measDBWriteIndx;
+}	
+
+/**
+  @ingroup racpgrp
+    @brief  Convert a measurement to the packed form kept in the database.
+  @param   pPacked - the packed record to be written.
+  @param   pMeas - the measurement to be packed.
+  @return  none*/
+static void cgmMeasPack(cgmMeasPacked_t *pPacked, cgmMeasC_t *pMeas)
+{
+#if (FEATURE_GLUCOSE_WIRE_IMAGE_DB==1)
+	cgmMeasSerialize(pMeas, pPacked->pdu);
+#else
+	pPacked->flags=pMeas->flags;
+	pPacked->concentration[0]=LO_UINT16(pMeas->concentration);
+	pPacked->concentration[1]=HI_UINT16(pMeas->concentration);
+	pPacked->timeoffset[0]=LO_UINT16(pMeas->timeoffset);
+	pPacked->timeoffset[1]=HI_UINT16(pMeas->timeoffset);
+	pPacked->annunciation[0]=BREAK_UINT32(pMeas->annunciation,0);
+	pPacked->annunciation[1]=BREAK_UINT32(pMeas->annunciation,1);
+	pPacked->annunciation[2]=BREAK_UINT32(pMeas->annunciation,2);
+#if (FEATURE_GLUCOSE_TREND==1)
+	pPacked->trend[0]=LO_UINT16(pMeas->trend);
+	pPacked->trend[1]=HI_UINT16(pMeas->trend);
+#endif
+#if (FEATURE_GLUCOSE_QUALITY==1)
+	pPacked->quality[0]=LO_UINT16(pMeas->quality);
+	pPacked->quality[1]=HI_UINT16(pMeas->quality);
+#endif
+#endif /*FEATURE_GLUCOSE_WIRE_IMAGE_DB==1*/
+}
+
+#if (FEATURE_GLUCOSE_WIRE_IMAGE_DB==0)
+/**
+  @ingroup racpgrp
+    @brief  Restore a measurement from its packed form in the database.
+  @param   pMeas - the measurement to be written.
+  @param   pPacked - the packed record.
+  @return  none*/
+static void cgmMeasUnpack(cgmMeasC_t *pMeas, cgmMeasPacked_t *pPacked)
+{
+	pMeas->flags=pPacked->flags;
+	pMeas->size=cgmMeasSize(pPacked->flags);
+	pMeas->concentration=BUILD_UINT16(pPacked->concentration[0],pPacked->concentration[1]);
+	pMeas->timeoffset=BUILD_UINT16(pPacked->timeoffset[0],pPacked->timeoffset[1]);
+	pMeas->annunciation=BUILD_UINT32(pPacked->annunciation[0],pPacked->annunciation[1],pPacked->annunciation[2],0);
+#if (FEATURE_GLUCOSE_TREND==1)
+	pMeas->trend=BUILD_UINT16(pPacked->trend[0],pPacked->trend[1]);
+#else
+	pMeas->trend=0;
+#endif
+#if (FEATURE_GLUCOSE_QUALITY==1)
+	pMeas->quality=BUILD_UINT16(pPacked->quality[0],pPacked->quality[1]);
+#else
+	pMeas->quality=0;
+#endif
+}
+#endif /*FEATURE_GLUCOSE_WIRE_IMAGE_DB==0*/
+
 /**
   @ingroup racpgrp
     @brief   Record Access Control Point messages processing
@@ -1793,12 +2613,17 @@ static void cgmAddRecord(cgmMeasC_t *cgmCurrentMeas)
   @return  none*/
 static void cgmProcessRACPMsg (cgmRACPMsg_t * pMsg)
 {
+	cgmSensor_t *pSensor=&cgmSensor;
+	cgmSession_t *pSession=cgmSessionFind(pSensor,pMsg->connHandle,true);
 	uint8 opcode=pMsg->data[0];
 	uint8 operator=pMsg->data[1];
 	uint16 operand1=0,operand2=0;
+	uint16 num;
 	uint8 reopcode=0;
         uint8 filter=0;
 
+	if (pSession==NULL)
+		return;
 	switch (opcode)
 	{
 		//Get the history records or their number count.
@@ -1813,7 +2638,7 @@ static void cgmProcessRACPMsg (cgmRACPMsg_t * pMsg)
 					cgmRACPRsp.value[2]=opcode;
 					cgmRACPRsp.value[3]=CTL_PNT_RSP_OPER_INVALID;
 					cgmRACPRsp.len=4;
-					CGM_RACPIndicate(gapConnHandle, &cgmRACPRsp, cgmTaskId);
+					CGM_RACPIndicate(pSession->connHandle, &cgmRACPRsp, cgmTaskId);
 					break;
 			}
 			
@@ -1824,7 +2649,7 @@ static void cgmProcessRACPMsg (cgmRACPMsg_t * pMsg)
 					cgmRACPRsp.value[2]=opcode;
 					cgmRACPRsp.value[3]=CTL_PNT_RSP_OPER_NOT_SUPPORTED;
 					cgmRACPRsp.len=4;
-					CGM_RACPIndicate(gapConnHandle, &cgmRACPRsp, cgmTaskId);
+					CGM_RACPIndicate(pSession->connHandle, &cgmRACPRsp, cgmTaskId);
 					break;
 			}
 
@@ -1841,7 +2666,7 @@ static void cgmProcessRACPMsg (cgmRACPMsg_t * pMsg)
 				cgmRACPRsp.value[1]=CTL_PNT_OPER_NULL;
 				cgmRACPRsp.value[2]=opcode;
 				cgmRACPRsp.len=4;
-  				CGM_RACPIndicate(gapConnHandle, &cgmRACPRsp, cgmTaskId);
+  				CGM_RACPIndicate(pSession->connHandle, &cgmRACPRsp, cgmTaskId);
 				return;
 				}
 				operand1=BUILD_UINT16(pMsg->data[3],pMsg->data[4]);
@@ -1857,27 +2682,31 @@ static void cgmProcessRACPMsg (cgmRACPMsg_t * pMsg)
 				cgmRACPRsp.value[1]=CTL_PNT_OPER_NULL;
 				cgmRACPRsp.value[2]=opcode;
 				cgmRACPRsp.len=4;
-  				CGM_RACPIndicate(gapConnHandle, &cgmRACPRsp, cgmTaskId);
+  				CGM_RACPIndicate(pSession->connHandle, &cgmRACPRsp, cgmTaskId);
 				return;
 			}
 				
 			//Get the starting and ending index of the record meeting requriement  
-			if ((reopcode=cgmSearchMeasDB(operator,operand1,operand2))==RACP_SEARCH_RSP_SUCCESS)
+			if ((reopcode=cgmSearchMeasDB(pSensor,pSession,operator,operand1,operand2))==RACP_SEARCH_RSP_SUCCESS)
 			{
 				if (opcode==CTL_PNT_OP_REQ){
-					cgmMeasDBSendIndx=0;
-					osal_start_timerEx(cgmTaskId,RACP_IND_SEND_EVT,500); //start the data transfer event  				   
-					CGM_SetSendState(true);
+					cgmRACPStartSend(pSensor,pSession); //start the data transfer event
 					return;}
 				//If we only need to report the number count, we can prepare the send the packet right away.
 				else if (opcode==CTL_PNT_OP_GET_NUM)
 				{
 					cgmRACPRsp.value[0]=CTL_PNT_OP_NUM_RSP;
 					cgmRACPRsp.value[1]=CTL_PNT_OPER_NULL;
-					cgmRACPRsp.value[2]=LO_UINT16(cgmMeasDBSearchNum);
-					cgmRACPRsp.value[3]=HI_UINT16(cgmMeasDBSearchNum);
+					//The number of records field is 16 bits wide
+#if (CGM_MEAS_DB_SIZE>0xFFFF)
+					num=(pSession->measDBSearchNum>0xFFFF) ? 0xFFFF : pSession->measDBSearchNum;
+#else
+					num=pSession->measDBSearchNum;
+#endif /*CGM_MEAS_DB_SIZE>0xFFFF*/
+					cgmRACPRsp.value[2]=LO_UINT16(num);
+					cgmRACPRsp.value[3]=HI_UINT16(num);
 					cgmRACPRsp.len=4;
-					CGM_RACPIndicate(gapConnHandle, &cgmRACPRsp, cgmTaskId);
+					CGM_RACPIndicate(pSession->connHandle, &cgmRACPRsp, cgmTaskId);
 				}
 				//If we need to delete the record, the record delete function is called.
 				else if (opcode==CTL_PNT_OP_CLR)
@@ -1885,9 +2714,18 @@ static void cgmProcessRACPMsg (cgmRACPMsg_t * pMsg)
 					cgmRACPRsp.value[0]=CTL_PNT_OP_REQ_RSP;
 					cgmRACPRsp.value[1]=0;
 					cgmRACPRsp.value[2]=opcode;
-					cgmRACPRsp.value[3]=cgmRACPClearRecord(cgmMeasDBSearchStart,cgmMeasDBSearchEnd,cgmMeasDBSearchNum);
+					//The records may not move under the transfer of another collector
+					if (cgmSessionSending(pSensor))
+						cgmRACPRsp.value[3]=CTL_PNT_RSP_PROC_NOT_CMPL;
+					else
+					{
+#if (FEATURE_GLUCOSE_PERSISTENT_LOG==1)
+						cgmLogDeleteRecords(pSensor,pSession->measDBSearchStart,pSession->measDBSearchEnd,pSession->measDBSearchNum);
+#endif /*FEATURE_GLUCOSE_PERSISTENT_LOG==1*/
+						cgmRACPRsp.value[3]=cgmRACPClearRecord(pSensor,pSession->measDBSearchStart,pSession->measDBSearchEnd,pSession->measDBSearchNum);
+					}
 					cgmRACPRsp.len=4;
-  					CGM_RACPIndicate(gapConnHandle, &cgmRACPRsp, cgmTaskId);
+  					CGM_RACPIndicate(pSession->connHandle, &cgmRACPRsp, cgmTaskId);
 				}
 
 			}
@@ -1909,19 +2747,18 @@ static void cgmProcessRACPMsg (cgmRACPMsg_t * pMsg)
 					cgmRACPRsp.value[2]=opcode;
 					cgmRACPRsp.len=4;
 				}
-				CGM_RACPIndicate(gapConnHandle, &cgmRACPRsp,  cgmTaskId);
+				CGM_RACPIndicate(pSession->connHandle, &cgmRACPRsp,  cgmTaskId);
 			}
 			break;
 		case CTL_PNT_OP_ABORT:
 			{
-				osal_stop_timerEx(cgmTaskId,RACP_IND_SEND_EVT);	
-				CGM_SetSendState(false);
+				cgmRACPStopSend(pSensor,pSession);
 				cgmRACPRsp.value[0]=CTL_PNT_OP_REQ_RSP;
 				cgmRACPRsp.value[1]=CTL_PNT_OPER_NULL;
 				cgmRACPRsp.value[2]=opcode;
 				cgmRACPRsp.value[3]=CTL_PNT_RSP_SUCCESS;	
 				cgmRACPRsp.len=4;
-				CGM_RACPIndicate(gapConnHandle, &cgmRACPRsp,  cgmTaskId);
+				CGM_RACPIndicate(pSession->connHandle, &cgmRACPRsp,  cgmTaskId);
 				break;
 			}
 		default:
@@ -1930,78 +2767,136 @@ static void cgmProcessRACPMsg (cgmRACPMsg_t * pMsg)
 				cgmRACPRsp.value[2]=opcode;
 				cgmRACPRsp.value[3]=CTL_PNT_RSP_OPCODE_NOT_SUPPORTED;	
 				cgmRACPRsp.len=4;
-				CGM_RACPIndicate(gapConnHandle, &cgmRACPRsp,  cgmTaskId);
+				CGM_RACPIndicate(pSession->connHandle, &cgmRACPRsp,  cgmTaskId);
 			break;
 	}
 }	
 
 
+/**
+  @ingroup racpgrp
+    @brief   Send the record at the current RACP send position as a notification of the glucose measurement characteristic.
+  @param   pSensor - the sensor owning the database.
+  @param   pSession - the session of the transfer.
+  @return  the status returned by the CGM service.*/
+static bStatus_t cgmRACPSendRecord(cgmSensor_t *pSensor, cgmSession_t *pSession)
+{
+	cgmMeasPacked_t *pRecord=CGM_MEAS_DB_AT(pSensor,CGM_MEAS_DB_POS(pSensor,pSession->racp.cursor));
+#if (FEATURE_GLUCOSE_WIRE_IMAGE_DB==1)
+	//The record is already the notification value
+	cgmRACPRspNoti.len=pRecord->pdu[0];
+	osal_memcpy(cgmRACPRspNoti.value, pRecord->pdu, cgmRACPRspNoti.len);
+#else
+	cgmMeasC_t record;
+
+	cgmMeasUnpack(&record,pRecord);
+	cgmRACPRspNoti.len=cgmMeasSerialize(&record, cgmRACPRspNoti.value);
+#endif /*FEATURE_GLUCOSE_WIRE_IMAGE_DB==1*/
+	return CGM_MeasSend(pSession->connHandle, &cgmRACPRspNoti, cgmTaskId);
+}
+
 /**
     @brief   As part of the RACP operation, this function sends the set of historical
   	    measurement data to the collector APP sequencially. The resulting record
   	    would be received by the collector through the glucose measurement characteristic
   	    notification.
+    @details It runs at the end of every connection event while a transfer is in progress, when the stack has
+  	    released the buffers of the notifications sent during the event. Each run may queue as many records
+  	    as the transfer has credits. When the stack runs out of TX buffers, the refused record is kept for the
+  	    next run and the credits drop to what the stack accepted. After each run that used all its credits
+  	    without a refusal, the credits grow by one, up to CGM_RACP_BURST. Any other failure, e.g. the 
+  	    notifications being disabled, ends the transfer.
+  	    It is run by cgmTxSchedRun, after the live measurement, which takes one of the credits when it is sent
+  	    first. The live measurement thus preempts the transfer between two records. A run never queues more
+  	    than CGM_RACP_BURST PDUs, which bounds the time an abort request waits for the run to return, and the
+  	    number of records on air ahead of its response.
+  @param   pSensor - the sensor owning the database.
+  @param   pSession - the session of the transfer.
+  @param   sent - the number of PDUs already queued on its link in this connection event.
   @return  none*/
-static void cgmRACPSendNextMeas(){
+static void cgmRACPSendNextMeas(cgmSensor_t *pSensor, cgmSession_t *pSession, uint8 sent){
+	bStatus_t status=SUCCESS;
 
-	if (cgmMeasDBSendIndx < cgmMeasDBSearchNum)
+	if (pSession->racp.state!=CGM_RACP_PROC_SENDING)
+		return;
+	while (sent<pSession->racp.credits && pSession->racp.remaining>0)
 	{
-		cgmMeasC_t *currentRecord=cgmMeasDB+((cgmMeasDBSearchStart+cgmMeasDBSendIndx)%CGM_MEAS_DB_SIZE);
-		//att value notification structure
-		uint8 *p=cgmRACPRspNoti.value;
-		uint8 flags=currentRecord->flags;
-
-		//load data into the package buffer
-		*p++ = currentRecord->size;
-		*p++ = flags;
-		*p++ = LO_UINT16(currentRecord->concentration);
-		*p++ = HI_UINT16(currentRecord->concentration);
-		*p++ = LO_UINT16(currentRecord->timeoffset);
-		*p++ = HI_UINT16(currentRecord->timeoffset);
-
-		if (flags & CGM_STATUS_ANNUNC_STATUS_OCT)
-			*p++ = (currentRecord->annunciation) & 0xFF;
-		if (flags & CGM_STATUS_ANNUNC_WARNING_OCT)
-			*p++ = (currentRecord->annunciation>>16) & 0xFF;
-		if (flags & CGM_STATUS_ANNUNC_CAL_TEMP_OCT)
-			*p++ = (currentRecord->annunciation>>8)  & 0xFF;
-		if (flags & CGM_TREND_INFO_PRES)
-		{  
-			*p++ = LO_UINT16(currentRecord->trend);
-			*p++ = HI_UINT16(currentRecord->trend);
-		}
-		if (flags & CGM_QUALITY_PRES)
-		{ 
-			*p++ = LO_UINT16(currentRecord->quality);
-			*p++ = HI_UINT16(currentRecord->quality);
-		}	
-		cgmRACPRspNoti.len=currentRecord->size;
-#if (FEATURE_GLUCOSE_CRC==1)
-		uint16 crc_temp=0;
-		//Calculate the CCITT-CRC
-		crc_temp=ccitt_crc16(cgmRACPRspNoti.value,cgmRACPRspNoti.len);
-		//Append the CRC to the message
-		*p++ = LO_UINT16(crc_temp);
-		*p++ = HI_UINT16(crc_temp);
-		cgmRACPRspNoti.len+=2;	
-#endif /* FEATURE_GLUCOSE_CRC==1*/
-		cgmMeasDBSendIndx++;
-		CGM_MeasSend(gapConnHandle, &cgmRACPRspNoti, cgmTaskId);
-		osal_start_timerEx(cgmTaskId, RACP_IND_SEND_EVT, 1000); //EXTRA: set the timer to be smaller to improve speed
+		status=cgmRACPSendRecord(pSensor,pSession);
+		if (status!=SUCCESS)
+			break;
+		//Step to the next record, over the deleted ones
+		pSession->racp.cursor=CGM_MEAS_DB_SEQ(pSensor,cgmMeasDBNextLive(pSensor,CGM_MEAS_DB_POS(pSensor,pSession->racp.cursor)+1));
+		pSession->racp.remaining--;
+		sent++;
 	}
-	else
+	switch (status)
+	{
+		case SUCCESS:
+			if (sent==pSession->racp.credits && pSession->racp.credits<CGM_RACP_BURST)
+				pSession->racp.credits++;
+			break;
+		//The stack is out of TX buffers: retry the same record on the next connection event
+		case blePending:
+		case MSG_BUFFER_NOT_AVAIL:
+		case bleMemAllocError:
+			pSession->racp.credits=(sent>0) ? sent : 1;
+			return;
+		//The transfer cannot go on
+		default:
+			cgmRACPStopSend(pSensor,pSession);
+			cgmRACPRsp.len=4;
+			cgmRACPRsp.value[0]=CTL_PNT_OP_REQ_RSP;
+			cgmRACPRsp.value[1]=CTL_PNT_OPER_NULL;
+			cgmRACPRsp.value[2]=CTL_PNT_OP_REQ;
+			cgmRACPRsp.value[3]=CTL_PNT_RSP_PROC_NOT_CMPL;
+			CGM_RACPIndicate(pSession->connHandle, &cgmRACPRsp, cgmTaskId);
+			return;
+	}
+	if (pSession->racp.remaining==0)
 	{
 		//The current RACP transfer is finished. Indicate the a success to the RACP operation
-		osal_stop_timerEx(cgmTaskId, RACP_IND_SEND_EVT);
+		cgmRACPStopSend(pSensor,pSession);
 		cgmRACPRsp.len=4;
 		cgmRACPRsp.value[0]=CTL_PNT_OP_REQ_RSP;
 		cgmRACPRsp.value[1]=CTL_PNT_OPER_NULL;
 		cgmRACPRsp.value[2]=CTL_PNT_OP_REQ;
 		cgmRACPRsp.value[3]=CTL_PNT_RSP_SUCCESS;
-		CGM_RACPIndicate(gapConnHandle, &cgmRACPRsp, cgmTaskId);
-		CGM_SetSendState(false);
+		CGM_RACPIndicate(pSession->connHandle, &cgmRACPRsp, cgmTaskId);
 	}
+}
+
+/**
+  @ingroup racpgrp
+    @brief   Start sending the records found by the last search. The first records are queued right away and 
+  	    the rest at the end of each following connection event.
+  @param   pSensor - the sensor owning the database.
+  @param   pSession - the session whose search result is sent.
+  @return  none*/
+static void cgmRACPStartSend(cgmSensor_t *pSensor, cgmSession_t *pSession)
+{
+	pSession->racp.state=CGM_RACP_PROC_SENDING;
+	pSession->racp.cursor=pSession->measDBSearchStart;
+	pSession->racp.remaining=pSession->measDBSearchNum;
+	pSession->racp.credits=CGM_RACP_BURST;
+	CGM_SetSendState(pSession->connHandle, true);
+	cgmTxSchedUpdate(pSensor);
+	osal_set_event(cgmTaskId, RACP_IND_SEND_EVT);
+}
 
+/**
+  @ingroup racpgrp
+    @brief   Stop the RACP record transfer, whether it is finished, aborted or the link is lost.
+  @details The transfer is cancelled at once: nothing is left for a later event to undo, and a run that
+  	    is still scheduled sends no record. A live measurement waiting in the TX scheduler stays there.
+  @param   pSensor - the sensor owning the database.
+  @param   pSession - the session of the transfer.
+  @return  none*/
+static void cgmRACPStopSend(cgmSensor_t *pSensor, cgmSession_t *pSession)
+{
+	pSession->racp.state=CGM_RACP_PROC_IDLE;
+	pSession->racp.remaining=0;
+	cgmTxSchedUpdate(pSensor);
+	CGM_SetSendState(pSession->connHandle, false);
 }
 
 
@@ -2009,11 +2904,69 @@ static void cgmRACPSendNextMeas(){
   @ingroup racpgrp
     @brief   Reset the cgm measurement history database.
   @return  none */
-static void cgmResetMeasDB()
+static void cgmResetMeasDB(cgmSensor_t *pSensor)
+{
+	pSensor->measDBOldestIndx=0;
+	pSensor->measDBCount=0;
+	pSensor->measDBGapNum=0;
+}
+
+#if (FEATURE_GLUCOSE_PERSISTENT_LOG==1)
+/**
+  @ingroup racpgrp
+    @brief  Rebuild the measurement database from the persistent log after a reset.
+  @details The session resumes after the newest restored record, so the time offsets keep increasing.
+  @param   pSensor - the sensor owning the database.
+  @return  none*/
+static void cgmLogRestore(cgmSensor_t *pSensor)
+{
+	cgmLogInit(sizeof(cgmMeasPacked_t), CGM_MEAS_DB_OFFSET_POS, pSensor->measDBSize);
+	cgmLogLoad(cgmLogRestoreRecord, pSensor);
+	if (pSensor->measDBCount>0)
+	{
+		pSensor->timeOffset=CGM_MEAS_DB_OFFSET(CGM_MEAS_DB_AT(pSensor,pSensor->measDBCount-1))+pSensor->commInterval/1000;
+		osal_setClock(pSensor->timeOffset);
+	}
+}
+
+/**
+  @ingroup racpgrp
+    @brief  Add a record replayed from the persistent log to the database. It is called back by cgmLogLoad.
+  @param   pRecord - the packed record.
+  @param   pContext - the sensor owning the database.
+  @return  none*/
+static void cgmLogRestoreRecord(void *pRecord, void *pContext)
+{
+	cgmAddPackedRecord((cgmSensor_t *)pContext, (cgmMeasPacked_t *)pRecord);
+}
+
+/**
+  @ingroup racpgrp
+    @brief  Record in the persistent log a block of records about to be deleted from the database.
+  @details The block is recorded by the range of its time offsets, which costs one write of the log index. A block
+  	    at the front of the database also takes the older records the log may still hold, so that they do not
+  	    come back in its place on the next boot. Deleting every record empties the log.
+  @param   pSensor - the sensor owning the database.
+  @param   startindx - the sequence number of the first record of the block.
+  @param   endindx - the sequence number of the last record of the block.
+  @param   count - the number of records not deleted yet in the block.
+  @return  none*/
+static void cgmLogDeleteRecords(cgmSensor_t *pSensor, cgmMeasDBIndx_t startindx, cgmMeasDBIndx_t endindx, cgmMeasDBIndx_t count)
 {
-	cgmMeasDBOldestIndx=0;
-	cgmMeasDBCount=0;
+	cgmMeasDBIndx_t first=CGM_MEAS_DB_POS(pSensor,startindx);
+	uint16 from=CGM_MEAS_DB_OFFSET(CGM_MEAS_DB_AT(pSensor,first));
+
+	if (count>=cgmMeasDBLiveBetween(pSensor,0,pSensor->measDBCount))
+	{
+		cgmLogReset();
+		return;
+	}
+	//A block at the front leaves the newest record, so the range may run from just after it around to the end of the block
+	if (cgmMeasDBLiveBetween(pSensor,0,first)==0)
+		from=CGM_MEAS_DB_OFFSET(CGM_MEAS_DB_AT(pSensor,pSensor->measDBCount-1))+1;
+	cgmLogDelete(from,CGM_MEAS_DB_OFFSET(CGM_MEAS_DB_AT(pSensor,CGM_MEAS_DB_POS(pSensor,endindx))));
 }
+#endif /*FEATURE_GLUCOSE_PERSISTENT_LOG==1*/
 
 /// \addtogroup calibrationgrp
 /// @{
@@ -2212,7 +3165,7 @@ static int16 cgmCaliDBSearch(uint16 recordnum){
  <tr><td>5</td><td>Parameter out of range</td></tr></table>*/
 static void cgmPHighVerifyInput(SFLOAT input, uint8 *result){
 	*result=CGM_SPEC_OP_RESP_SUCCESS;
-	if ( input > PATIENTHIGH_CONCENTRATION_MAX || input < PATIENTHIGH_CONCENTRATION_MIN)
+	if (!sfloatInRange(input, PATIENTHIGH_CONCENTRATION_MIN, PATIENTHIGH_CONCENTRATION_MAX))
 		*result = CGM_SPEC_OP_RESP_PARAM_NIR;	
 	return;
 }
@@ -2224,31 +3177,11 @@ static void cgmPHighVerifyInput(SFLOAT input, uint8 *result){
 static int8 cgmPHighProcessInput(SFLOAT input){
 	int8 res = 0;
 	/* Implementation specific set patient defined glucose high value goes here*/
-	cgmPatientHigh=input;	//Currently we just change the internal variable to the input value. For custom implementations, we can develop more rigorous procedure.
+	cgmAlertSet(CGM_ALERT_PHIGH,input);	//Currently we just change the alert table to the input value. For custom implementations, we can develop more rigorous procedure.
 	/* End of configuration function.*/
 	return res;
 }
 
-/**
- * @brief Reset the variables related to patient defined glucose high alert of the sensor device.
- * @return none*/
-static void cgmPHighReset(void){
-	cgmPatientHigh=PATIENTHIGH_CONCENTRATION_DEFAULT;
-
-}
-/**
- * @brief This function tests whether the CGM measure exceeds the patient set glucose high level
- * @details This function is called in the cgmNewGlucoseMeas(). If the method determines that current measurement exceeds the patient defined high level, then the corresponding flag is set. 
- * @return <table><tr><td>0</td><td>Success with no alert set</td></tr>
- * 		  <tr><td>-1</td><td>Fail</td></tr></table>
- * 		  <tr><td>0x010000</td><td>Success patient high alert set</td></tr></table>*/
-static int32 cgmPHighTest(SFLOAT currentConcentration){
-	if (currentConcentration > cgmPatientHigh)
-	{
-		return CGM_STATUS_ANNUNC_HIGH_PATIRNT;
-	}
-	return 0;
-}
 
 /**
  * @brief Verify the input value of patient low setting fall into the server allowable range.
@@ -2264,7 +3197,7 @@ static int32 cgmPHighTest(SFLOAT currentConcentration){
  </table>*/
 static void cgmPLowVerifyInput(SFLOAT input, uint8 *result){
 	*result=CGM_SPEC_OP_RESP_SUCCESS;
-	if ( input > PATIENTLOW_CONCENTRATION_MAX || input < PATIENTLOW_CONCENTRATION_MIN)
+	if (!sfloatInRange(input, PATIENTLOW_CONCENTRATION_MIN, PATIENTLOW_CONCENTRATION_MAX))
 		*result = CGM_SPEC_OP_RESP_PARAM_NIR;	
 	return;
 }
@@ -2276,55 +3209,18 @@ static void cgmPLowVerifyInput(SFLOAT input, uint8 *result){
 static int8 cgmPLowProcessInput(SFLOAT input){
 	int8 res = 0;
 	/* Implementation specific set patient defined glucose low value goes here*/
-	cgmPatientLow=input;	//Currently we just change the internal variable to the input value. For custom implementations, we can develop more rigorous procedure.
+	cgmAlertSet(CGM_ALERT_PLOW,input);	//Currently we just change the alert table to the input value. For custom implementations, we can develop more rigorous procedure.
 	/* End of configuration function.*/
 	return res;
 }
 
-/**
- * @brief Reset the variables related to patient defined glucose low alert of the sensor device.
- * @return none*/
-static void cgmPLowReset(void){
-	cgmPatientLow=PATIENTLOW_CONCENTRATION_DEFAULT;
-
-}
 
-/**
- * @brief This function tests whether the CGM measure exceeds the patient set glucose low level
- * @details This function is called in the cgmNewGlucoseMeas(). If the method determines that current measurement exceeds the patient defined low level, then the corresponding flag is set. 
- * @return <table><tr><td>0</td><td>Success with no alert set</td></tr>
- * 		  <tr><td>-1</td><td>Fail</td></tr>
- * 		  <tr><td>0x0800000</td><td>Success patient low alert set</td></tr></table>*/
-static int32 cgmPLowTest(SFLOAT currentConcentration){
-	if (currentConcentration < cgmPatientLow)
-	{
-		return CGM_STATUS_ANNUNC_LOW_PATIENT;
-	}
-	return 0;
-}
 #endif /*FEATURE_GLUCOSE_PATIENTHIGHLOW==1*/
 /// @}
 
 /// \addtogroup hyperalertgrp
 /// @{
 #if (FEATURE_GLUCOSE_HYPERALERT==1)
-/**
- * @brief Test whether the input CGM measure exceeds the hyperglycemia level.
- * @param [in] currentConcentration - the glucose concentration to be tested.
- * @return The result of the test, which is compatible with the input. 
- * 		<table><tr><td>0</td><td>Success with no alert set</td></tr>
- * 		  <tr><td>-1</td><td>Fail</td></tr></table>
- * 		  <tr><td>0x080000</td><td>Success patient low alert set</td></tr></table>*/
-static int32 cgmAHyperTest(SFLOAT currentConcentration){
-	//Make sure the hyperglycemia value is positive
-	//Also when it is interpreted as SFLOAT, the exponent is 0.
-	int32 hyperthreshold_cal = cgmHyperThreshold & (0x07FF);
-	if (hyperthreshold_cal <= currentConcentration)
-	{
-		return CGM_STATUS_ANNUNC_HIGH_HYPER;
-	}
-	return 0;
-}
 
 /**
  * @brief Verify the input hyperglycemia threshold is within allowable range of the system
@@ -2341,7 +3237,7 @@ static int32 cgmAHyperTest(SFLOAT currentConcentration){
  * @return none */
 static void cgmAHyperVerifyInput(SFLOAT input, uint8 *result){
 	*result=CGM_SPEC_OP_RESP_SUCCESS;
-	if ( input > HYPERALERT_CONCENTRATION_MAX || input < HYPERALERT_CONCENTRATION_MIN)
+	if (!sfloatInRange(input, HYPERALERT_CONCENTRATION_MIN, HYPERALERT_CONCENTRATION_MAX))
 		*result = CGM_SPEC_OP_RESP_PARAM_NIR;	
 	return;
 }
@@ -2353,41 +3249,17 @@ static void cgmAHyperVerifyInput(SFLOAT input, uint8 *result){
 static int8 cgmAHyperProcessInput(SFLOAT input){
 	int8 res = 0;
 	/* Implementation specific set hyperglycemia alert threshold value goes here*/
-	cgmHyperThreshold=input;	//Currently we just change the internal variable to the input value. For custom implementations, we can develop more rigorous procedure.
+	cgmAlertSet(CGM_ALERT_HYPER,input);	//Currently we just change the alert table to the input value. For custom implementations, we can develop more rigorous procedure.
 	/* End of configuration function.*/
 	return res;
 }
 
-/**
- * @brief Reset the variables related to patient defined glucose hyperglycemia alert of the sensor device.
- * @return none*/
-static void cgmAHyperReset(void){
-	cgmHyperThreshold=HYPERALERT_CONCENTRATION_DEFAULT;
-
-}
 #endif /* FEATURE_GLUCOSE_HYPERALERT*/
 /// @}
 
 /// \addtogroup hypoalertgrp
 /// @{
 #if (FEATURE_GLUCOSE_HYPOALERT==1)
-/**
- * @brief Test whether the input CGM measure exceeds the hypoglycemia level.
- * @param [in] currentConcentration - the glucose concentration to be tested.
- * @return The result of the test, which is compatible with the input. 
- * 		<table><tr><td>0</td><td>Success with no alert set</td></tr>
- * 		  <tr><td>-1</td><td>Fail</td></tr></table>
- * 		  <tr><td>0x080000</td><td>Success patient low alert set</td></tr></table>*/
-static int32 cgmAHypoTest(SFLOAT currentConcentration){
-	//Make sure the hypoglycemia value is positive
-	//Also when it is interpreted as SFLOAT, the exponent is 0.
-	int32 hypothreshold_cal = cgmHypoThreshold & (0x07FF);
-	if (hypothreshold_cal >= currentConcentration)
-	{
-		return CGM_STATUS_ANNUNC_LOW_HYPO;
-	}
-	return 0;
-}
 
 /**
  * @brief Verify the input hypoglycemia threshold is within allowable range of the system
@@ -2404,7 +3276,7 @@ static int32 cgmAHypoTest(SFLOAT currentConcentration){
  * @return none */
 static void cgmAHypoVerifyInput(SFLOAT input, uint8 *result){
 	*result=CGM_SPEC_OP_RESP_SUCCESS;
-	if ( input > HYPOALERT_CONCENTRATION_MAX || input < HYPOALERT_CONCENTRATION_MIN)
+	if (!sfloatInRange(input, HYPOALERT_CONCENTRATION_MIN, HYPOALERT_CONCENTRATION_MAX))
 		*result = CGM_SPEC_OP_RESP_PARAM_NIR;	
 	return;
 }
@@ -2416,17 +3288,11 @@ static void cgmAHypoVerifyInput(SFLOAT input, uint8 *result){
 static int8 cgmAHypoProcessInput(SFLOAT input){
 	int8 res = 0;
 	/* Implementation specific set hypoglycemia alert threshold value goes here*/
-	cgmHypoThreshold=input;	//Currently we just change the internal variable to the input value. For custom implementations, we can develop more rigorous procedure.
+	cgmAlertSet(CGM_ALERT_HYPO,input);	//Currently we just change the alert table to the input value. For custom implementations, we can develop more rigorous procedure.
 	/* End of configuration function.*/
 	return res;
 }
 
-/**
- * @brief Reset the variables related to patient defined glucose hypoglycemia alert of the sensor device.
- * @return none*/
-static void cgmAHypoReset(void){
-	cgmHypoThreshold=HYPOALERT_CONCENTRATION_DEFAULT;
-}
 #endif /* FEATURE_GLUCOSE_HYPOALERT*/
 /// @}
 
@@ -2434,35 +3300,6 @@ static void cgmAHypoReset(void){
 /// \addtogroup ratealertgrp
 ///@{
 #if (FEATURE_GLUCOSE_RATEALERT==1)
-/**
- * @brief Test whether the input CGM measure exceeds the normal rate of change range.
- * @param [in] currentRate - the rate of change to be tested.
- * @return The result of the test, which is compatible with the input. 
- * 		<table><tr><td>0</td><td>Success with no alert set</td></tr>
- * 		  <tr><td>-1</td><td>Fail</td></tr></table>
- * 		  <tr><td>0x100000</td><td>Success , reading exceeds decrease rate range</td></tr>
- * 		  <tr><td>0x200000</td><td>Success , reading exceeds increase rate range</td></tr></table>
- * @note This function assume the input SFLOAT has one decimal number. Currently it is unable to perform comparison between SFLOATS with different decimal digit numbers. The program will ignore the input when the most significant nibble of the input is not F.*/
-static int32 cgmARateTest(SFLOAT currentRate)
-{
-	if ( (currentRate & 0x0800)==0){
-		//Currently only the threshold with 1 decimal is supported.
-		if ( (cgmIncreaseThreshold & 0xF000) == 0xF000){
-		if ( (currentRate & 0x07FF) > (cgmIncreaseThreshold & 0x07FF))
-			return CGM_STATUS_ANNUNC_EXCEEDED_INCR_RATE;
-		}
-	}
-	else{
-		//Currently only the threshold with 1 decimal is supported.
-		if ( (cgmDecreaseThreshold & 0xF000) == 0xF000){
-		if ( (currentRate & 0x07FF) < ( cgmDecreaseThreshold & 0x07FF))
-			return CGM_STATUS_ANNUNC_EXCEEDED_DESC_RATE;
-		}
-	}
-	return 0;
-
-
-}
 
 
 /**
@@ -2478,7 +3315,7 @@ static int32 cgmARateTest(SFLOAT currentRate)
  <tr><td>4</td><td>Procedure not completed</td></tr>
  <tr><td>5</td><td>Parameter out of range</td></tr>
  </table>
-  @note This function assume the input SFLOAT has one decimal number. Currently it is unable to perform comparison between SFLOATS with different decimal digit numbers. The program will ignore the input when the most significant nibble of the input is not F.*/
+  @note The input is compared by value, so a threshold may be sent with any exponent.*/
 static void cgmARateVerifyInput(SFLOAT input, uint8 *result)
 {
 	*result = CGM_SPEC_OP_RESP_SUCCESS;
@@ -2487,13 +3324,13 @@ static void cgmARateVerifyInput(SFLOAT input, uint8 *result)
 		return;
         */
 	//If it is a negative number, then use the decrease rate criterion
-	if( (input & 0x0800) !=0 ){
-		if ( (input & 0x07FF) < (RATEALERT_DECREASE_MAX & 0x07FF) || (input & 0x07FF) > (RATEALERT_DECREASE_MIN & 0x7FF))
+	if (sfloatCompare(input, 0)<0){
+		if (!sfloatInRange(input, RATEALERT_DECREASE_MAX, RATEALERT_DECREASE_MIN))
 			*result = CGM_SPEC_OP_RESP_PARAM_NIR;
 	}
 	//If it is a positive number, then use the increase rate criterion
 	else{
-		if ( (input & 0x07FF) > (RATEALERT_INCREASE_MAX & 0x07FF) || (input & 0x07FF) < (RATEALERT_INCREASE_MIN & 0x07FF))
+		if (!sfloatInRange(input, RATEALERT_INCREASE_MIN, RATEALERT_INCREASE_MAX))
 			*result = CGM_SPEC_OP_RESP_PARAM_NIR;
 	}
 }
@@ -2508,24 +3345,144 @@ static int8 cgmARateProcessInput(SFLOAT input, uint8 opcode)
 {
 	// If the input is a negative number.
 	if ( opcode == CGM_SPEC_OP_SET_ALERT_RATE_INCREASE)
-	cgmIncreaseThreshold = input;
+		cgmAlertSet(CGM_ALERT_RATE_INCREASE,input);
 	else
-	cgmDecreaseThreshold = input;
+		cgmAlertSet(CGM_ALERT_RATE_DECREASE,input);
 	return 0;
 }
 
+#endif /*FEATURE_GLUCOSE_RATEALERT==1*/
+///@}
+
+
+/// \addtogroup alertgrp
+///@{
 /**
-    @ingroup ratealertgrp
- *  @brief Reset the variables related to the rate alert of the sensor device.
- *  @return none.*/
-static void cgmARateReset(void)
+ * @brief Put the alert table back to its power up thresholds, and clear the alerts raised.
+ * @return none*/
+static void cgmAlertReset(void)
 {
-		cgmIncreaseThreshold=RATEALERT_INCREASE_DEFAULT;
-		cgmDecreaseThreshold=RATEALERT_DECREASE_DEFAULT;				
+	osal_memcpy(cgmAlertTable, cgmAlertDefaults, sizeof(cgmAlertTable));
+	cgmAlertActive=0;
 }
+
+/**
+ * @brief Set the threshold of an alert. Whether the alert is evaluated is left to its enable bit.
+ * @details The SFLOAT is brought to the unit of the alert, mg/dL or 0.1 mg/dL/min, whatever its exponent.
+ * @param [in] alert - the alert, CGM_ALERT_*.
+ * @param [in] input - the threshold, as received through the CGMCP.
+ * @return none*/
+static void cgmAlertSet(uint8 alert, SFLOAT input)
+{
+	cgmAlert_t *pAlert=cgmAlertTable+alert;
+	int32 level=sfloatToInt(input, (pAlert->flags & CGM_ALERT_ON_TREND) ? -1 : 0);
+
+	if (level>0x7FFF)
+		level=0x7FFF;
+	else if (level<-0x7FFF)
+		level=-0x7FFF;
+	pAlert->setting=input;
+	pAlert->threshold=(int16)level;
+}
+
+/**
+ * @brief Find the alert table entry of an alert from the CGMCP opcode setting its level.
+ * @param [in] opcode - the CGM_SPEC_OP_SET_ALERT_* opcode of the alert.
+ * @return the alert, CGM_ALERT_*, or CGM_ALERT_NUM when the opcode names no alert supported by the sensor.*/
+static uint8 cgmAlertFromOpcode(uint8 opcode)
+{
+	switch (opcode)
+	{
+#if (FEATURE_GLUCOSE_PATIENTHIGHLOW==1)
+	case CGM_SPEC_OP_SET_ALERT_HIGH:		return CGM_ALERT_PHIGH;
+	case CGM_SPEC_OP_SET_ALERT_LOW:			return CGM_ALERT_PLOW;
+#endif /*FEATURE_GLUCOSE_PATIENTHIGHLOW==1*/
+#if (FEATURE_GLUCOSE_HYPERALERT==1)
+	case CGM_SPEC_OP_SET_ALERT_HYPER:		return CGM_ALERT_HYPER;
+#endif /*FEATURE_GLUCOSE_HYPERALERT==1*/
+#if (FEATURE_GLUCOSE_HYPOALERT==1)
+	case CGM_SPEC_OP_SET_ALERT_HYPO:		return CGM_ALERT_HYPO;
+#endif /*FEATURE_GLUCOSE_HYPOALERT==1*/
+#if (FEATURE_GLUCOSE_RATEALERT==1)
+	case CGM_SPEC_OP_SET_ALERT_RATE_INCREASE:	return CGM_ALERT_RATE_INCREASE;
+	case CGM_SPEC_OP_SET_ALERT_RATE_DECREASE:	return CGM_ALERT_RATE_DECREASE;
 #endif /*FEATURE_GLUCOSE_RATEALERT==1*/
-///@}
+	default:					return CGM_ALERT_NUM;
+	}
+}
 
+/**
+ * @brief Enable or disable an alert and set its hysteresis, as received through the CGMCP.
+ * @details A disabled alert is cleared at once. The hysteresis is brought to the unit of the alert like its threshold.
+ * @param [in] alert - the alert, CGM_ALERT_*.
+ * @param [in] enable - non zero to evaluate the alert.
+ * @param [in] hysteresis - how far back past the threshold the value has to go to clear the alert.
+ * @return CGM_SPEC_OP_RESP_SUCCESS, or CGM_SPEC_OP_RESP_PARAM_NIR when the hysteresis is not a finite non negative value.*/
+static uint8 cgmAlertConfigure(uint8 alert, uint8 enable, SFLOAT hysteresis)
+{
+	cgmAlert_t *pAlert=cgmAlertTable+alert;
+	int32 level=sfloatToInt(hysteresis, (pAlert->flags & CGM_ALERT_ON_TREND) ? -1 : 0);
+
+	if (!sfloatIsFinite(hysteresis) || level<0 || level>0x7FFF)
+		return CGM_SPEC_OP_RESP_PARAM_NIR;
+	pAlert->hysteresis=(int16)level;
+	pAlert->enabled=enable;
+	if (!enable)
+		cgmAlertActive &= ~pAlert->annunc;
+	return CGM_SPEC_OP_RESP_SUCCESS;
+}
+
+/**
+ * @brief Evaluate the alert table over a run of consecutive samples.
+ * @details The evaluation takes two passes. The first compares every sample with the raise and clear levels of every
+ *	    enabled alert, with the same straight-line code for all of them, so that host compilers vectorize it over
+ *	    the samples. Each comparison leaves a bit in pAlerts: the annunciation bit of the alert when it is past its
+ *	    threshold, and a hold bit when it is past the threshold less the hysteresis. The second pass walks the
+ *	    samples in order, keeping an alert raised while its hold bit is set. The alerts raised by the last sample are
+ *	    remembered for the next call.
+ * @param [in] pGlucose - the concentrations, in mg/dL.
+ * @param [in] pRate - the rates of change, in 0.1 mg/dL/min.
+ * @param [out] pAlerts - the annunciation bits of the alerts raised at each sample.
+ * @param [in] num - the number of samples.
+ * @return none*/
+static void cgmAlertEvaluate(const int16 *pGlucose, const int16 *pRate, uint32 *pAlerts, uint16 num)
+{
+	const cgmAlert_t *pAlert;
+	const int16 *pInput;
+	uint32 raiseBit, holdBit, held, active;
+	int32 raise, hold, sign;
+	uint16 i;
+	uint8 k;
+
+	for (i=0;i<num;i++)
+		pAlerts[i]=0;
+	for (k=0,pAlert=cgmAlertTable;k<CGM_ALERT_NUM;k++,pAlert++)
+	{
+		if (!pAlert->enabled)
+			continue;
+		//Turn the alert into "sign*value > level", for both the raise and the hold comparisons
+		pInput=(pAlert->flags & CGM_ALERT_ON_TREND) ? pRate : pGlucose;
+		sign=(pAlert->flags & CGM_ALERT_ABOVE) ? 1 : -1;
+		raise=sign*pAlert->threshold-((pAlert->flags & CGM_ALERT_INCLUSIVE) ? 1 : 0);
+		hold=raise-pAlert->hysteresis;
+		raiseBit=pAlert->annunc;
+		holdBit=(uint32)1<<(CGM_ALERT_HOLD_SHIFT+k);
+		for (i=0;i<num;i++)
+			pAlerts[i] |= ((sign*pInput[i]>raise) ? raiseBit : 0) | ((sign*pInput[i]>hold) ? holdBit : 0);
+	}
+	active=cgmAlertActive;
+	for (i=0;i<num;i++)
+	{
+		held=0;
+		for (k=0;k<CGM_ALERT_NUM;k++)
+			if (pAlerts[i] & ((uint32)1<<(CGM_ALERT_HOLD_SHIFT+k)))
+				held |= cgmAlertTable[k].annunc;
+		active=(pAlerts[i] & CGM_ALERT_MASK) | (active & held);
+		pAlerts[i]=active;
+	}
+	cgmAlertActive=active;
+}
+///@}
 
 /// @addtogroup crc16grp 
 /// @{
@@ -2563,6 +3520,8 @@ static  int8 cgmCtlPntMsgFindCRC( cgmCtlPntMsg_t* pMsg){
 		case CGM_SPEC_OP_GET_ALERT_RATE_INCREASE:result=(len>3)?1:0;break;
 		case CGM_SPEC_OP_STOP_SES:
 		case CGM_SPEC_OP_START_SES:result=(len>3)?1:0;break;
+		case CGM_SPEC_OP_SET_ALERT_CONFIG:result=(len>=7)?1:0;break;
+		case CGM_SPEC_OP_GET_ALERT_CONFIG:result=(len>=4)?1:0;break;
 	}
 	return result;
 }
@@ -2612,38 +3571,70 @@ static  int8 cgmRACPMsgFindCRC( cgmRACPMsg_t* pMsg){
 /// @{
 /**
  * @brief The function to delete a block of entries from the measurement database.
- * @param [in] startindx -  the starting index of the record entry block
- * @param [in] endindx - the ending index of the record entry block
- * @param [in] count - the total number of record in the entry block.
+ * @details The records are not moved. The block is removed at once when it is at either end of the database,
+ *	    otherwise it is recorded as a span of deleted records, merged with the spans it overlaps or touches,
+ *	    and left to cgmMeasDBCompact. The database is compacted at once when there are too many spans.
+ * @param [in] startindx -  the sequence number of the first record of the block
+ * @param [in] endindx - the sequence number of the last record of the block
+ * @param [in] count - the number of records not deleted yet in the block.
  * @return The code corresponds to the RACP response code.*/
-static uint8 cgmRACPClearRecord(uint8 startindx, uint8 endindx, uint16 count){
+static uint8 cgmRACPClearRecord(cgmSensor_t *pSensor, cgmMeasDBIndx_t startindx, cgmMeasDBIndx_t endindx, cgmMeasDBIndx_t count){
+	cgmMeasDBIndx_t first=CGM_MEAS_DB_POS(pSensor,startindx);
+	cgmMeasDBIndx_t last=CGM_MEAS_DB_POS(pSensor,endindx)+1;
+	cgmMeasDBIndx_t start,end,shift;
+	uint8 i,j;
+
 	// If the block to delete is the entire database. Simply reset the database
-	if (count>=cgmMeasDBCount){
-			cgmResetMeasDB();
+	if (count>=cgmMeasDBLiveBetween(pSensor,0,pSensor->measDBCount)){
+			cgmResetMeasDB(pSensor);
 			return CTL_PNT_RSP_SUCCESS;
 	}
-	// If the block to delete ends at the last record
-	uint8 lastrecordindx = (cgmMeasDBOldestIndx+cgmMeasDBCount-1)%CGM_MEAS_DB_SIZE;
-	if (endindx == lastrecordindx){
-		//just need to reset the index
-		cgmMeasDBCount-=count;
-		cgmMeasDBWriteIndx=startindx;
+	// Merge the spans the block overlaps or touches into the block
+	for (i=0,j=0;i<pSensor->measDBGapNum;i++){
+		start=CGM_MEAS_DB_POS(pSensor,pSensor->measDBGap[i].start);
+		end=start+pSensor->measDBGap[i].num;
+		if (end>=first && start<=last){
+			if (start<first)
+				first=start;
+			if (end>last)
+				last=end;
+		}
+		else
+			pSensor->measDBGap[j++]=pSensor->measDBGap[i];
+	}
+	pSensor->measDBGapNum=j;
+	// If the block to delete starts at the oldest record
+	if (first==0){
+		cgmMeasDBDropOldest(pSensor,last);
+		return CTL_PNT_RSP_SUCCESS;
+	}
+	// If the block to delete ends at the last record, just need to reset the index, and drop the span left at the end
+	if (last==pSensor->measDBCount){
+		if (pSensor->measDBGapNum>0
+			&& CGM_MEAS_DB_POS(pSensor,pSensor->measDBGap[pSensor->measDBGapNum-1].start)+pSensor->measDBGap[pSensor->measDBGapNum-1].num==first){
+			pSensor->measDBGapNum--;
+			first=CGM_MEAS_DB_POS(pSensor,pSensor->measDBGap[pSensor->measDBGapNum].start);
+		}
+		pSensor->measDBCount=first;
+		pSensor->measDBWriteIndx=CGM_MEAS_DB_SLOT(pSensor,pSensor->measDBOldestIndx,first);
+		pSensor->measDBStepRun=0;	//The spacing of the remaining records is no longer known
 		return CTL_PNT_RSP_SUCCESS;
 	}
-	// If the block to delete sits inside of a range.
-	uint8 probeindx,newindx;
-	uint16 count_temp;
-	count_temp= (CGM_MEAS_DB_SIZE+lastrecordindx-endindx)%CGM_MEAS_DB_SIZE;	// The number of records to be moved forward
-	probeindx= endindx+1;
-	newindx= startindx;
-	while(count_temp>0){
-		osal_memcpy(cgmMeasDB+newindx,cgmMeasDB+probeindx,sizeof(cgmMeasC_t));
-		newindx = (newindx+1)%CGM_MEAS_DB_SIZE;
-		probeindx = (probeindx+1)%CGM_MEAS_DB_SIZE;
-		count_temp--;
+	// If the block to delete sits inside of a range, keep it as a span. Make room first when all spans are used.
+	if (pSensor->measDBGapNum==CGM_MEAS_DB_GAPS){
+		for (i=0,shift=0;i<pSensor->measDBGapNum;i++)
+			if (CGM_MEAS_DB_POS(pSensor,pSensor->measDBGap[i].start)<first)
+				shift+=pSensor->measDBGap[i].num;
+		cgmMeasDBCompactAll(pSensor);
+		first-=shift;
+		last-=shift;
 	}
-	cgmMeasDBWriteIndx=newindx;
-	cgmMeasDBCount-=count;
+	for (i=pSensor->measDBGapNum;i>0 && CGM_MEAS_DB_POS(pSensor,pSensor->measDBGap[i-1].start)>first;i--)
+		pSensor->measDBGap[i]=pSensor->measDBGap[i-1];
+	pSensor->measDBGap[i].start=CGM_MEAS_DB_SEQ(pSensor,first);
+	pSensor->measDBGap[i].num=last-first;
+	pSensor->measDBGapNum++;
+	pSensor->measDBStepRun=0;	//The records around the deleted block are no longer evenly spaced
 	return CTL_PNT_RSP_SUCCESS;
 }
 /// @}
@@ -32,11 +32,13 @@ extern "C"
 
 
 // CGM application level constant
-#define CGM_MEAS_DB_SIZE                              10	///< The size for the RACP history database
+#ifndef CGM_MEAS_DB_SIZE
+#define CGM_MEAS_DB_SIZE                              10	///< The maximal size for the RACP history database. It can be overridden at build time. The 16-bit time offsets of the records, in seconds, must span less than one wrap, so e.g. at most 1092 records of one minute.
+#endif
 // CGM Task Events
 #define START_DEVICE_EVT                              0x0001	///< The task to be carried out by the application layer: Start device event
 #define NOTI_TIMEOUT_EVT                              0x0002	///< The task to be carried out by the application layer: timeout event for the next glucose notification
-#define RACP_IND_SEND_EVT			      0x0004	///< The task to be carried out by the application layer: send RACP indication
+#define RACP_IND_SEND_EVT			      0x0004	///< The task to be carried out by the application layer: send the waiting live measurement and the RACP records
 // Message event  
 #define CTL_PNT_MSG                                   0xE0	///< The event message past by the OS: OPCP message
 #define RACP_MSG				      0xE1	///< The event message past by the OS: RACP message 
@@ -0,0 +1,365 @@
+/*!
+\file		cgmLog.c
+\brief		This file contains the persistent measurement log, which keeps the measurement history across resets.
+\details	Records are opaque blocks of a fixed size. They are collected in a RAM batch buffer, and each time the buffer
+		is full it is written as one chunk, so the flash sees one write per batch instead of one per record. The chunks
+		rotate through a set of SNV items, overwriting the oldest one once all of them are used. There are just
+		enough of them for the history the log is opened with, up to CGM_LOG_CHUNKS. SNV itself appends
+		every write to its active page and compacts it into the other page when full, which spreads the erase cycles.
+		A small index item records which chunk is the oldest and how many are in use, so that the history is rebuilt
+		on boot from the index and the chunks alone. The records still in the batch buffer are lost on a reset.
+
+		Records are never rewritten to delete them. Each record carries a 16-bit key, and a deletion is kept in the
+		index as a range of keys along with the sequence number of the next record to be logged, so that it applies
+		to the records logged before it only. The records it covers are skipped when the log is replayed, and it is
+		dropped from the index once they have all been overwritten.
+
+		On targets other than the 8051 each item is kept in a file of the current directory, standing in for SNV.
+\author		Harry Qiu
+\version        1
+\date		2015-March-20
+\copyright	MIT License (MIT)\n
+ Copyright (c) 2014-2015 Center for Global ehealthinnovation
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions: The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#if defined(__ICC8051__)
+#include "bcomdef.h"
+#include "OSAL.h"
+#include "osal_snv.h"
+#define CGM_LOG_SCRATCH_ALLOC(bytes)	osal_mem_alloc(bytes)	///< Allocates the chunk buffer of a compaction
+#define CGM_LOG_SCRATCH_FREE(p)		osal_mem_free(p)	///< Frees the chunk buffer of a compaction
+#else
+#include <stdio.h>
+#include <stdlib.h>
+#define CGM_LOG_SCRATCH_ALLOC(bytes)	malloc(bytes)
+#define CGM_LOG_SCRATCH_FREE(p)		free(p)
+#endif
+#include <string.h>
+#include "cgmlog.h"
+
+#define CGM_LOG_VERSION		0x04	///< The layout version stored in the index. A log of another version is discarded
+
+/// \brief A deletion recorded in the index.
+typedef struct {
+	unsigned short	from;			///< The key of the first record deleted.
+	unsigned short	to;			///< The key of the last record deleted. The range wraps around past 0xFFFF when it is less than from.
+	unsigned short	limit;			///< The sequence number of the first record logged after the deletion, which it does not apply to.
+} cgmLogDelete_t;
+
+/// \brief The content of the index item.
+typedef struct {
+	unsigned char	version;		///< The layout version, CGM_LOG_VERSION.
+	unsigned char	recordSize;		///< The size of a record. A log written with another record size is discarded.
+	unsigned char	first;			///< The chunk holding the oldest records.
+	unsigned char	count;			///< The number of chunks in use.
+	unsigned char	chunks;			///< The number of chunks the log rotates through.
+	unsigned char	deleteNum;		///< The number of deletions recorded.
+	unsigned short	firstSeq;		///< The sequence number of the oldest record in the log.
+	unsigned char	used[CGM_LOG_CHUNKS];	///< The number of records held by each chunk item. A chunk is written full, and holds fewer once compacted.
+	cgmLogDelete_t	deletes[CGM_LOG_DELETES];	///< The deletions still covering records of the log, in the order they were made.
+} cgmLogIndex_t;
+
+static cgmLogIndex_t	cgmLogIdx;				///< The RAM copy of the index item
+static unsigned char	cgmLogBatch[CGM_LOG_CHUNK_BYTES];	///< The batch buffer, the records not written to flash yet
+static unsigned char	cgmLogBatchCount;			///< The number of records in the batch buffer
+static unsigned char	cgmLogChunkRecords;			///< The number of records in a chunk
+static unsigned char	cgmLogKeyPos;				///< The position of the 16-bit key within a record
+
+/**
+@brief Find whether a record has been deleted.
+@param pRecord - the record.
+@param seq - the sequence number of the record.
+@return 1 if a deletion covers the record, 0 otherwise.*/
+static unsigned char cgmLogDeleted(unsigned char *pRecord, unsigned short seq)
+{
+	unsigned short key=pRecord[cgmLogKeyPos]|((unsigned short)pRecord[cgmLogKeyPos+1]<<8);
+	cgmLogDelete_t *pDel;
+	unsigned char i;
+	for (i=0,pDel=cgmLogIdx.deletes;i<cgmLogIdx.deleteNum;i++,pDel++)
+		if ((unsigned short)(seq-cgmLogIdx.firstSeq)<(unsigned short)(pDel->limit-cgmLogIdx.firstSeq)
+			&& (unsigned short)(key-pDel->from)<=(unsigned short)(pDel->to-pDel->from))
+			return 1;
+	return 0;
+}
+
+/**
+@brief Remove a deletion from the index.
+@param i - the position of the deletion.
+@return none*/
+static void cgmLogDeleteRemove(unsigned char i)
+{
+	cgmLogIdx.deleteNum--;
+	for (;i<cgmLogIdx.deleteNum;i++)
+		cgmLogIdx.deletes[i]=cgmLogIdx.deletes[i+1];
+}
+
+/**
+@brief Count the records held by the chunks in use.
+@return the number of records in flash.*/
+static unsigned short cgmLogLogged(void)
+{
+	unsigned short num=0;
+	unsigned char i;
+	for (i=0;i<cgmLogIdx.count;i++)
+		num+=cgmLogIdx.used[(cgmLogIdx.first+i)%cgmLogIdx.chunks];
+	return num;
+}
+
+/**
+@brief Read an item of the log storage.
+@param id - the item identifier.
+@param len - the number of bytes to read.
+@param pBuf - the destination.
+@return 0 on success, non zero if the item does not exist.*/
+static unsigned char cgmLogItemRead(unsigned char id, unsigned char len, void *pBuf)
+{
+#if defined(__ICC8051__)
+	return (osal_snv_read(id, len, pBuf)==SUCCESS) ? 0 : 1;
+#else
+	char name[16];
+	FILE *f;
+	size_t got;
+	sprintf(name, "cgmlog_%02x.bin", id);
+	if ((f=fopen(name, "rb"))==NULL)
+		return 1;
+	got=fread(pBuf, 1, len, f);
+	fclose(f);
+	return (got==len) ? 0 : 1;
+#endif
+}
+
+/**
+@brief Write an item of the log storage.
+@param id - the item identifier.
+@param len - the number of bytes to write.
+@param pBuf - the source.
+@return none*/
+static void cgmLogItemWrite(unsigned char id, unsigned char len, void *pBuf)
+{
+#if defined(__ICC8051__)
+	osal_snv_write(id, len, pBuf);
+#else
+	char name[16];
+	FILE *f;
+	sprintf(name, "cgmlog_%02x.bin", id);
+	if ((f=fopen(name, "wb"))!=NULL)
+	{
+		fwrite(pBuf, 1, len, f);
+		fclose(f);
+	}
+#endif
+}
+
+/**
+@brief Open the log, reading its index from the storage.
+@details A missing index, or one written with another layout, record size or number of chunks, starts an empty log.
+@param recordSize - the size of a record in bytes, at most CGM_LOG_CHUNK_BYTES.
+@param keyPos - the position within a record of its 16-bit key, least significant byte first. cgmLogDelete selects
+	       records by key.
+@param history - the number of records to keep. The log keeps at most CGM_LOG_CHUNKS full chunks of them.
+@return the number of chunks found in the log.*/
+unsigned char cgmLogInit(unsigned char recordSize, unsigned char keyPos, unsigned short history)
+{
+	unsigned short chunks, logged;
+	unsigned char i;
+	cgmLogChunkRecords=CGM_LOG_CHUNK_BYTES/recordSize;
+	cgmLogKeyPos=keyPos;
+	cgmLogBatchCount=0;
+	chunks=(history+cgmLogChunkRecords-1)/cgmLogChunkRecords;
+	if (chunks==0)
+		chunks=1;
+	else if (chunks>CGM_LOG_CHUNKS)
+		chunks=CGM_LOG_CHUNKS;
+	if (cgmLogItemRead(CGM_LOG_NVID_INDEX, sizeof(cgmLogIndex_t), &cgmLogIdx)!=0
+		|| cgmLogIdx.version!=CGM_LOG_VERSION || cgmLogIdx.recordSize!=recordSize || cgmLogIdx.chunks!=chunks
+		|| cgmLogIdx.first>=chunks || cgmLogIdx.count>chunks || cgmLogIdx.deleteNum>CGM_LOG_DELETES)
+	{
+		cgmLogIdx.version=CGM_LOG_VERSION;
+		cgmLogIdx.recordSize=recordSize;
+		cgmLogIdx.chunks=(unsigned char)chunks;
+		cgmLogReset();
+	}
+	//The records of the batch buffer are gone, and the records logged next take their sequence numbers
+	logged=cgmLogLogged();
+	for (i=0;i<cgmLogIdx.deleteNum;i++)
+		if ((unsigned short)(cgmLogIdx.deletes[i].limit-cgmLogIdx.firstSeq)>logged)
+			cgmLogIdx.deletes[i].limit=cgmLogIdx.firstSeq+logged;
+	return cgmLogIdx.count;
+}
+
+/**
+@brief Replay the logged records, oldest first, leaving out the deleted ones.
+@details The batch buffer is used to hold each chunk while it is replayed, so this is only meant to be called right
+	 after cgmLogInit.
+@param pfnRecord - the function called with every record.
+@param pContext - passed to pfnRecord unchanged.
+@return the number of records replayed.*/
+unsigned short cgmLogLoad(cgmLogRecordCB_t pfnRecord, void *pContext)
+{
+	unsigned short num=0;
+	unsigned short seq=cgmLogIdx.firstSeq;
+	unsigned char chunk=cgmLogIdx.first;
+	unsigned char i,j;
+	for (i=0;i<cgmLogIdx.count;i++)
+	{
+		if (cgmLogIdx.used[chunk]>0
+			&& cgmLogItemRead(CGM_LOG_NVID_CHUNK+chunk, cgmLogChunkRecords*cgmLogIdx.recordSize, cgmLogBatch)==0)
+		{
+			for (j=0;j<cgmLogIdx.used[chunk];j++)
+				if (!cgmLogDeleted(cgmLogBatch+j*cgmLogIdx.recordSize, seq+j))
+				{
+					pfnRecord(cgmLogBatch+j*cgmLogIdx.recordSize, pContext);
+					num++;
+				}
+		}
+		seq+=cgmLogIdx.used[chunk];
+		chunk=(chunk+1)%cgmLogIdx.chunks;
+	}
+	cgmLogBatchCount=0;
+	return num;
+}
+
+/**
+@brief Add a record to the log. The record is written to flash once a full chunk of records has been collected.
+@param pRecord - the record, of the size given to cgmLogInit.
+@return none*/
+void cgmLogAppend(void *pRecord)
+{
+	unsigned char chunk;
+	memcpy(cgmLogBatch+cgmLogBatchCount*cgmLogIdx.recordSize, pRecord, cgmLogIdx.recordSize);
+	if (++cgmLogBatchCount<cgmLogChunkRecords)
+		return;
+	//The batch is full. Write it over the chunk after the newest one, and then the index.
+	chunk=(cgmLogIdx.first+cgmLogIdx.count)%cgmLogIdx.chunks;
+	cgmLogItemWrite(CGM_LOG_NVID_CHUNK+chunk, cgmLogChunkRecords*cgmLogIdx.recordSize, cgmLogBatch);
+	if (cgmLogIdx.count<cgmLogIdx.chunks)
+		cgmLogIdx.count++;
+	else
+	{
+		cgmLogIdx.first=(cgmLogIdx.first+1)%cgmLogIdx.chunks;
+		cgmLogIdx.firstSeq+=cgmLogIdx.used[chunk];
+		//Forget the deletions whose records have all been overwritten
+		while (cgmLogIdx.deleteNum>0 && (short)(cgmLogIdx.deletes[0].limit-cgmLogIdx.firstSeq)<=0)
+			cgmLogDeleteRemove(0);
+	}
+	cgmLogIdx.used[chunk]=cgmLogChunkRecords;
+	cgmLogItemWrite(CGM_LOG_NVID_INDEX, sizeof(cgmLogIndex_t), &cgmLogIdx);
+	cgmLogBatchCount=0;
+}
+
+/**
+@brief Empty the log. Only the index is written, the chunks are left to be overwritten.
+@return none*/
+void cgmLogReset(void)
+{
+	cgmLogIdx.first=0;
+	cgmLogIdx.count=0;
+	cgmLogIdx.firstSeq=0;
+	cgmLogIdx.deleteNum=0;
+	memset(cgmLogIdx.used, 0, sizeof(cgmLogIdx.used));
+	cgmLogBatchCount=0;
+	cgmLogItemWrite(CGM_LOG_NVID_INDEX, sizeof(cgmLogIndex_t), &cgmLogIdx);
+}
+
+/**
+@brief Drop the deleted records from a run of records, keeping the others in order at its start.
+@param pRecords - the records.
+@param num - the number of records.
+@param seq - the sequence number of the first record.
+@return the number of records kept.*/
+static unsigned char cgmLogSqueeze(unsigned char *pRecords, unsigned char num, unsigned short seq)
+{
+	unsigned char size=cgmLogIdx.recordSize;
+	unsigned char i, kept=0;
+	for (i=0;i<num;i++)
+		if (!cgmLogDeleted(pRecords+i*size, seq+i))
+		{
+			if (kept!=i)
+				memcpy(pRecords+kept*size, pRecords+i*size, size);
+			kept++;
+		}
+	return kept;
+}
+
+/**
+@brief Remove the deleted records from the log, so that the index needs none of its deletions any more.
+@details Every chunk holding a deleted record is written again with the records left, and the chunks without one
+	 are not touched. The chunks keep their places in the rotation. The records of the batch buffer are squeezed
+	 in place. The sequence numbers are counted again from the oldest record, which is why every deletion is
+	 applied at once. The index is left to the caller to write.
+@return 0 on success, non zero if the chunk buffer could not be allocated, with the log unchanged.*/
+static unsigned char cgmLogCompact(void)
+{
+	unsigned short seq=cgmLogIdx.firstSeq;
+	unsigned char chunk=cgmLogIdx.first;
+	unsigned char *pChunk;
+	unsigned char i, num, kept;
+	pChunk=(unsigned char *)CGM_LOG_SCRATCH_ALLOC(cgmLogChunkRecords*cgmLogIdx.recordSize);
+	if (pChunk==NULL)
+		return 1;
+	for (i=0;i<cgmLogIdx.count;i++)
+	{
+		num=cgmLogIdx.used[chunk];
+		if (num>0)
+		{
+			kept=0;
+			if (cgmLogItemRead(CGM_LOG_NVID_CHUNK+chunk, cgmLogChunkRecords*cgmLogIdx.recordSize, pChunk)==0)
+				kept=cgmLogSqueeze(pChunk, num, seq);
+			if (kept<num && kept>0)
+				cgmLogItemWrite(CGM_LOG_NVID_CHUNK+chunk, cgmLogChunkRecords*cgmLogIdx.recordSize, pChunk);
+			cgmLogIdx.used[chunk]=kept;
+			seq+=num;
+		}
+		chunk=(chunk+1)%cgmLogIdx.chunks;
+	}
+	cgmLogBatchCount=cgmLogSqueeze(cgmLogBatch, cgmLogBatchCount, seq);
+	CGM_LOG_SCRATCH_FREE(pChunk);
+	cgmLogIdx.deleteNum=0;
+	//The oldest chunks left empty drop out of the rotation
+	while (cgmLogIdx.count>0 && cgmLogIdx.used[cgmLogIdx.first]==0)
+	{
+		cgmLogIdx.first=(cgmLogIdx.first+1)%cgmLogIdx.chunks;
+		cgmLogIdx.count--;
+	}
+	return 0;
+}
+
+/**
+@brief Delete the records logged so far whose key is within a range. Only the index is written, unless the log is
+	compacted.
+@details A recorded deletion that the new one covers is dropped. When all CGM_LOG_DELETES are in use, the log is
+	 compacted with cgmLogCompact first, which costs one write for each chunk holding a deleted record. Only if
+	 that fails for lack of memory are the two oldest deletions made into one deleting every record logged before
+	 the second of them, so the oldest records are given up rather than deleted records brought back.
+@param from - the key of the first record to delete.
+@param to - the key of the last record to delete. The range wraps around past 0xFFFF when it is less than from.
+@return none*/
+void cgmLogDelete(unsigned short from, unsigned short to)
+{
+	cgmLogDelete_t *pDel;
+	unsigned char i;
+	for (i=0;i<cgmLogIdx.deleteNum;)
+	{
+		pDel=cgmLogIdx.deletes+i;
+		if ((unsigned long)(unsigned short)(pDel->from-from)+(unsigned short)(pDel->to-pDel->from)<=(unsigned short)(to-from))
+			cgmLogDeleteRemove(i);
+		else
+			i++;
+	}
+	if (cgmLogIdx.deleteNum==CGM_LOG_DELETES && cgmLogCompact()!=0)
+	{
+		cgmLogIdx.deletes[1].from=cgmLogIdx.deletes[1].to+1;
+		cgmLogDeleteRemove(0);
+	}
+	pDel=cgmLogIdx.deletes+cgmLogIdx.deleteNum++;
+	pDel->from=from;
+	pDel->to=to;
+	pDel->limit=cgmLogIdx.firstSeq+cgmLogLogged()+cgmLogBatchCount;
+	cgmLogItemWrite(CGM_LOG_NVID_INDEX, sizeof(cgmLogIndex_t), &cgmLogIdx);
+}
@@ -0,0 +1,251 @@
+/*!
+\file		cgmModel.c
+\brief		This file contains a physiological glucose model, a synthetic source of simulation data.
+\details	The model is a small compartment model stepped once a minute in integer arithmetic:
+		- meals go through two gut compartments before appearing in the plasma glucose;
+		- insulin boluses go through two subcutaneous compartments before lowering it, by the insulin sensitivity;
+		- the glucose otherwise relaxes towards the basal level of the patient;
+		- the sensor reading adds a slow sensitivity drift and a noise from a xorshift generator, shaped to a
+		  near Gaussian by summing four uniform bytes.
+		Meals and boluses follow a daily schedule, so the size and timing of the excursions are set by the test, and
+		the whole trace is reproducible from the seed. The states of a batch of patients are kept as arrays, and a step
+		runs the same straight-line arithmetic over all of them, which host compilers vectorize.
+\author		Harry Qiu
+\version        1
+\date		2015-March-20
+\copyright	MIT License (MIT)\n
+ Copyright (c) 2014-2015 Center for Global ehealthinnovation
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions: The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "cgmmodel.h"
+
+#define CGM_MODEL_Q8(v)		((cgmModelInt_t)(v)<<8)		///< Convert a value in mg/dL to Q8
+#define CGM_MODEL_MUL(v,k)	(((v)*(cgmModelInt_t)(k)+2048)>>12)	///< Multiply a non negative Q8 value by a Q12 rate, rounding
+#define CGM_MODEL_CAP		CGM_MODEL_Q8(1000)	///< The largest glucose, and content of either pair of compartments, so that the products fit 32 bits
+#if defined(__ICC8051__)
+#define CGM_MODEL_RESTRICT					///< The arrays of a batch never overlap
+#else
+#define CGM_MODEL_RESTRICT	__restrict			///< The arrays of a batch never overlap, which spares the vectorizer its aliasing checks
+#endif
+#define CGM_MODEL_DRIFT_MAX	((cgmModelInt_t)1<<23)		///< The largest sensor sensitivity error, 50%
+
+/// The default patient: meals of 60g, 40g and 90g, the breakfast bolus too large and the dinner bolus too small,
+/// so that each day has a hypoglycemia before lunch and a hyperglycemia in the evening.
+static const cgmModelEvent_t cgmModelDefaultEvents[]={
+	{7*60,		CGM_MODEL_EVENT_MEAL,	60},
+	{7*60,		CGM_MODEL_EVENT_BOLUS,	90},
+	{12*60,		CGM_MODEL_EVENT_MEAL,	40},
+	{12*60,		CGM_MODEL_EVENT_BOLUS,	25},
+	{19*60,		CGM_MODEL_EVENT_MEAL,	90},
+	{19*60+30,	CGM_MODEL_EVENT_BOLUS,	30},
+};
+
+/// The default model parameters.
+const cgmModelParam_t cgmModelDefault={
+	120,		//basal, mg/dL
+	4*256,		//carbFactor, 4 mg/dL per gram
+	40,		//isf, mg/dL per unit
+	102,		//kabs, 1/40 per minute
+	74,		//kins, 1/55 per minute
+	20,		//kbasal, 1/200 per minute
+	3*256,		//noise, 3 mg/dL
+	58,		//drift, about 0.5% a day
+	cgmModelDefaultEvents,
+	sizeof(cgmModelDefaultEvents)/sizeof(cgmModelDefaultEvents[0]),
+	0x2545F491
+};
+
+/**
+@brief Put a batch of patients at their basal state, at the start of the schedule.
+@details The arrays of the batch must be set up. Each patient gets its own noise sequence, derived from the seed.
+@param pBatch - the batch.
+@param pParam - the shared parameters. They must stay valid while the batch is in use.
+@return none*/
+void	cgmModelBatchInit(cgmModelBatch_t *pBatch, const cgmModelParam_t *pParam)
+{
+	unsigned short i;
+	pBatch->pParam=pParam;
+	pBatch->minute=0;
+	for (i=0;i<pBatch->num;i++)
+	{
+		pBatch->pGlucose[i]=CGM_MODEL_Q8(pBatch->pBasal[i]);
+		pBatch->pGut1[i]=0;
+		pBatch->pGut2[i]=0;
+		pBatch->pIns1[i]=0;
+		pBatch->pIns2[i]=0;
+		pBatch->pDrift[i]=0;
+		pBatch->pRng[i]=(cgmModelUInt_t)(pParam->seed^(0x9E3779B9UL*(i+1UL)));
+		if (pBatch->pRng[i]==0)
+			pBatch->pRng[i]=1;
+	}
+}
+
+/**
+@brief Step the physiology and the sensor of a batch of patients by one minute.
+@details The arrays are passed as restricted parameters, so that the compiler knows they do not overlap and vectorizes
+	 the loop without aliasing checks.
+@param pParam - the shared parameters.
+@param num - the number of patients.
+@param pGlucose, pGut1, pGut2, pIns1, pIns2, pDrift, pRng, pBasal - the arrays of the batch.
+@param [out] pOut - the sensor readings in mg/dL, one per patient.
+@return none*/
+static void cgmModelKernel(const cgmModelParam_t *pParam, unsigned short num,
+			   cgmModelInt_t * CGM_MODEL_RESTRICT pGlucose, cgmModelInt_t * CGM_MODEL_RESTRICT pGut1,
+			   cgmModelInt_t * CGM_MODEL_RESTRICT pGut2, cgmModelInt_t * CGM_MODEL_RESTRICT pIns1,
+			   cgmModelInt_t * CGM_MODEL_RESTRICT pIns2, cgmModelInt_t * CGM_MODEL_RESTRICT pDrift,
+			   cgmModelUInt_t * CGM_MODEL_RESTRICT pRng, const unsigned short * CGM_MODEL_RESTRICT pBasal,
+			   unsigned short * CGM_MODEL_RESTRICT pOut)
+{
+	cgmModelInt_t kabs=pParam->kabs, kins=pParam->kins, kbasal=pParam->kbasal;
+	cgmModelInt_t noise=pParam->noise, drift=pParam->drift;
+	cgmModelInt_t g, a1, a2, b1, b2, d, r, y, n;
+	cgmModelUInt_t x;
+	unsigned short i;
+
+	for (i=0;i<num;i++)
+	{
+		//Carbohydrate absorption, a2 appearing in the plasma
+		a1=CGM_MODEL_MUL(pGut1[i], kabs);
+		a2=CGM_MODEL_MUL(pGut2[i], kabs);
+		pGut1[i]-=a1;
+		pGut2[i]+=a1-a2;
+		//Insulin absorption, b2 lowering the plasma glucose
+		b1=CGM_MODEL_MUL(pIns1[i], kins);
+		b2=CGM_MODEL_MUL(pIns2[i], kins);
+		pIns1[i]-=b1;
+		pIns2[i]+=b1-b2;
+		//Return towards the basal level
+		g=pGlucose[i];
+		d=g-CGM_MODEL_Q8(pBasal[i]);
+		r=(d>=0) ? CGM_MODEL_MUL(d, kbasal) : -CGM_MODEL_MUL(-d, kbasal);
+		g+=a2-b2-r;
+		g=(g<0) ? 0 : g;
+		g=(g>CGM_MODEL_CAP) ? CGM_MODEL_CAP : g;
+		pGlucose[i]=g;
+		//Sensor drift
+		d=pDrift[i]+drift;
+		d=(d>CGM_MODEL_DRIFT_MAX) ? CGM_MODEL_DRIFT_MAX : d;
+		d=(d<-CGM_MODEL_DRIFT_MAX) ? -CGM_MODEL_DRIFT_MAX : d;
+		pDrift[i]=d;
+		//Sensor noise: the sum of four uniform bytes has a standard deviation of about 148
+		x=pRng[i];
+		x^=x<<13;
+		x^=x>>17;
+		x^=x<<5;
+		pRng[i]=x;
+		n=(cgmModelInt_t)(x&0xFF)+(cgmModelInt_t)((x>>8)&0xFF)+(cgmModelInt_t)((x>>16)&0xFF)+(cgmModelInt_t)(x>>24)-510;
+		y=g+(g*(d>>12)>>12)+((n*noise*443)>>16);
+		y=(y<0) ? 0 : (y+128)>>8;
+		pOut[i]=(unsigned short)((y>0xFFFF) ? 0xFFFF : y);
+	}
+}
+
+/**
+@brief Advance a batch of patients by one minute, and take their sensor readings.
+@details The events of the minute are applied first, then every patient is stepped by the same branch free code.
+@param pBatch - the batch.
+@param [out] pOut - the sensor readings in mg/dL, one per patient.
+@return none*/
+void	cgmModelBatchStep(cgmModelBatch_t *pBatch, unsigned short *pOut)
+{
+	const cgmModelParam_t *pParam=pBatch->pParam;
+	unsigned short minute=(unsigned short)(pBatch->minute%CGM_MODEL_DAY);
+	unsigned short i;
+	unsigned char e;
+	cgmModelInt_t d, r;
+
+	for (e=0;e<pParam->eventNum;e++)
+	{
+		const cgmModelEvent_t *pEvent=pParam->pEvents+e;
+		if (pEvent->minute!=minute)
+			continue;
+		if (pEvent->type==CGM_MODEL_EVENT_MEAL)
+			for (i=0;i<pBatch->num;i++)
+			{
+				d=pBatch->pGut1[i]+(cgmModelInt_t)pEvent->amount*pBatch->pCarbFactor[i];
+				r=CGM_MODEL_CAP-pBatch->pGut2[i];
+				pBatch->pGut1[i]=(d>r) ? r : d;
+			}
+		else
+			for (i=0;i<pBatch->num;i++)
+			{
+				d=pBatch->pIns1[i]+CGM_MODEL_Q8((cgmModelInt_t)pEvent->amount*pBatch->pIsf[i])/10;
+				r=CGM_MODEL_CAP-pBatch->pIns2[i];
+				pBatch->pIns1[i]=(d>r) ? r : d;
+			}
+	}
+
+	cgmModelKernel(pParam, pBatch->num, pBatch->pGlucose, pBatch->pGut1, pBatch->pGut2, pBatch->pIns1, pBatch->pIns2,
+		       pBatch->pDrift, pBatch->pRng, pBatch->pBasal, pOut);
+	pBatch->minute++;
+}
+
+/**
+@brief Put a single patient at its basal state, at the start of the schedule.
+@param pModel - the patient.
+@param pParam - the parameters. They must stay valid while the patient is in use.
+@return none*/
+void	cgmModelInit(cgmModel_t *pModel, const cgmModelParam_t *pParam)
+{
+	pModel->batch.num=1;
+	pModel->batch.pGlucose=&pModel->glucose;
+	pModel->batch.pGut1=&pModel->gut1;
+	pModel->batch.pGut2=&pModel->gut2;
+	pModel->batch.pIns1=&pModel->ins1;
+	pModel->batch.pIns2=&pModel->ins2;
+	pModel->batch.pDrift=&pModel->drift;
+	pModel->batch.pRng=&pModel->rng;
+	pModel->batch.pBasal=&pParam->basal;
+	pModel->batch.pCarbFactor=&pParam->carbFactor;
+	pModel->batch.pIsf=&pParam->isf;
+	cgmModelBatchInit(&pModel->batch, pParam);
+}
+
+/**
+@brief Advance a single patient by one minute.
+@param pModel - the patient.
+@return The sensor reading, in mg/dL.*/
+unsigned short	cgmModelStep(cgmModel_t *pModel)
+{
+	unsigned short value;
+	cgmModelBatchStep(&pModel->batch, &value);
+	return value;
+}
+
+/**
+@brief Retrieve the sensor reading of a patient, as a simulation data source.
+@details The position is the minute. The model only runs forwards, so going back to an earlier minute replays the
+	 patient from the start; the seed makes the replay identical.
+@param pContext - the cgmModel_t of the patient.
+@param [in,out] pPos - the minute to return. It is advanced to the following one.
+@return The glucose value simulation.*/
+static unsigned short cgmModelSourceNext(void *pContext, cgmSimDataPos_t *pPos)
+{
+	cgmModel_t *pModel=(cgmModel_t *)pContext;
+	unsigned short value;
+	if (*pPos<pModel->batch.minute)
+		cgmModelInit(pModel, pModel->batch.pParam);
+	do
+		value=cgmModelStep(pModel);
+	while (pModel->batch.minute<=*pPos);
+	(*pPos)++;
+	return value;
+}
+
+/**
+@brief Set up a simulation data source reading a patient, to be given to cgmSimDataSetSource.
+@param [out] pSource - the source to set up.
+@param pModel - the initialized patient. It must stay valid while the source is in use.
+@return none*/
+void	cgmModelSourceInit(cgmSimDataSource_t *pSource, cgmModel_t *pModel)
+{
+	pSource->pfnNext=cgmModelSourceNext;
+	pSource->pContext=pModel;
+	pSource->interval=CGM_MODEL_INTERVAL;
+}
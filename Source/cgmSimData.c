@@ -14,11 +14,31 @@ copies of the Software, and to permit persons to whom the Software is furnished
 THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 */
 
+#if !defined(__ICC8051__) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200112L	///< Declares mmap and posix_madvise under a strict C99 host build
+#endif
+#include <string.h>
+#if !defined(__ICC8051__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 #include "cgmsimdata.h"
+#include "cgmtrace.h"
 #define CGM_SIM_DATA_RECORD_NUMBER 	145	///< The number of records in the simulation glucose value array
+#define CGM_SIM_DATA_INTERVAL		600	///< The time between two values of the cgmData array, in seconds
+#define CGM_SIM_DATA_CSV_INTERVAL	300	///< The time between two values of a CSV trace file, in seconds, as CSV traces have no header
 #define CGM_SIM_DATA_OFFSET		80	///< An offset added to the retrieved glucose value to obtain the abosolute glucose value. In this way, a glucose value of 320 (2 bytes) can be stored with a 1-byte variable as 320-80=240(1 byte). 
 
-static unsigned char index;			///< A pointer indicaing next glucose value to return
+static cgmSimDataPos_t cgmSimDataIndex;			///< A pointer indicaing next glucose value to return
+
+static unsigned short cgmSimDataTableNext(void *pContext, cgmSimDataPos_t *pPos);
+
+/// The compiled-in table source. It is the fallback whenever no other source is set.
+static const cgmSimDataSource_t cgmSimDataTable={cgmSimDataTableNext, 0, CGM_SIM_DATA_INTERVAL};
+/// The source the glucose values are drawn from.
+static const cgmSimDataSource_t *pCgmSimDataSource=&cgmSimDataTable;
 
 /// A constant array loaded with real glucose values from a person, in the unit of mg/dL. Each measurement was taken at 10 mins interval.
 const unsigned char cgmData[CGM_SIM_DATA_RECORD_NUMBER]={
@@ -30,20 +50,260 @@ const unsigned char cgmData[CGM_SIM_DATA_RECORD_NUMBER]={
 @return none*/
 void	 cgmSimDataReset(void)
 {
-	index=0;
+	cgmSimDataIndex=0;
 }
 
 /**
-@brief Retrieve the next glucose simulation data from the data array cgmData.
+@brief Retrieve the next glucose simulation data from the current source.
 @return The next glucose value simulation. */
 unsigned short cgmGetNextData(void)
 {	
+	return cgmGetNextDataFrom(&cgmSimDataIndex);
+}
+
+/**
+@brief Retrieve the next glucose simulation data from the current source, using a caller owned position.
+@details Each simulated sensor keeps its own position, so that several sensors can walk the data set independently. A position of 0 is the start of the data set.
+@param [in,out] pPos - the position of the next value to return. It is advanced to the following value.
+@return The next glucose value simulation. */
+unsigned short cgmGetNextDataFrom(cgmSimDataPos_t *pPos)
+{
+	return pCgmSimDataSource->pfnNext(pCgmSimDataSource->pContext, pPos);
+}
+
+/**
+@brief Select the source the glucose values are drawn from.
+@details The positions held by the callers belong to the previous source, so they should be rewound to 0.
+@param pSource - the new source, or NULL to go back to the compiled-in table. It must stay valid while in use.
+@return none*/
+void	cgmSimDataSetSource(const cgmSimDataSource_t *pSource)
+{
+	pCgmSimDataSource=(pSource!=0) ? pSource : &cgmSimDataTable;
+	cgmSimDataIndex=0;
+}
+
+/**
+@brief Read the next sample of the trace into the window of an interpolating sensor.
+@param pInterp - the sensor.
+@return none*/
+static void cgmSimInterpShift(cgmSimInterp_t *pInterp)
+{
+	pInterp->window[0]=pInterp->window[1];
+	pInterp->window[1]=pInterp->window[2];
+	pInterp->window[2]=pInterp->window[3];
+	pInterp->window[3]=cgmGetNextDataFrom(&pInterp->pos);
+	pInterp->sample++;
+}
+
+/**
+@brief Retrieve the glucose value of a sensor at a simulated time, interpolated between the samples of the current source.
+@details The samples are spread over time by the interval of the source, so the value follows the trace at its real
+	 pace whatever the measurement interval is. Everything is in fixed point: the position between two samples is
+	 taken in 1/256 of the interval. The time must not go backwards; the samples are read from the source in order,
+	 so each one is read once.
+@param pInterp - the sensor.
+@param elapsed - the simulated time since the start of the trace, in seconds.
+@param mode - CGM_SIM_INTERP_NONE, CGM_SIM_INTERP_LINEAR or CGM_SIM_INTERP_CUBIC. With CGM_SIM_INTERP_NONE,
+	     or a source without an interval, every call takes the next sample regardless of the time.
+@return The glucose value simulation.*/
+unsigned short	cgmSimInterpAt(cgmSimInterp_t *pInterp, unsigned long elapsed, unsigned char mode)
+{
+	unsigned short interval=pCgmSimDataSource->interval;
+	long p0,p1,p2,p3,t,value;
+	if (mode==CGM_SIM_INTERP_NONE || interval==0)
+		return cgmGetNextDataFrom(&pInterp->pos);
+	if (!pInterp->primed)	//The sample before the first one is taken to be the first one
+	{
+		pInterp->window[3]=cgmGetNextDataFrom(&pInterp->pos);
+		cgmSimInterpShift(pInterp);
+		cgmSimInterpShift(pInterp);
+		pInterp->window[0]=pInterp->window[1];
+		pInterp->sample=0;
+		pInterp->primed=1;
+	}
+	while (elapsed/interval>pInterp->sample)
+		cgmSimInterpShift(pInterp);
+	t=(long)(((elapsed%interval)<<8)/interval);
+	p0=pInterp->window[0];
+	p1=pInterp->window[1];
+	p2=pInterp->window[2];
+	p3=pInterp->window[3];
+	if (mode==CGM_SIM_INTERP_LINEAR)
+		value=p1+(p2-p1)*t/256;
+	else	//Catmull-Rom: p1 + t/2*((p2-p0) + t*((2p0-5p1+4p2-p3) + t*(3p1-p0-3p2+p3)))
+	{
+		value=(3*p1-p0-3*p2+p3)*t/256;
+		value=(value+2*p0-5*p1+4*p2-p3)*t/256;
+		value=(value+p2-p0)*t/512;
+		value+=p1;
+	}
+	if (value<0)
+		value=0;
+	else if (value>0xFFFF)
+		value=0xFFFF;
+	return (unsigned short)value;
+}
+
+/**
+@brief Retrieve the next glucose value from the compiled-in data array cgmData.
+@param pContext - unused.
+@param [in,out] pPos - the index of the next value to return. It is advanced to the following value.
+@return The next glucose value simulation. */
+static unsigned short cgmSimDataTableNext(void *pContext, cgmSimDataPos_t *pPos)
+{
 	unsigned short temp;
-	temp=cgmData[index]+CGM_SIM_DATA_OFFSET;
-	index++;
-	index %= CGM_SIM_DATA_RECORD_NUMBER;
+	(void)pContext;
+	if (*pPos>=CGM_SIM_DATA_RECORD_NUMBER)	//A position left over from another source
+		*pPos=0;
+	temp=cgmData[*pPos]+CGM_SIM_DATA_OFFSET;
+	(*pPos)++;
+	(*pPos) %= CGM_SIM_DATA_RECORD_NUMBER;
 	return temp;
 }
 
+#if !defined(__ICC8051__)
+/// \brief A glucose trace file mapped into memory.
+typedef struct {
+	const char	*pData;		///< The mapping of the whole file
+	size_t		size;		///< The size of the file
+} cgmSimDataFile_t;
+
+static cgmSimDataFile_t		cgmSimDataFile;		///< The open trace file, if any
+static cgmSimDataSource_t	cgmSimDataFileSource;	///< The source reading cgmSimDataFile
+static cgmTrace_t		cgmSimDataFileTrace;	///< The decoder of cgmSimDataFile, when it is a binary trace
+
+/**
+@brief Parse the glucose value of one line of a CSV trace.
+@details The value is the last field of the line, in mg/dL, so both a bare list of values and "time,value" rows are
+	 accepted. A decimal value is rounded to the nearest integer. A line whose last field is not a number, such
+	 as a header, has no value.
+@param pLine - the start of the line.
+@param pEnd - the end of the line, excluding the line break.
+@param [out] pValue - the value found.
+@return 1 if the line has a value, 0 otherwise.*/
+static unsigned char cgmSimDataParseLine(const char *pLine, const char *pEnd, unsigned short *pValue)
+{
+	const char *p=pEnd;
+	const char *pPoint=NULL;
+	unsigned long value=0;
+	while (p>pLine && (p[-1]==' ' || p[-1]=='\t' || p[-1]=='\r'))
+		p--;
+	pEnd=p;
+	while (p>pLine && ((p[-1]>='0' && p[-1]<='9') || (p[-1]=='.' && pPoint==NULL)))
+		if (*--p=='.')
+			pPoint=p;
+	if (pPoint==NULL)
+		pPoint=pEnd;
+	if (p==pPoint || (p>pLine && p[-1]!=',' && p[-1]!=';' && p[-1]!=' ' && p[-1]!='\t'))
+		return 0;
+	for (;p<pPoint && value<=0xFFFF;p++)
+		value=value*10+(unsigned long)(*p-'0');
+	if (pPoint+1<pEnd && pPoint[1]>='5')	//Round on the first decimal
+		value++;
+	*pValue=(value>0xFFFF) ? 0xFFFF : (unsigned short)value;
+	return 1;
+}
+
+/**
+@brief Retrieve the next glucose value from a CSV trace file.
+@details The position is the byte offset of the next line to read. Only the pages actually walked over are read in
+	 by the mapping, so the size of the trace does not matter. A trace without any value returns 0.
+@param pContext - the cgmSimDataFile_t of the trace.
+@param [in,out] pPos - the offset of the next line. It is advanced past the line returning the value.
+@return The next glucose value simulation. */
+static unsigned short cgmSimDataFileNext(void *pContext, cgmSimDataPos_t *pPos)
+{
+	const cgmSimDataFile_t *pFile=(const cgmSimDataFile_t *)pContext;
+	const char *pLine, *pEnd;
+	unsigned short value;
+	unsigned char wrapped=0;
+	for (;;)
+	{
+		if (*pPos>=pFile->size)
+		{
+			if (wrapped++)		//A whole pass without a value
+				return 0;
+			*pPos=0;
+		}
+		pLine=pFile->pData+*pPos;
+		pEnd=memchr(pLine, '\n', pFile->size-*pPos);
+		if (pEnd==NULL)
+			pEnd=pFile->pData+pFile->size;
+		*pPos=(cgmSimDataPos_t)(pEnd-pFile->pData)+1;
+		if (cgmSimDataParseLine(pLine, pEnd, &value))
+			return value;
+	}
+}
+
+/**
+@brief Open a glucose trace file and make it the current source.
+@details The file is mapped read only rather than read in, so multi-gigabyte traces cost no memory up front.
+	 A file starting with the binary trace header is read with the trace decoder, and seeks through its seek
+	 table; any other file is read as CSV. A CSV file must have a value in mg/dL on one of its lines. Any
+	 previously open trace is closed first.
+@param pPath - the path of the trace file.
+@return 0 on success, non zero if the file can not be mapped or holds no value. The compiled-in table stays the
+	source then.*/
+unsigned char cgmSimDataOpen(const char *pPath)
+{
+	struct stat st;
+	void *pData;
+	int fd;
+	cgmSimDataClose();
+	if ((fd=open(pPath, O_RDONLY))<0)
+		return 1;
+	if (fstat(fd, &st)!=0 || st.st_size==0)
+	{
+		close(fd);
+		return 1;
+	}
+	pData=mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (pData==MAP_FAILED)
+		return 1;
+	posix_madvise(pData, (size_t)st.st_size, POSIX_MADV_SEQUENTIAL);
+	cgmSimDataFile.pData=(const char *)pData;
+	cgmSimDataFile.size=(size_t)st.st_size;
+	if (cgmTraceOpen(&cgmSimDataFileTrace, (const unsigned char *)pData, cgmSimDataFile.size)==0)
+		cgmTraceSourceInit(&cgmSimDataFileSource, &cgmSimDataFileTrace);
+	else
+	{
+		cgmSimDataPos_t pos=0;
+		const char *pEnd;
+		unsigned short value;
+		for (;;)	//Refuse a trace that would replay as all zeros
+		{
+			if (pos>=cgmSimDataFile.size)
+			{
+				cgmSimDataClose();
+				return 1;
+			}
+			pEnd=memchr(cgmSimDataFile.pData+pos, '\n', cgmSimDataFile.size-pos);
+			if (pEnd==NULL)
+				pEnd=cgmSimDataFile.pData+cgmSimDataFile.size;
+			if (cgmSimDataParseLine(cgmSimDataFile.pData+pos, pEnd, &value))
+				break;
+			pos=(cgmSimDataPos_t)(pEnd-cgmSimDataFile.pData)+1;
+		}
+		cgmSimDataFileSource.pfnNext=cgmSimDataFileNext;
+		cgmSimDataFileSource.pContext=&cgmSimDataFile;
+		cgmSimDataFileSource.interval=CGM_SIM_DATA_CSV_INTERVAL;
+	}
+	cgmSimDataSetSource(&cgmSimDataFileSource);
+	return 0;
+}
 
-	
+/**
+@brief Close the open trace file, if any, and go back to the compiled-in table.
+@return none*/
+void	cgmSimDataClose(void)
+{
+	if (cgmSimDataFile.pData==NULL)
+		return;
+	if (pCgmSimDataSource==&cgmSimDataFileSource)
+		cgmSimDataSetSource(NULL);
+	munmap((void *)cgmSimDataFile.pData, cgmSimDataFile.size);
+	cgmSimDataFile.pData=NULL;
+	cgmSimDataFile.size=0;
+}
+#endif /*!defined(__ICC8051__)*/
@@ -0,0 +1,157 @@
+/*!
+\file		cgmTrace.c
+\brief		This file contains the decoder of the compact binary glucose trace format, described in cgmtrace.h.
+\details	The decoder keeps a cursor in the trace, so reading the samples in order only decodes each varint once.
+		Any other position is reached through the seek table and decoding the start of one block.
+\author		Harry Qiu
+\version        1
+\date		2015-March-20
+\copyright	MIT License (MIT)\n
+ Copyright (c) 2014-2015 Center for Global ehealthinnovation
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions: The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "cgmtrace.h"
+
+#define CGM_TRACE_U16(p)	((unsigned short)((p)[0] | ((unsigned short)(p)[1]<<8)))	///< Read a little endian 16-bit field
+#define CGM_TRACE_U32(p)	((unsigned long)CGM_TRACE_U16(p) | ((unsigned long)CGM_TRACE_U16((p)+2)<<16))	///< Read a little endian 32-bit field
+
+/**
+@brief Read a varint of the trace.
+@param pTrace - the trace.
+@param [in,out] pOffset - the offset of the varint. It is advanced past it.
+@param [out] pValue - the value read.
+@return 0 on success, 1 if the varint runs past the end of the image or does not fit 32 bits.*/
+static unsigned char cgmTraceVarint(const cgmTrace_t *pTrace, unsigned long *pOffset, unsigned long *pValue)
+{
+	unsigned long value=0;
+	unsigned char shift=0;
+	unsigned char byte;
+	do
+	{
+		if (*pOffset>=pTrace->size || shift>28)
+			return 1;
+		byte=pTrace->pImage[(*pOffset)++];
+		value|=(unsigned long)(byte&0x7F)<<shift;
+		shift+=7;
+	} while (byte&0x80);
+	*pValue=value;
+	return 0;
+}
+
+/**
+@brief Open a trace image, checking its header.
+@param [out] pTrace - the trace to set up. Its cursor is put on the first sample.
+@param pImage - the trace image. It must stay valid while the trace is in use.
+@param size - the size of the image.
+@return 0 on success, 1 if the image is not a valid trace.*/
+unsigned char cgmTraceOpen(cgmTrace_t *pTrace, const unsigned char *pImage, unsigned long size)
+{
+	if (size<CGM_TRACE_HEADER_SIZE || pImage[0]!='C' || pImage[1]!='G' || pImage[2]!='M' || pImage[3]!='T'
+		|| pImage[4]!=CGM_TRACE_VERSION || pImage[5]>CGM_TRACE_UNITS_MMOL)
+		return 1;
+	pTrace->pImage=pImage;
+	pTrace->size=size;
+	pTrace->units=pImage[5];
+	pTrace->interval=CGM_TRACE_U16(pImage+6);
+	pTrace->blockSamples=CGM_TRACE_U16(pImage+8);
+	pTrace->samples=CGM_TRACE_U32(pImage+10);
+	pTrace->blocks=CGM_TRACE_U16(pImage+14);
+	if (pTrace->samples==0 || pTrace->blockSamples==0
+		|| (pTrace->samples-1)/pTrace->blockSamples+1!=pTrace->blocks
+		|| CGM_TRACE_HEADER_SIZE+4UL*pTrace->blocks>size)
+		return 1;
+	pTrace->cursorSample=pTrace->samples;	//Force the seek to start from the seek table
+	return cgmTraceSeek(pTrace, 0);
+}
+
+/**
+@brief Move the cursor of a trace to a sample.
+@details The cursor is moved to the start of the block holding the sample through the seek table, then forward
+	 to the sample, unless it is already in that block before the sample.
+@param pTrace - the trace.
+@param sample - the sample to move to.
+@return 0 on success, 1 if the sample is past the end of the trace or the image is corrupted.*/
+unsigned char cgmTraceSeek(cgmTrace_t *pTrace, unsigned long sample)
+{
+	unsigned long block=sample/pTrace->blockSamples;
+	unsigned short value;
+	if (sample>=pTrace->samples)
+		return 1;
+	if (pTrace->cursorSample>sample || pTrace->cursorSample/pTrace->blockSamples!=block)
+	{
+		pTrace->cursorSample=block*pTrace->blockSamples;
+		pTrace->cursorOffset=CGM_TRACE_U32(pTrace->pImage+CGM_TRACE_HEADER_SIZE+4*block);
+		pTrace->cursorValue=0;
+	}
+	while (pTrace->cursorSample<sample)
+		if (cgmTraceNext(pTrace, &value)!=0)
+			return 1;
+	return 0;
+}
+
+/**
+@brief Read the sample at the cursor of a trace, and move the cursor to the following one.
+@param pTrace - the trace.
+@param [out] pValue - the sample, in mg/dL.
+@return 0 on success, 1 at the end of the trace or if the image is corrupted.*/
+unsigned char cgmTraceNext(cgmTrace_t *pTrace, unsigned short *pValue)
+{
+	unsigned long raw;
+	unsigned long value;
+	if (pTrace->cursorSample>=pTrace->samples || cgmTraceVarint(pTrace, &pTrace->cursorOffset, &raw)!=0)
+		return 1;
+	if (pTrace->cursorSample%pTrace->blockSamples==0)	//The first sample of a block is absolute
+		value=raw;
+	else if (raw&1)						//Zig-zag: odd codes are the negative deltas
+		value=pTrace->cursorValue-((raw>>1)+1);
+	else
+		value=pTrace->cursorValue+(raw>>1);
+	if (value>0xFFFF)
+		return 1;
+	pTrace->cursorValue=(unsigned short)value;
+	pTrace->cursorSample++;
+	if (pTrace->units==CGM_TRACE_UNITS_MMOL)		//1 mmol/L of glucose is 18.016 mg/dL
+		value=(value*18016UL+5000)/10000;
+	*pValue=(value>0xFFFF) ? 0xFFFF : (unsigned short)value;
+	return 0;
+}
+
+/**
+@brief Retrieve the next glucose value from a trace, as a simulation data source.
+@details The position is the sample number. Reading in order only moves the cursor forward, so every sample is
+	 decoded once; interleaved sensors make the trace seek. The trace restarts at its end, or where the position
+	 type wraps.
+@param pContext - the cgmTrace_t of the trace.
+@param [in,out] pPos - the sample to return. It is advanced to the following one.
+@return The next glucose value simulation, or 0 if the image is corrupted.*/
+static unsigned short cgmTraceSourceNext(void *pContext, cgmSimDataPos_t *pPos)
+{
+	cgmTrace_t *pTrace=(cgmTrace_t *)pContext;
+	unsigned short value;
+	if (*pPos>=pTrace->samples)
+		*pPos=0;
+	if (cgmTraceSeek(pTrace, *pPos)!=0 || cgmTraceNext(pTrace, &value)!=0)
+		return 0;
+	(*pPos)++;
+	if (*pPos>=pTrace->samples)
+		*pPos=0;
+	return value;
+}
+
+/**
+@brief Set up a simulation data source reading an open trace, to be given to cgmSimDataSetSource.
+@param [out] pSource - the source to set up.
+@param pTrace - the open trace. It must stay valid while the source is in use.
+@return none*/
+void	cgmTraceSourceInit(cgmSimDataSource_t *pSource, cgmTrace_t *pTrace)
+{
+	pSource->pfnNext=cgmTraceSourceNext;
+	pSource->pContext=pTrace;
+	pSource->interval=pTrace->interval;
+}
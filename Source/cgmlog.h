@@ -0,0 +1,44 @@
+/*!
+\file		cgmlog.h
+\brief		This file contains the declarations of the persistent measurement log.
+\details	The flash wear budget: every full chunk costs one SNV write of the chunk and one of the index, about 160
+		bytes with the item headers, and every RACP deletion one write of the index. The deletion after the index holds
+		CGM_LOG_DELETES also writes again each chunk holding a deleted record, at most one per chunk, to drop the deleted
+		records from flash. Deletions are rare next to records, so the budget is that of the chunks. SNV appends the
+		writes to its active 2 KB page and erases a page each time it compacts the live items into the other one. With
+		the 8 chunks of the log, the index and a few bonds live, about 900 bytes are free after a compaction, so a page
+		is erased every 5 or 6 chunks, or about 65 records of 10 bytes. The CC254x flash endures 20000 erase cycles per page, and
+		the two pages take turns, so the log is good for roughly 2.6 million records. That is about 5 years at one
+		record per minute, but only a month at the one second period of the simulation, which is why
+		FEATURE_GLUCOSE_PERSISTENT_LOG is off by default.
+\author		Harry Qiu
+\version        1
+\date		2015-March-20
+\copyright	MIT License (MIT)\n
+ Copyright (c) 2014-2015 Center for Global ehealthinnovation
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions: The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef __CGM_LOG__
+#define __CGM_LOG__
+
+#define CGM_LOG_NVID_INDEX	0x80	///< The SNV item holding the log index. It is the first customer item (BLE_NVID_CUST_START)
+#define CGM_LOG_NVID_CHUNK	0x81	///< The SNV item holding the first log chunk. The chunks take the following CGM_LOG_CHUNKS items
+#define CGM_LOG_CHUNKS		8	///< The largest number of chunks the log rotates through. Fewer are used when they are enough for the history
+#define CGM_LOG_CHUNK_BYTES	120	///< The size of a chunk. It is also the size of the RAM batch buffer
+#define CGM_LOG_DELETES		4	///< The number of deletions the index holds. The log is compacted when one more is made
+
+/// \brief The function called for every record when the log is loaded.
+typedef void (*cgmLogRecordCB_t)(void *pRecord, void *pContext);
+
+ unsigned char	cgmLogInit(unsigned char recordSize, unsigned char keyPos, unsigned short history);
+ unsigned short	cgmLogLoad(cgmLogRecordCB_t pfnRecord, void *pContext);
+ void		cgmLogAppend(void *pRecord);
+ void		cgmLogReset(void);
+ void		cgmLogDelete(unsigned short from, unsigned short to);
+#endif
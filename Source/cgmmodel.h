@@ -0,0 +1,94 @@
+/*!
+\file		cgmmodel.h
+\brief		This file contains the declarations of the physiological glucose model, a synthetic source of simulation data.
+\author		Harry Qiu
+\version        1
+\date		2015-March-20
+\copyright	MIT License (MIT)\n
+ Copyright (c) 2014-2015 Center for Global ehealthinnovation
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions: The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef __CGM_MODEL__
+#define __CGM_MODEL__
+
+#include "cgmsimdata.h"
+
+#if defined(__ICC8051__)
+typedef long cgmModelInt_t;			///< The 32-bit integer of the model arithmetic
+typedef unsigned long cgmModelUInt_t;		///< The 32-bit unsigned integer of the model arithmetic
+#else
+#include <stdint.h>
+typedef int32_t cgmModelInt_t;			///< The 32-bit integer of the model arithmetic, also on hosts with a 64-bit long, so that it vectorizes at full width
+typedef uint32_t cgmModelUInt_t;		///< The 32-bit unsigned integer of the model arithmetic
+#endif
+
+#define CGM_MODEL_INTERVAL	60	///< The time step of the model, in seconds
+#define CGM_MODEL_DAY		1440	///< The number of steps in a day. The event schedule repeats every day
+
+#define CGM_MODEL_EVENT_MEAL	0	///< A meal. The amount is in grams of carbohydrate
+#define CGM_MODEL_EVENT_BOLUS	1	///< An insulin bolus. The amount is in tenths of a unit
+
+/// \brief A scheduled event of the model.
+typedef struct {
+	unsigned short	minute;		///< The minute of the day the event happens at, below CGM_MODEL_DAY
+	unsigned char	type;		///< CGM_MODEL_EVENT_MEAL or CGM_MODEL_EVENT_BOLUS
+	unsigned char	amount;		///< The size of the event, in the units of its type
+} cgmModelEvent_t;
+
+/// \brief The parameters of the model. The rates are fractions per minute in Q12, 4096 being 1.
+typedef struct {
+	unsigned short		basal;		///< The glucose level the patient returns to without meals or insulin, in mg/dL
+	unsigned short		carbFactor;	///< The glucose rise per gram of carbohydrate, in mg/dL, Q8
+	unsigned short		isf;		///< The glucose drop per unit of insulin, in mg/dL
+	unsigned short		kabs;		///< The carbohydrate absorption rate through each of the two gut compartments, Q12
+	unsigned short		kins;		///< The insulin absorption rate through each of the two subcutaneous compartments, Q12
+	unsigned short		kbasal;		///< The rate the glucose returns to the basal level, Q12
+	unsigned short		noise;		///< The standard deviation of the sensor noise, in mg/dL, Q8. At most 20 mg/dL
+	short			drift;		///< The change of the sensor sensitivity per minute, Q24. 116 is about 1% a day
+	const cgmModelEvent_t	*pEvents;	///< The daily schedule of meals and boluses
+	unsigned char		eventNum;	///< The number of events in pEvents
+	unsigned long		seed;		///< The seed of the noise generator. It must not be 0
+} cgmModelParam_t;
+
+/// \brief The states of a batch of virtual patients, kept as one array per variable so that stepping them vectorizes.
+/// \details The glucose and compartment contents are in mg/dL, Q8; the insulin compartments hold the glucose drop still
+///	     to come. The arrays are owned by the caller and hold num entries each. pBasal, pCarbFactor and pIsf give each
+///	     patient its own basal level, carbohydrate factor and insulin sensitivity, in the units of cgmModelParam_t;
+///	     the other parameters are shared by the batch.
+typedef struct {
+	const cgmModelParam_t	*pParam;	///< The shared parameters and schedule
+	unsigned short		num;		///< The number of patients
+	unsigned long		minute;		///< The number of steps taken
+	cgmModelInt_t		*pGlucose;	///< The plasma glucose
+	cgmModelInt_t		*pGut1;		///< The carbohydrate in the first gut compartment
+	cgmModelInt_t		*pGut2;		///< The carbohydrate in the second gut compartment
+	cgmModelInt_t		*pIns1;		///< The insulin in the first subcutaneous compartment
+	cgmModelInt_t		*pIns2;		///< The insulin in the second subcutaneous compartment
+	cgmModelInt_t		*pDrift;	///< The sensor sensitivity error, Q24
+	cgmModelUInt_t		*pRng;		///< The noise generator states
+	const unsigned short	*pBasal;	///< The basal glucose of each patient
+	const unsigned short	*pCarbFactor;	///< The carbohydrate factor of each patient
+	const unsigned short	*pIsf;		///< The insulin sensitivity of each patient
+} cgmModelBatch_t;
+
+/// \brief A single virtual patient, as used for a simulated sensor.
+typedef struct {
+	cgmModelBatch_t	batch;		///< A batch of one, pointing at the fields below
+	cgmModelInt_t	glucose, gut1, gut2, ins1, ins2, drift;	///< The state of the patient
+	cgmModelUInt_t	rng;		///< The noise generator state
+} cgmModel_t;
+
+extern const cgmModelParam_t cgmModelDefault;
+
+ void		cgmModelBatchInit(cgmModelBatch_t *pBatch, const cgmModelParam_t *pParam);
+ void		cgmModelBatchStep(cgmModelBatch_t *pBatch, unsigned short *pOut);
+ void		cgmModelInit(cgmModel_t *pModel, const cgmModelParam_t *pParam);
+ unsigned short	cgmModelStep(cgmModel_t *pModel);
+ void		cgmModelSourceInit(cgmSimDataSource_t *pSource, cgmModel_t *pModel);
+#endif
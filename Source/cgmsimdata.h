@@ -17,6 +17,43 @@ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLI
 #ifndef __CGM_SIM_DATA__
 #define __CGM_SIM_DATA__
 
+#if defined(__ICC8051__)
+typedef unsigned short cgmSimDataPos_t;	///< A position in a glucose trace, wide enough for the traces embedded in flash
+#else
+#include <stddef.h>
+typedef size_t cgmSimDataPos_t;		///< A position in a glucose trace. A file source uses byte offsets, so it spans the whole file
+#endif
+
+/// \brief A source of glucose values the simulated sensors draw from.
+/// \details pfnNext returns the value at the given position and advances the position to the following value,
+///	     wrapping to the start of the trace at its end. A position of 0 is the start of the trace.
+typedef struct {
+	unsigned short	(*pfnNext)(void *pContext, cgmSimDataPos_t *pPos);	///< Return the value at the position, and advance it
+	void		*pContext;						///< Passed to pfnNext unchanged
+	unsigned short	interval;						///< The time between two values of the trace, in seconds
+} cgmSimDataSource_t;
+
+#define CGM_SIM_INTERP_NONE	0	///< Every measurement takes the next value of the trace, whatever the elapsed time
+#define CGM_SIM_INTERP_LINEAR	1	///< Values are interpolated linearly between the two surrounding samples
+#define CGM_SIM_INTERP_CUBIC	2	///< Values are interpolated with a Catmull-Rom spline through the four surrounding samples
+
+/// \brief The state of a sensor walking a trace in simulated time.
+/// \details window holds the samples k-1 to k+2 of the trace, where k is the last sample at or before the current
+///	     time. A zeroed structure is a sensor at the start of the trace.
+typedef struct {
+	cgmSimDataPos_t	pos;		///< The position of sample k+3, the next one to read from the source
+	unsigned long	sample;		///< The sample number k
+	unsigned short	window[4];	///< The samples k-1, k, k+1 and k+2
+	unsigned char	primed;		///< Non zero once the window is loaded
+} cgmSimInterp_t;
+
  unsigned short cgmGetNextData(void);
+ unsigned short cgmGetNextDataFrom(cgmSimDataPos_t *pPos);
  void	cgmSimDataReset(void);
+ void	cgmSimDataSetSource(const cgmSimDataSource_t *pSource);
+ unsigned short	cgmSimInterpAt(cgmSimInterp_t *pInterp, unsigned long elapsed, unsigned char mode);
+#if !defined(__ICC8051__)
+ unsigned char	cgmSimDataOpen(const char *pPath);
+ void	cgmSimDataClose(void);
+#endif
 #endif
@@ -0,0 +1,55 @@
+/*!
+\file		cgmtrace.h
+\brief		This file contains the declarations of the compact binary glucose trace format and its decoder.
+\details	A trace image is laid out as follows, all multi-byte fields little endian:
+		- a 16-byte header: the magic "CGMT", the version (1), the units (CGM_TRACE_UNITS_*), the sampling
+		  interval in seconds (2 bytes), the number of samples per block (2 bytes), the number of samples
+		  (4 bytes) and the number of blocks (2 bytes);
+		- the seek table: the offset of each block from the start of the image (4 bytes per block);
+		- the blocks. A block starts with the absolute value of its first sample, and every following sample is
+		  the difference from the previous one, zig-zag encoded. All of them are written as varints, 7 bits per byte,
+		  least significant group first, with the top bit set on every byte but the last.
+		A steady glucose trace thus takes about one byte per sample, with no limit on the range of the values, and
+		any sample is reached by decoding at most one block.
+\author		Harry Qiu
+\version        1
+\date		2015-March-20
+\copyright	MIT License (MIT)\n
+ Copyright (c) 2014-2015 Center for Global ehealthinnovation
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions: The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef __CGM_TRACE__
+#define __CGM_TRACE__
+
+#include "cgmsimdata.h"
+
+#define CGM_TRACE_HEADER_SIZE	16	///< The size of the trace header
+#define CGM_TRACE_VERSION	1	///< The format version this decoder reads
+#define CGM_TRACE_UNITS_MGDL	0	///< The samples are in mg/dL
+#define CGM_TRACE_UNITS_MMOL	1	///< The samples are in tenths of mmol/L. The decoder returns them in mg/dL
+
+/// \brief A trace being decoded.
+typedef struct {
+	const unsigned char	*pImage;	///< The trace image
+	unsigned long		size;		///< The size of the image
+	unsigned char		units;		///< The units of the samples, CGM_TRACE_UNITS_*
+	unsigned short		interval;	///< The sampling interval in seconds
+	unsigned short		blockSamples;	///< The number of samples per block
+	unsigned long		samples;	///< The number of samples
+	unsigned short		blocks;		///< The number of blocks
+	unsigned long		cursorSample;	///< The sample the cursor is on
+	unsigned long		cursorOffset;	///< The offset of the varint of the cursor sample
+	unsigned short		cursorValue;	///< The value of the sample before the cursor, the base of its delta
+} cgmTrace_t;
+
+ unsigned char	cgmTraceOpen(cgmTrace_t *pTrace, const unsigned char *pImage, unsigned long size);
+ unsigned char	cgmTraceSeek(cgmTrace_t *pTrace, unsigned long sample);
+ unsigned char	cgmTraceNext(cgmTrace_t *pTrace, unsigned short *pValue);
+ void		cgmTraceSourceInit(cgmSimDataSource_t *pSource, cgmTrace_t *pTrace);
+#endif
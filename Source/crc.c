@@ -19,56 +19,136 @@ copies of the Software, and to permit persons to whom the Software is furnished
 /// @brief This group of constants, macros, variables and functions implement the CRC support.
 /// @{
 
+#define CRC16_POLY	0x8408u		///< The CRC-CCITT polynomial x^16+x^12+x^5+1, in the reflected (LSB first) form
+
+/// @brief Shift one zero bit through the CRC register.
+#define CRC16_STEP(c)	(((c)>>1)^(((c)&1u)?CRC16_POLY:0u))
+
+/// @name Lookup table generation
+/// @brief The tables are generated by the compiler rather than pasted in.
+/// @details The CRC is linear, so the table entry of any byte is the XOR of the entries of its set bits.
+///          CRC16_Tk_Bi is the entry for the byte (1<<i) in the table of slice k, i.e. the CRC register after
+///          that byte followed by k zero bytes. The entry of a single bit i in slice 0 is the polynomial
+///          shifted through the remaining 7-i bit positions.
+/// @{
+#define CRC16_T0_B7	CRC16_POLY
+#define CRC16_T0_B6	CRC16_STEP(CRC16_T0_B7)
+#define CRC16_T0_B5	CRC16_STEP(CRC16_T0_B6)
+#define CRC16_T0_B4	CRC16_STEP(CRC16_T0_B5)
+#define CRC16_T0_B3	CRC16_STEP(CRC16_T0_B4)
+#define CRC16_T0_B2	CRC16_STEP(CRC16_T0_B3)
+#define CRC16_T0_B1	CRC16_STEP(CRC16_T0_B2)
+#define CRC16_T0_B0	CRC16_STEP(CRC16_T0_B1)
+
+/// @brief The table entry of byte b for slice k.
+#define CRC16_ENTRY(k,b)	( (((b)&0x01u)?CRC16_T##k##_B0:0u) ^ (((b)&0x02u)?CRC16_T##k##_B1:0u) \
+				^ (((b)&0x04u)?CRC16_T##k##_B2:0u) ^ (((b)&0x08u)?CRC16_T##k##_B3:0u) \
+				^ (((b)&0x10u)?CRC16_T##k##_B4:0u) ^ (((b)&0x20u)?CRC16_T##k##_B5:0u) \
+				^ (((b)&0x40u)?CRC16_T##k##_B6:0u) ^ (((b)&0x80u)?CRC16_T##k##_B7:0u) )
+#define CRC16_R4(k,b)		CRC16_ENTRY(k,b), CRC16_ENTRY(k,(b)+1), CRC16_ENTRY(k,(b)+2), CRC16_ENTRY(k,(b)+3)
+#define CRC16_R16(k,b)		CRC16_R4(k,b), CRC16_R4(k,(b)+4), CRC16_R4(k,(b)+8), CRC16_R4(k,(b)+12)
+#define CRC16_R64(k,b)		CRC16_R16(k,b), CRC16_R16(k,(b)+16), CRC16_R16(k,(b)+32), CRC16_R16(k,(b)+48)
+#define CRC16_TABLE(k)		{ CRC16_R64(k,0), CRC16_R64(k,64), CRC16_R64(k,128), CRC16_R64(k,192) }
+
+#if (CRC16_SLICE>1)
+/// @brief Append one zero byte to a slice entry, which gives the matching entry of the next slice.
+#define CRC16_NEXT(c)	(((c)>>8)^CRC16_ENTRY(0,(c)&0xFFu))
+
+/// @brief Basis entries of the higher slices.
+/// @note They are enumeration constants so that each slice is built on the previous one without the
+///       expressions growing. This requires an int of at least 32 bits, which all targets using
+///       CRC16_SLICE>1 have.
+enum {
+	CRC16_T1_B0=CRC16_NEXT(CRC16_T0_B0), CRC16_T1_B1=CRC16_NEXT(CRC16_T0_B1), CRC16_T1_B2=CRC16_NEXT(CRC16_T0_B2), CRC16_T1_B3=CRC16_NEXT(CRC16_T0_B3),
+	CRC16_T1_B4=CRC16_NEXT(CRC16_T0_B4), CRC16_T1_B5=CRC16_NEXT(CRC16_T0_B5), CRC16_T1_B6=CRC16_NEXT(CRC16_T0_B6), CRC16_T1_B7=CRC16_NEXT(CRC16_T0_B7),
+	CRC16_T2_B0=CRC16_NEXT(CRC16_T1_B0), CRC16_T2_B1=CRC16_NEXT(CRC16_T1_B1), CRC16_T2_B2=CRC16_NEXT(CRC16_T1_B2), CRC16_T2_B3=CRC16_NEXT(CRC16_T1_B3),
+	CRC16_T2_B4=CRC16_NEXT(CRC16_T1_B4), CRC16_T2_B5=CRC16_NEXT(CRC16_T1_B5), CRC16_T2_B6=CRC16_NEXT(CRC16_T1_B6), CRC16_T2_B7=CRC16_NEXT(CRC16_T1_B7),
+	CRC16_T3_B0=CRC16_NEXT(CRC16_T2_B0), CRC16_T3_B1=CRC16_NEXT(CRC16_T2_B1), CRC16_T3_B2=CRC16_NEXT(CRC16_T2_B2), CRC16_T3_B3=CRC16_NEXT(CRC16_T2_B3),
+	CRC16_T3_B4=CRC16_NEXT(CRC16_T2_B4), CRC16_T3_B5=CRC16_NEXT(CRC16_T2_B5), CRC16_T3_B6=CRC16_NEXT(CRC16_T2_B6), CRC16_T3_B7=CRC16_NEXT(CRC16_T2_B7),
+#if (CRC16_SLICE>4)
+	CRC16_T4_B0=CRC16_NEXT(CRC16_T3_B0), CRC16_T4_B1=CRC16_NEXT(CRC16_T3_B1), CRC16_T4_B2=CRC16_NEXT(CRC16_T3_B2), CRC16_T4_B3=CRC16_NEXT(CRC16_T3_B3),
+	CRC16_T4_B4=CRC16_NEXT(CRC16_T3_B4), CRC16_T4_B5=CRC16_NEXT(CRC16_T3_B5), CRC16_T4_B6=CRC16_NEXT(CRC16_T3_B6), CRC16_T4_B7=CRC16_NEXT(CRC16_T3_B7),
+	CRC16_T5_B0=CRC16_NEXT(CRC16_T4_B0), CRC16_T5_B1=CRC16_NEXT(CRC16_T4_B1), CRC16_T5_B2=CRC16_NEXT(CRC16_T4_B2), CRC16_T5_B3=CRC16_NEXT(CRC16_T4_B3),
+	CRC16_T5_B4=CRC16_NEXT(CRC16_T4_B4), CRC16_T5_B5=CRC16_NEXT(CRC16_T4_B5), CRC16_T5_B6=CRC16_NEXT(CRC16_T4_B6), CRC16_T5_B7=CRC16_NEXT(CRC16_T4_B7),
+	CRC16_T6_B0=CRC16_NEXT(CRC16_T5_B0), CRC16_T6_B1=CRC16_NEXT(CRC16_T5_B1), CRC16_T6_B2=CRC16_NEXT(CRC16_T5_B2), CRC16_T6_B3=CRC16_NEXT(CRC16_T5_B3),
+	CRC16_T6_B4=CRC16_NEXT(CRC16_T5_B4), CRC16_T6_B5=CRC16_NEXT(CRC16_T5_B5), CRC16_T6_B6=CRC16_NEXT(CRC16_T5_B6), CRC16_T6_B7=CRC16_NEXT(CRC16_T5_B7),
+	CRC16_T7_B0=CRC16_NEXT(CRC16_T6_B0), CRC16_T7_B1=CRC16_NEXT(CRC16_T6_B1), CRC16_T7_B2=CRC16_NEXT(CRC16_T6_B2), CRC16_T7_B3=CRC16_NEXT(CRC16_T6_B3),
+	CRC16_T7_B4=CRC16_NEXT(CRC16_T6_B4), CRC16_T7_B5=CRC16_NEXT(CRC16_T6_B5), CRC16_T7_B6=CRC16_NEXT(CRC16_T6_B6), CRC16_T7_B7=CRC16_NEXT(CRC16_T6_B7),
+#endif
+};
+#endif
+/// @}
+
+unsigned short CRC16_Lookup[CRC16_SLICE][256]={
+	CRC16_TABLE(0),
+#if (CRC16_SLICE>1)
+	CRC16_TABLE(1), CRC16_TABLE(2), CRC16_TABLE(3),
+#endif
+#if (CRC16_SLICE>4)
+	CRC16_TABLE(4), CRC16_TABLE(5), CRC16_TABLE(6), CRC16_TABLE(7),
+#endif
+};
+
 /**
-  @brief CRC-CCITT calculation using the tabular form.
+  @brief Feed a block of bytes into a running CRC-CCITT.
+  @details With CRC16_SLICE larger than 1 the message is consumed CRC16_SLICE bytes per step, and the 
+  	   remaining bytes one at a time.
+  @param [in] crc16 - the running CRC, CCITT_CRC16_INIT for a new message.
   @param [in] message - the pointer to the message array.
   @param [in] length - the length of the message.
-  @return the 16-bit CRC value.*/
-unsigned short  ccitt_crc16 (unsigned char * message,short length){
-static unsigned short CRC16_Lookup[]={
- 	0x0000, 0x1189, 0x2312, 0x329b, 0x4624, 0x57ad, 0x6536, 0x74bf,
-	0x8c48, 0x9dc1, 0xaf5a, 0xbed3, 0xca6c, 0xdbe5, 0xe97e, 0xf8f7,
-	0x1081, 0x0108, 0x3393, 0x221a, 0x56a5, 0x472c, 0x75b7, 0x643e,
-	0x9cc9, 0x8d40, 0xbfdb, 0xae52, 0xdaed, 0xcb64, 0xf9ff, 0xe876,
-	0x2102, 0x308b, 0x0210, 0x1399, 0x6726, 0x76af, 0x4434, 0x55bd,
-	0xad4a, 0xbcc3, 0x8e58, 0x9fd1, 0xeb6e, 0xfae7, 0xc87c, 0xd9f5,
-	0x3183, 0x200a, 0x1291, 0x0318, 0x77a7, 0x662e, 0x54b5, 0x453c,
-	0xbdcb, 0xac42, 0x9ed9, 0x8f50, 0xfbef, 0xea66, 0xd8fd, 0xc974,
-	0x4204, 0x538d, 0x6116, 0x709f, 0x0420, 0x15a9, 0x2732, 0x36bb,
-	0xce4c, 0xdfc5, 0xed5e, 0xfcd7, 0x8868, 0x99e1, 0xab7a, 0xbaf3,
-	0x5285, 0x430c, 0x7197, 0x601e, 0x14a1, 0x0528, 0x37b3, 0x263a,
-	0xdecd, 0xcf44, 0xfddf, 0xec56, 0x98e9, 0x8960, 0xbbfb, 0xaa72,
-	0x6306, 0x728f, 0x4014, 0x519d, 0x2522, 0x34ab, 0x0630, 0x17b9,
-	0xef4e, 0xfec7, 0xcc5c, 0xddd5, 0xa96a, 0xb8e3, 0x8a78, 0x9bf1,
-	0x7387, 0x620e, 0x5095, 0x411c, 0x35a3, 0x242a, 0x16b1, 0x0738,
-	0xffcf, 0xee46, 0xdcdd, 0xcd54, 0xb9eb, 0xa862, 0x9af9, 0x8b70,
-	0x8408, 0x9581, 0xa71a, 0xb693, 0xc22c, 0xd3a5, 0xe13e, 0xf0b7,
-	0x0840, 0x19c9, 0x2b52, 0x3adb, 0x4e64, 0x5fed, 0x6d76, 0x7cff,
-	0x9489, 0x8500, 0xb79b, 0xa612, 0xd2ad, 0xc324, 0xf1bf, 0xe036,
-	0x18c1, 0x0948, 0x3bd3, 0x2a5a, 0x5ee5, 0x4f6c, 0x7df7, 0x6c7e,
-	0xa50a, 0xb483, 0x8618, 0x9791, 0xe32e, 0xf2a7, 0xc03c, 0xd1b5,
-	0x2942, 0x38cb, 0x0a50, 0x1bd9, 0x6f66, 0x7eef, 0x4c74, 0x5dfd,
-	0xb58b, 0xa402, 0x9699, 0x8710, 0xf3af, 0xe226, 0xd0bd, 0xc134,
-	0x39c3, 0x284a, 0x1ad1, 0x0b58, 0x7fe7, 0x6e6e, 0x5cf5, 0x4d7c,
-	0xc60c, 0xd785, 0xe51e, 0xf497, 0x8028, 0x91a1, 0xa33a, 0xb2b3,
-	0x4a44, 0x5bcd, 0x6956, 0x78df, 0x0c60, 0x1de9, 0x2f72, 0x3efb,
-	0xd68d, 0xc704, 0xf59f, 0xe416, 0x90a9, 0x8120, 0xb3bb, 0xa232,
-	0x5ac5, 0x4b4c, 0x79d7, 0x685e, 0x1ce1, 0x0d68, 0x3ff3, 0x2e7a,
-	0xe70e, 0xf687, 0xc41c, 0xd595, 0xa12a, 0xb0a3, 0x8238, 0x93b1,
-	0x6b46, 0x7acf, 0x4854, 0x59dd, 0x2d62, 0x3ceb, 0x0e70, 0x1ff9,
-	0xf78f, 0xe606, 0xd49d, 0xc514, 0xb1ab, 0xa022, 0x92b9, 0x8330,
-	0x7bc7, 0x6a4e, 0x58d5, 0x495c, 0x3de3, 0x2c6a, 0x1ef1, 0x0f78};
+  @return the updated running CRC.*/
+unsigned short  ccitt_crc16_update (unsigned short crc16, unsigned char * message, short length){
+int i;
+#if (CRC16_SLICE>1)
+while (length>=CRC16_SLICE)
+{
+  crc16 ^= message[0] | (message[1]<<8);
+#if (CRC16_SLICE==8)
+  crc16 = CRC16_Lookup[7][crc16 & 0xFF] ^ CRC16_Lookup[6][crc16 >> 8]
+	^ CRC16_Lookup[5][message[2]] ^ CRC16_Lookup[4][message[3]]
+	^ CRC16_Lookup[3][message[4]] ^ CRC16_Lookup[2][message[5]]
+	^ CRC16_Lookup[1][message[6]] ^ CRC16_Lookup[0][message[7]];
+#else
+  crc16 = CRC16_Lookup[3][crc16 & 0xFF] ^ CRC16_Lookup[2][crc16 >> 8]
+	^ CRC16_Lookup[1][message[2]] ^ CRC16_Lookup[0][message[3]];
+#endif
+  message += CRC16_SLICE;
+  length -= CRC16_SLICE;
+}
+#endif
+for (i=0;i<length;i++)
+{ 
+  CCITT_CRC16_BYTE(crc16,message[i]);
+}
+return crc16;
+}
 
-unsigned short crc16=0xFFFF;
+/**
+  @brief Copy a block of bytes and feed it into a running CRC-CCITT in the same pass.
+  @param [in] crc16 - the running CRC, CCITT_CRC16_INIT for a new message.
+  @param [out] dst - the destination of the copy.
+  @param [in] src - the bytes to be copied.
+  @param [in] length - the number of bytes.
+  @return the updated running CRC.*/
+unsigned short  ccitt_crc16_copy (unsigned short crc16, unsigned char * dst, unsigned char * src, short length){
 int i;
 for (i=0;i<length;i++)
 { 
-  crc16=((crc16>>8)&0xFF)^CRC16_Lookup[(crc16 ^ message[i]) & 0xFF];
+  dst[i]=src[i];
+  CCITT_CRC16_BYTE(crc16,src[i]);
 }
-crc16 &= 0xffff;
 return crc16;
 }
 
+/**
+  @brief CRC-CCITT calculation using the tabular form.
+  @param [in] message - the pointer to the message array.
+  @param [in] length - the length of the message.
+  @return the 16-bit CRC value.*/
+unsigned short  ccitt_crc16 (unsigned char * message,short length){
+return ccitt_crc16_final(ccitt_crc16_update(CCITT_CRC16_INIT,message,length));
+}
+
 /**
  * @brief Test the input message against its attached CRC16 code.
  * @note Here we assume that the CRC is attached as the last two bytes of the message.
@@ -15,7 +15,53 @@ copies of the Software, and to permit persons to whom the Software is furnished
 #ifndef _CRC16_
 #define _CRC16_
 
+/// @ingroup crc16grp
+/// @brief The number of bytes consumed per step by ccitt_crc16, one lookup table is generated for each of them.
+/// @details Supported values are 1, 4 and 8. The 8051 keeps the single 256-entry table, since RAM is scarce and
+///          a wider step does not pay off on an 8-bit core. Other targets (host tools, bulk verification) use 8.
+///          It can be overridden from the compiler command line.
+#ifndef CRC16_SLICE
+#if defined(__ICC8051__)
+#define CRC16_SLICE	1
+#else
+#define CRC16_SLICE	8
+#endif
+#endif
+
+#if (CRC16_SLICE!=1) && (CRC16_SLICE!=4) && (CRC16_SLICE!=8)
+#error "CRC16_SLICE must be 1, 4 or 8"
+#endif
+
+#define CCITT_CRC16_INIT	0xFFFF		///< The initial value of a running CRC-CCITT @ingroup crc16grp
+
+/// @ingroup crc16grp
+/// @brief The CRC lookup tables. CRC16_Lookup[k][b] is the CRC register after the byte b followed by k zero bytes.
+extern unsigned short CRC16_Lookup[CRC16_SLICE][256];
+
+/// @ingroup crc16grp
+/// @brief Feed one byte into the running CRC crc16. It is meant for serializers which produce a PDU byte by byte.
+#define CCITT_CRC16_BYTE(crc16,byte)	((crc16)=(((crc16)>>8)&0xFF)^CRC16_Lookup[0][((crc16)^(byte))&0xFF])
 
+/*
+  @brief Feed a block of bytes into a running CRC-CCITT.
+  @param [in] crc16 - the running CRC, CCITT_CRC16_INIT for a new message.
+  @param [in] message - the pointer to the message array.
+  @param [in] length - the length of the message.
+  @return the updated running CRC.*/
+unsigned short  ccitt_crc16_update (unsigned short crc16, unsigned char * message, short length);
+/*
+  @brief Copy a block of bytes and feed it into a running CRC-CCITT in the same pass.
+  @param [in] crc16 - the running CRC, CCITT_CRC16_INIT for a new message.
+  @param [out] dst - the destination of the copy.
+  @param [in] src - the bytes to be copied.
+  @param [in] length - the number of bytes.
+  @return the updated running CRC.*/
+unsigned short  ccitt_crc16_copy (unsigned short crc16, unsigned char * dst, unsigned char * src, short length);
+/*
+  @brief Finish a running CRC-CCITT.
+  @param [in] crc16 - the running CRC.
+  @return the 16-bit CRC value.*/
+#define ccitt_crc16_final(crc16)	((unsigned short)((crc16)&0xFFFF))
 /*
   @brief CRC-CITT calculation using the tabular form.
   @param [in] message - the pointer to the message array.
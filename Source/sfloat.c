@@ -0,0 +1,328 @@
+/*!
+\file		sfloat.c
+\brief		This file contains the SFLOAT arithmetic, the 16-bit IEEE 11073 float of the glucose fields.
+\details	A collector may send a value with any exponent, 120 as 0x0078 as well as 0xF4B0 (1200*10^-1), so the values
+		are never compared or combined through their raw bits. Every operation brings the mantissas to a common
+		exponent with a power of ten table, and only uses integer arithmetic, which the 8051 does in software anyway.
+		The number of steps of each operation is bounded by the table size, whatever the input.
+\author		Harry Qiu
+\version        1
+\date		2015-March-20
+\copyright	MIT License (MIT)\n
+ Copyright (c) 2014-2015 Center for Global ehealthinnovation
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions: The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "sfloat.h"
+
+#define SFLOAT_POW10_NUM	10	///< The number of powers of ten in the table, 10^9 being the largest that fits 32 bits
+#define SFLOAT_LIMIT_NUM	7	///< The number of limits in the table. Any 32-bit value fits the mantissa with 7 decades taken off
+#define SFLOAT_ALIGN_MAX	5	///< The largest exponent difference sfloatAdd aligns exactly. The sum of two mantissas scaled by 10^5 fits 32 bits
+
+/// \brief The powers of ten, from 10^0.
+static const sfloatInt_t sfloatPow10[SFLOAT_POW10_NUM]={1L, 10L, 100L, 1000L, 10000L, 100000L, 1000000L, 10000000L, 100000000L, 1000000000L};
+
+/// \brief The largest magnitude that rounds to a mantissa within SFLOAT_MANTISSA_MAX with k decades taken off, from k=0.
+///	   It applies to the exponent 0 only.
+static const sfloatInt_t sfloatLimit[SFLOAT_LIMIT_NUM]={2045L, 20454L, 204549L, 2045499L, 20454999L, 204549999L, 2045499999L};
+
+/// \brief The largest value that rounds to a mantissa within SFLOAT_MANTISSA_MAX_EXP with k decades taken off, from k=0.
+///	   It applies to the exponents other than 0, where the negative values may go one decade step further, down to
+///	   SFLOAT_MANTISSA_MIN_EXP.
+static const sfloatInt_t sfloatLimitExp[SFLOAT_LIMIT_NUM]={2047L, 20474L, 204749L, 2047499L, 20474999L, 204749999L, 2047499999L};
+
+/**
+@brief Tell whether a SFLOAT is one of the not a number values.
+@param value - the SFLOAT.
+@return 1 for SFLOAT_NAN, SFLOAT_NRES or SFLOAT_RESERVED, 0 otherwise.*/
+static unsigned char sfloatIsNaN(SFLOAT value)
+{
+	return (value==SFLOAT_NAN || value==SFLOAT_NRES || value==SFLOAT_RESERVED) ? 1 : 0;
+}
+
+/**
+@brief Tell whether a SFLOAT is an infinity.
+@param value - the SFLOAT.
+@return 1 for the positive infinity, -1 for the negative infinity, 0 otherwise.*/
+static signed char sfloatInfinity(SFLOAT value)
+{
+	if (value==SFLOAT_POS_INFINITY)
+		return 1;
+	if (value==SFLOAT_NEG_INFINITY)
+		return -1;
+	return 0;
+}
+
+/**
+@brief Divide by a power of ten, rounding half away from zero.
+@details The remainder is compared with the divisor less the remainder, so that no intermediate result overflows.
+@param value - the dividend.
+@param decades - the power of ten to divide by. Beyond the table, the quotient is 0 for any 32-bit dividend.
+@return the rounded quotient.*/
+static sfloatInt_t sfloatDivRound(sfloatInt_t value, unsigned char decades)
+{
+	sfloatInt_t divisor, quotient, remainder;
+
+	if (decades>=SFLOAT_POW10_NUM)
+		return 0;
+	divisor=sfloatPow10[decades];
+	quotient=value/divisor;
+	remainder=value%divisor;
+	if (remainder>=divisor-remainder)
+		quotient++;
+	else if (-remainder>=divisor+remainder)
+		quotient--;
+	return quotient;
+}
+
+/**
+@brief Divide by a power of ten, keeping a trace of the digits dropped in a last extra digit.
+@details The quotient is truncated one decade further than asked, and then given back a last digit of 5 when anything
+	 non zero was dropped, 0 otherwise. It rounds like the exact quotient at any position two decades or more above
+	 its last digit, where a rounded quotient could turn into a tie and be rounded a second time the wrong way.
+@param value - the dividend.
+@param decades - the power of ten to divide by.
+@return the quotient, its last digit standing for the digits dropped.*/
+static sfloatInt_t sfloatSticky(sfloatInt_t value, unsigned char decades)
+{
+	sfloatInt_t quotient;
+
+	if (decades+1>=SFLOAT_POW10_NUM)
+		return (value>0) ? 5 : ((value<0) ? -5 : 0);
+	quotient=value/sfloatPow10[decades+1]*10;
+	if (quotient*sfloatPow10[decades]!=value)
+		quotient+=(value>0) ? 5 : -5;
+	return quotient;
+}
+
+/**
+@brief Tell whether a SFLOAT is a finite number, neither an infinity nor a not a number value.
+@param value - the SFLOAT.
+@return 1 if it is finite, 0 otherwise.*/
+unsigned char sfloatIsFinite(SFLOAT value)
+{
+	return (sfloatIsNaN(value) || sfloatInfinity(value)!=0) ? 0 : 1;
+}
+
+/**
+@brief Bring a SFLOAT to its shortest form, removing the trailing zeros of the mantissa.
+@details Two finite SFLOATs of the same value have the same normalized form, the zero being 0x0000.
+@param value - the SFLOAT.
+@return the normalized SFLOAT. The special values are returned as they are.*/
+SFLOAT sfloatNormalize(SFLOAT value)
+{
+	short mantissa=SFLOAT_MANTISSA(value);
+	signed char exponent=SFLOAT_EXPONENT(value);
+
+	if (!sfloatIsFinite(value))
+		return value;
+	if (mantissa==0)
+		return 0x0000;
+	//A mantissa has at most 4 digits, so at most 3 trailing zeros
+	while (exponent<SFLOAT_EXPONENT_MAX && mantissa%10==0)
+	{
+		mantissa/=10;
+		exponent++;
+	}
+	return (SFLOAT)(((unsigned short)exponent<<12) | ((unsigned short)mantissa & 0x0FFF));
+}
+
+/**
+@brief Compare two SFLOATs by value, whatever their exponents.
+@details The mantissa with the larger exponent is scaled to the smaller exponent. When the exponents are more than
+	 6 apart, the scaled mantissa would not fit 32 bits, but it is then larger than any mantissa unless it is 0,
+	 so the comparison is settled by the signs.
+@param a - the first SFLOAT.
+@param b - the second SFLOAT.
+@return -1 if a is less than b, 0 if they are equal, 1 if a is greater than b, SFLOAT_UNORDERED if either is a not a
+	number value.*/
+signed char sfloatCompare(SFLOAT a, SFLOAT b)
+{
+	signed char infA, infB, signA, signB;
+	signed char expA, expB;
+	sfloatInt_t mantA, mantB;
+
+	if (sfloatIsNaN(a) || sfloatIsNaN(b))
+		return SFLOAT_UNORDERED;
+	infA=sfloatInfinity(a);
+	infB=sfloatInfinity(b);
+	if (infA!=0 || infB!=0)
+		return (infA>infB) ? 1 : ((infA<infB) ? -1 : 0);
+	mantA=SFLOAT_MANTISSA(a);
+	mantB=SFLOAT_MANTISSA(b);
+	signA=(mantA>0) ? 1 : ((mantA<0) ? -1 : 0);
+	signB=(mantB>0) ? 1 : ((mantB<0) ? -1 : 0);
+	if (signA!=signB || signA==0)
+		return (signA>signB) ? 1 : ((signA<signB) ? -1 : 0);
+	//Same sign, both non zero. Scale the mantissa with the larger exponent.
+	expA=SFLOAT_EXPONENT(a);
+	expB=SFLOAT_EXPONENT(b);
+	if (expA-expB>6)
+		return signA;
+	if (expB-expA>6)
+		return -signB;
+	if (expA>expB)
+		mantA*=sfloatPow10[expA-expB];
+	else
+		mantB*=sfloatPow10[expB-expA];
+	return (mantA>mantB) ? 1 : ((mantA<mantB) ? -1 : 0);
+}
+
+/**
+@brief Tell whether a SFLOAT lies within a range, bounds included.
+@param value - the SFLOAT.
+@param min - the lower bound.
+@param max - the upper bound.
+@return 1 if min<=value<=max, 0 otherwise, also when any of them is a not a number value.*/
+unsigned char sfloatInRange(SFLOAT value, SFLOAT min, SFLOAT max)
+{
+	signed char low=sfloatCompare(value, min);
+	signed char high=sfloatCompare(value, max);
+
+	return (low!=SFLOAT_UNORDERED && low>=0 && high!=SFLOAT_UNORDERED && high<=0) ? 1 : 0;
+}
+
+/**
+@brief Add two SFLOATs, the second one being negated first if asked.
+@details The sum is exact when the exponents are at most SFLOAT_ALIGN_MAX apart. Beyond, the operand with the smaller
+	 exponent is first brought to SFLOAT_ALIGN_MAX decades below the other one with sfloatSticky. The result then
+	 has an exponent at least 3 decades above the other one, the same as the exact sum would round to.
+@param a - the first SFLOAT.
+@param b - the second SFLOAT.
+@param negate - 1 to subtract b, 0 to add it.
+@return the SFLOAT nearest to the sum.*/
+static SFLOAT sfloatAddSigned(SFLOAT a, SFLOAT b, unsigned char negate)
+{
+	signed char infA, infB, expA, expB, exponent;
+	sfloatInt_t mantA, mantB;
+
+	if (sfloatIsNaN(a) || sfloatIsNaN(b))
+		return SFLOAT_NAN;
+	infA=sfloatInfinity(a);
+	infB=sfloatInfinity(b);
+	mantB=SFLOAT_MANTISSA(b);
+	if (negate)
+	{
+		infB=-infB;
+		mantB=-mantB;
+	}
+	if (infA!=0 && infB!=0 && infA!=infB)
+		return SFLOAT_NAN;
+	if (infA!=0 || infB!=0)
+		return (infA+infB>0) ? SFLOAT_POS_INFINITY : SFLOAT_NEG_INFINITY;
+	mantA=SFLOAT_MANTISSA(a);
+	expA=SFLOAT_EXPONENT(a);
+	expB=SFLOAT_EXPONENT(b);
+	//Bring both mantissas to the smaller exponent, or to SFLOAT_ALIGN_MAX decades below the larger one
+	if (mantA==0)
+		return sfloatEncode(mantB, expB);
+	if (mantB==0)
+		return sfloatEncode(mantA, expA);
+	if (expA-expB>SFLOAT_ALIGN_MAX)
+	{
+		mantB=sfloatSticky(mantB, expA-SFLOAT_ALIGN_MAX-expB);
+		expB=expA-SFLOAT_ALIGN_MAX;
+	}
+	else if (expB-expA>SFLOAT_ALIGN_MAX)
+	{
+		mantA=sfloatSticky(mantA, expB-SFLOAT_ALIGN_MAX-expA);
+		expA=expB-SFLOAT_ALIGN_MAX;
+	}
+	exponent=(expA<expB) ? expA : expB;
+	return sfloatEncode(mantA*sfloatPow10[expA-exponent]+mantB*sfloatPow10[expB-exponent], exponent);
+}
+
+/**
+@brief Add two SFLOATs.
+@details An infinity added to a finite value stays the same infinity, two opposite infinities give SFLOAT_NAN.
+@param a - the first SFLOAT.
+@param b - the second SFLOAT.
+@return the SFLOAT nearest to a+b, SFLOAT_NAN if either is a not a number value.*/
+SFLOAT sfloatAdd(SFLOAT a, SFLOAT b)
+{
+	return sfloatAddSigned(a, b, 0);
+}
+
+/**
+@brief Subtract two SFLOATs.
+@param a - the SFLOAT subtracted from.
+@param b - the SFLOAT subtracted.
+@return the SFLOAT nearest to a-b, SFLOAT_NAN if either is a not a number value.*/
+SFLOAT sfloatSub(SFLOAT a, SFLOAT b)
+{
+	return sfloatAddSigned(a, b, 1);
+}
+
+/**
+@brief Scale a SFLOAT to an integer of a given exponent, e.g. mg/dL with the exponent 0 or 0.1 mg/dL with -1.
+@details Digits below the exponent are rounded half away from zero. Values out of the 32-bit range saturate.
+@param value - the SFLOAT.
+@param exponent - the exponent of the unit of the result.
+@return value/10^exponent; +/-SFLOAT_INT_MAX for the infinities, 0 for a not a number value.*/
+sfloatInt_t sfloatToInt(SFLOAT value, signed char exponent)
+{
+	sfloatInt_t mantissa=SFLOAT_MANTISSA(value);
+	signed char shift=SFLOAT_EXPONENT(value)-exponent;
+
+	if (sfloatIsNaN(value))
+		return 0;
+	if (sfloatInfinity(value)!=0)
+		return sfloatInfinity(value)*SFLOAT_INT_MAX;
+	if (shift<0)
+		return sfloatDivRound(mantissa, -shift);
+	if (mantissa==0)
+		return 0;
+	if (shift>=SFLOAT_POW10_NUM || mantissa>SFLOAT_INT_MAX/sfloatPow10[shift] || mantissa<-SFLOAT_INT_MAX/sfloatPow10[shift])
+		return (mantissa>0) ? SFLOAT_INT_MAX : -SFLOAT_INT_MAX;
+	return mantissa*sfloatPow10[shift];
+}
+
+/**
+@brief Encode an integer of a given exponent as a SFLOAT, choosing the smallest exponent its mantissa fits.
+@details The value is rounded half away from zero to the chosen exponent. The mantissa takes its full range,
+	 SFLOAT_MANTISSA_MIN_EXP to SFLOAT_MANTISSA_MAX_EXP, except with the exponent 0 where the special values
+	 limit it to SFLOAT_MANTISSA_MAX. A value too large for the largest exponent is encoded as an infinity, one too
+	 small for the smallest exponent as 0.
+@param value - the integer.
+@param exponent - the exponent of the unit of value, e.g. -1 for a value in 0.1 mg/dL/min.
+@return the SFLOAT nearest to value*10^exponent.*/
+SFLOAT sfloatEncode(sfloatInt_t value, signed char exponent)
+{
+	sfloatInt_t mantissa;
+	unsigned char shift=0;
+
+	if (exponent>SFLOAT_EXPONENT_MAX)
+	{
+		//Move the decades into the mantissa, as long as it stays within range
+		shift=exponent-SFLOAT_EXPONENT_MAX;
+		if (value!=0 && (shift>=SFLOAT_POW10_NUM || value>SFLOAT_MANTISSA_MAX_EXP/sfloatPow10[shift] || value<SFLOAT_MANTISSA_MIN_EXP/sfloatPow10[shift]))
+			return (value>0) ? SFLOAT_POS_INFINITY : SFLOAT_NEG_INFINITY;
+		value=(value==0) ? 0 : value*sfloatPow10[shift];
+		exponent=SFLOAT_EXPONENT_MAX;
+		shift=0;
+	}
+	else if (exponent<SFLOAT_EXPONENT_MIN)
+		shift=SFLOAT_EXPONENT_MIN-exponent;
+	//Look the decades to take off up in the tables of limits, so that the value is divided once at most, and not at
+	//all when it already fits
+	for (;shift<SFLOAT_LIMIT_NUM;shift++)
+	{
+		if (exponent+shift==0)
+		{
+			if (value<=sfloatLimit[shift] && value>=-sfloatLimit[shift])
+				break;
+		}
+		else if (value<=sfloatLimitExp[shift] && value>=-sfloatLimitExp[shift]-sfloatPow10[shift])
+			break;
+	}
+	mantissa=(shift==0) ? value : sfloatDivRound(value, shift);
+	if (exponent+shift>SFLOAT_EXPONENT_MAX)
+		return (mantissa>0) ? SFLOAT_POS_INFINITY : SFLOAT_NEG_INFINITY;
+	exponent+=shift;
+	return (SFLOAT)(((unsigned short)exponent<<12) | ((unsigned short)mantissa & 0x0FFF));
+}
@@ -0,0 +1,63 @@
+/*!
+\file		sfloat.h
+\brief		This file contains the declarations of the SFLOAT arithmetic, the 16-bit IEEE 11073 float of the glucose fields.
+\author		Harry Qiu
+\version        1
+\date		2015-March-20
+\copyright	MIT License (MIT)\n
+ Copyright (c) 2014-2015 Center for Global ehealthinnovation
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions: The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef __SFLOAT__
+#define __SFLOAT__
+
+#define	SFLOAT	unsigned short	///< Using a unsigned 16bit integer to store a SFLOAT
+
+#if defined(__ICC8051__)
+typedef long sfloatInt_t;			///< The 32-bit integer the SFLOAT values are scaled to
+#else
+#include <stdint.h>
+typedef int32_t sfloatInt_t;			///< The 32-bit integer the SFLOAT values are scaled to, also on hosts with a 64-bit long
+#endif
+
+/// \defgroup sfloatgrp SFLOAT Arithmetic
+/// \brief The value of a SFLOAT is mantissa*10^exponent, with a 12-bit signed mantissa in the low bits and a 4-bit
+///	   signed exponent in the high nibble. The special values below use the exponent 0.
+///@{
+#define SFLOAT_NAN		0x07FF	///< Not a number
+#define SFLOAT_NRES		0x0800	///< Not at this resolution
+#define SFLOAT_POS_INFINITY	0x07FE	///< Positive infinity
+#define SFLOAT_NEG_INFINITY	0x0802	///< Negative infinity
+#define SFLOAT_RESERVED		0x0801	///< Reserved for future use, handled as a not a number
+#define SFLOAT_MANTISSA_MAX	2045	///< The largest mantissa encoded with the exponent 0, so that it does not run into the special values
+#define SFLOAT_MANTISSA_MAX_EXP	2047	///< The largest mantissa encoded with an exponent other than 0
+#define SFLOAT_MANTISSA_MIN_EXP	(-2048)	///< The smallest mantissa encoded with an exponent other than 0
+#define SFLOAT_EXPONENT_MAX	7	///< The largest exponent
+#define SFLOAT_EXPONENT_MIN	(-8)	///< The smallest exponent
+#define SFLOAT_INT_MAX		((sfloatInt_t)0x7FFFFFFF)	///< The value sfloatToInt saturates at, also for the positive infinity
+#define SFLOAT_UNORDERED	2	///< The result of sfloatCompare when either value is not a number
+
+#define SFLOAT_EXPONENT(x)	((signed char)((signed char)((x)>>8)>>4))	///< The exponent of a SFLOAT, sign extended
+#define SFLOAT_MANTISSA(x)	((short)((short)((x)<<4)>>4))			///< The mantissa of a SFLOAT, sign extended
+/// \brief Encode an integer of a constant exponent as a SFLOAT, like sfloatEncode, without a call when the value already fits
+///	   the mantissa. The value is evaluated more than once.
+#define SFLOAT_ENCODE(v,e)	(((v)>=-SFLOAT_MANTISSA_MAX && (v)<=SFLOAT_MANTISSA_MAX && (e)>=SFLOAT_EXPONENT_MIN && (e)<=SFLOAT_EXPONENT_MAX) \
+				? (SFLOAT)(((unsigned short)(e)<<12) | ((unsigned short)(v) & 0x0FFF)) : sfloatEncode((v),(e)))
+#define SFLOAT_FROM_UNSIGNED(x)	(((x)>SFLOAT_MANTISSA_MAX) ? SFLOAT_POS_INFINITY : (SFLOAT)(x))	///< Encode a non negative integer with the exponent 0, saturating to the positive infinity
+///@}
+
+ unsigned char	sfloatIsFinite(SFLOAT value);
+ SFLOAT		sfloatNormalize(SFLOAT value);
+ signed char	sfloatCompare(SFLOAT a, SFLOAT b);
+ unsigned char	sfloatInRange(SFLOAT value, SFLOAT min, SFLOAT max);
+ SFLOAT		sfloatAdd(SFLOAT a, SFLOAT b);
+ SFLOAT		sfloatSub(SFLOAT a, SFLOAT b);
+ sfloatInt_t	sfloatToInt(SFLOAT value, signed char exponent);
+ SFLOAT		sfloatEncode(sfloatInt_t value, signed char exponent);
+#endif
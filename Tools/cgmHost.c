@@ -0,0 +1,119 @@
+/*!
+\file		cgmHost.c
+\brief		This file contains a host driver of the CGM application, linked unmodified against the stand-in stack of hoststub/ti_host.c.
+\details	Usage: cgmHost [hours] [collectors]\n
+		The tool initializes the application as OSAL would, connects the collectors (1 by default, at most
+		GATT_MAX_NUM_CONN), and subscribes each of them to the CGM measurement notifications and the RACP and SOCP
+		indications. It then runs the sensor for the given span of virtual time (24 hours by default); every
+		HOST_RACP_PERIOD ms each collector asks the RACP to report all the stored records. The application sees
+		the timers, the messages and the connection events of the stack, and its measurement and RACP paths run
+		as on the target, as fast as the host allows. The tool prints the host time, the number of calls of
+		CGM_ProcessEvent and their rate, the PDUs sent and refused, and the RACP requests accepted and refused. It
+		exits with 1 when no measurement reached a collector or no RACP transfer completed, and with 0 otherwise.
+		FEATURE_GLUCOSE_VIRTUAL_TIME must stay 0: the stand-in stack moves the clock itself.
+		Build it with the Makefile of this directory, or with: cc -Ihoststub -I../Source -I../Profiles/CGM -o cgmHost
+		cgmHost.c hoststub/ti_host.c ../Source/cgm.c ../Source/cgmModel.c ../Source/cgmSimData.c ../Source/cgmTrace.c
+		../Source/crc.c ../Source/sfloat.c ../Profiles/CGM/cgmservice.c
+\author		Harry Qiu
+\version        1
+\date		2015-March-20
+\copyright	MIT License (MIT)\n
+ Copyright (c) 2014-2015 Center for Global ehealthinnovation
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions: The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#define _POSIX_C_SOURCE 200112L	///< For clock_gettime under strict C99
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "ti_host.h"
+#include "cgm.h"
+#include "cgmservice.h"
+
+#define HOST_RACP_PERIOD	600000UL	///< The period of the RACP report-all request of each collector, in ms
+
+static uint32	hostRacpRsp;		///< The RACP responses received that report a completed transfer
+
+/**
+@brief Count the RACP responses that close a successful report.
+@param connHandle - the link of the PDU.
+@param handle - the attribute handle of the PDU.
+@param pValue - the value of the PDU.
+@param len - the length of the value.
+@param indication - non zero for an indication.
+@return none*/
+static void hostPdu(uint16 connHandle, uint16 handle, uint8 *pValue, uint8 len, uint8 indication)
+{
+	VOID connHandle;
+	VOID handle;
+	if (indication && len>=4 && pValue[0]==CTL_PNT_OP_REQ_RSP && pValue[2]==CTL_PNT_OP_REQ && pValue[3]==CTL_PNT_RSP_SUCCESS)
+		hostRacpRsp++;
+}
+
+/**
+@brief Read the host clock.
+@return the time, in s.*/
+static double hostClock(void)
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec+t.tv_nsec*1e-9;
+}
+
+int main(int argc, char *argv[])
+{
+	static uint8 racpReportAll[]={CTL_PNT_OP_REQ, CTL_PNT_OPER_ALL};
+	uint32 hours=(argc>1) ? (uint32)atol(argv[1]) : 24;
+	uint16 collectors=(argc>2) ? (uint16)atoi(argv[2]) : 1;
+	uint32 racpAccepted=0, racpRefused=0;
+	uint32 end, t;
+	uint16 c;
+	double start, elapsed;
+
+	if (collectors<1 || collectors>GATT_MAX_NUM_CONN)
+	{
+		printf("cgmHost: between 1 and %d collectors\n", GATT_MAX_NUM_CONN);
+		return 1;
+	}
+	tiHostPduCB=hostPdu;
+	start=hostClock();
+	CGM_Init(tiHostInit(CGM_ProcessEvent));
+	tiHostRun(0);
+	for (c=0;c<collectors;c++)
+	{
+		tiHostConnect(c);
+		tiHostWriteCCC(c, CGM_MEAS_UUID, GATT_CLIENT_CFG_NOTIFY);
+		tiHostWriteCCC(c, REC_ACCESS_CTRL_PT_UUID, GATT_CLIENT_CFG_INDICATE);
+		tiHostWriteCCC(c, CGM_SPEC_OPS_CTRL_PT_UUID, GATT_CLIENT_CFG_INDICATE);
+	}
+	end=hours*3600000UL;
+	for (t=HOST_RACP_PERIOD;t<=end;t+=HOST_RACP_PERIOD)
+	{
+		tiHostRun(t-tiHostNow());
+		for (c=0;c<collectors;c++)
+		{
+			if (tiHostWriteChar(c, REC_ACCESS_CTRL_PT_UUID, racpReportAll, sizeof(racpReportAll))==SUCCESS)
+				racpAccepted++;
+			else
+				racpRefused++;
+		}
+	}
+	tiHostRun(end-tiHostNow());
+	elapsed=hostClock()-start;
+
+	printf("%lu h of sensor time with %u collectors in %.3f s\n", (unsigned long)hours, collectors, elapsed);
+	printf("%lu dispatches, %.0f per second, %lu connection events\n", (unsigned long)tiHostStats.dispatches,
+	       tiHostStats.dispatches/elapsed, (unsigned long)tiHostStats.connEvents);
+	printf("%lu notifications, %lu indications, %lu refused for lack of TX buffers\n",
+	       (unsigned long)tiHostStats.notifications, (unsigned long)tiHostStats.indications,
+	       (unsigned long)tiHostStats.txRefused);
+	printf("%lu RACP requests accepted, %lu refused, %lu transfers completed\n",
+	       (unsigned long)racpAccepted, (unsigned long)racpRefused, (unsigned long)hostRacpRsp);
+	return (tiHostStats.notifications==0 || (racpAccepted!=0 && hostRacpRsp==0)) ? 1 : 0;
+}
@@ -0,0 +1,267 @@
+/*!
+\file		cgmTraceConv.c
+\brief		This file contains a host tool converting CSV glucose traces to the compact binary trace format of cgmtrace.h.
+\details	Usage: cgmTraceConv [-i interval] [-m] [-b samples] [-c name] input.csv output\n
+		-i the sampling interval in seconds (default 300)\n
+		-m the values are in mmol/L, and are stored in tenths of mmol/L (default mg/dL)\n
+		-b the number of samples per block, between seek points (default 256)\n
+		-c write a C source file defining the array "name" instead of a binary file, to embed the trace in flash\n
+		Usage: cgmTraceConv -d input\n
+		-d decode a binary trace and print its samples in mg/dL, one per line\n
+		The value of a CSV line is its last field, as in cgmSimData.c; lines without a value are skipped.
+		Build it with: cc -I../Source -o cgmTraceConv cgmTraceConv.c ../Source/cgmTrace.c ../Source/cgmSimData.c
+\author		Harry Qiu
+\version        1
+\date		2015-March-20
+\copyright	MIT License (MIT)\n
+ Copyright (c) 2014-2015 Center for Global ehealthinnovation
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions: The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cgmtrace.h"
+
+#define CONV_LINE_MAX	256	///< The longest CSV line handled
+
+/// \brief A growing byte buffer.
+typedef struct {
+	unsigned char	*pData;		///< The bytes
+	unsigned long	len;		///< The number of bytes used
+	unsigned long	cap;		///< The number of bytes allocated
+} convBuf_t;
+
+/**
+@brief Append a byte to a buffer, growing it as needed. Exits on an allocation failure.
+@param pBuf - the buffer.
+@param byte - the byte to append.
+@return none*/
+static void convPut(convBuf_t *pBuf, unsigned char byte)
+{
+	if (pBuf->len==pBuf->cap)
+	{
+		pBuf->cap=(pBuf->cap!=0) ? pBuf->cap*2 : 4096;
+		if ((pBuf->pData=realloc(pBuf->pData, pBuf->cap))==NULL)
+		{
+			fprintf(stderr, "out of memory\n");
+			exit(1);
+		}
+	}
+	pBuf->pData[pBuf->len++]=byte;
+}
+
+/**
+@brief Append a varint to a buffer.
+@param pBuf - the buffer.
+@param value - the value to append.
+@return none*/
+static void convPutVarint(convBuf_t *pBuf, unsigned long value)
+{
+	while (value>=0x80)
+	{
+		convPut(pBuf, (unsigned char)(value|0x80));
+		value>>=7;
+	}
+	convPut(pBuf, (unsigned char)value);
+}
+
+/**
+@brief Write a little endian field into a buffer.
+@param p - the destination.
+@param value - the value.
+@param len - the size of the field in bytes.
+@return none*/
+static void convSetLE(unsigned char *p, unsigned long value, unsigned char len)
+{
+	while (len--)
+	{
+		*p++=(unsigned char)value;
+		value>>=8;
+	}
+}
+
+/**
+@brief Parse the value of a CSV line, its last field.
+@param pLine - the line.
+@param scale - the value is multiplied by scale, 1 for mg/dL or 10 for mmol/L, and rounded.
+@param [out] pValue - the value found.
+@return 1 if the line has a value, 0 otherwise.*/
+static int convParseLine(const char *pLine, unsigned long scale, unsigned long *pValue)
+{
+	const char *pField=strrchr(pLine, ',');
+	char *pEnd;
+	double value;
+	pField=(pField!=NULL) ? pField+1 : pLine;
+	value=strtod(pField, &pEnd);
+	if (pEnd==pField || value<0)
+		return 0;
+	while (*pEnd==' ' || *pEnd=='\t' || *pEnd=='\r' || *pEnd=='\n')
+		pEnd++;
+	if (*pEnd!='\0')
+		return 0;
+	value=value*scale+0.5;
+	*pValue=(value>0xFFFF) ? 0xFFFF : (unsigned long)value;
+	return 1;
+}
+
+/**
+@brief Encode a CSV trace.
+@param pIn - the CSV file.
+@param [out] pOut - the trace image.
+@param interval - the sampling interval in seconds.
+@param units - CGM_TRACE_UNITS_MGDL or CGM_TRACE_UNITS_MMOL.
+@param blockSamples - the number of samples per block.
+@return 0 on success, 1 if the trace is empty or too long.*/
+static int convEncode(FILE *pIn, convBuf_t *pOut, unsigned short interval, unsigned char units, unsigned short blockSamples)
+{
+	convBuf_t blocks={0,0,0};
+	convBuf_t seek={0,0,0};
+	char line[CONV_LINE_MAX];
+	unsigned long samples=0, value, previous=0, i;
+	unsigned short blockNum;
+	while (fgets(line, sizeof(line), pIn)!=NULL)
+	{
+		if (!convParseLine(line, (units==CGM_TRACE_UNITS_MMOL) ? 10 : 1, &value))
+			continue;
+		if (samples%blockSamples==0)
+		{
+			for (i=0;i<4;i++)	//The offset from the block area, fixed up once the table size is known
+				convPut(&seek, (unsigned char)(blocks.len>>(8*i)));
+			convPutVarint(&blocks, value);
+		}
+		else if (value>=previous)
+			convPutVarint(&blocks, (value-previous)<<1);
+		else
+			convPutVarint(&blocks, ((previous-value-1)<<1)|1);
+		previous=value;
+		samples++;
+	}
+	blockNum=(unsigned short)(seek.len/4);
+	if (samples==0 || seek.len/4>0xFFFF)
+		return 1;
+	for (i=0;i<CGM_TRACE_HEADER_SIZE;i++)
+		convPut(pOut, 0);
+	memcpy(pOut->pData, "CGMT", 4);
+	pOut->pData[4]=CGM_TRACE_VERSION;
+	pOut->pData[5]=units;
+	convSetLE(pOut->pData+6, interval, 2);
+	convSetLE(pOut->pData+8, blockSamples, 2);
+	convSetLE(pOut->pData+10, samples, 4);
+	convSetLE(pOut->pData+14, blockNum, 2);
+	for (i=0;i<blockNum;i++)
+	{
+		unsigned long offset=seek.pData[4*i] | ((unsigned long)seek.pData[4*i+1]<<8)
+			| ((unsigned long)seek.pData[4*i+2]<<16) | ((unsigned long)seek.pData[4*i+3]<<24);
+		offset+=CGM_TRACE_HEADER_SIZE+4UL*blockNum;
+		convPut(pOut, 0); convPut(pOut, 0); convPut(pOut, 0); convPut(pOut, 0);
+		convSetLE(pOut->pData+pOut->len-4, offset, 4);
+	}
+	for (i=0;i<blocks.len;i++)
+		convPut(pOut, blocks.pData[i]);
+	free(blocks.pData);
+	free(seek.pData);
+	return 0;
+}
+
+/**
+@brief Print the samples of a binary trace.
+@param pPath - the trace file.
+@return the exit code.*/
+static int convDecode(const char *pPath)
+{
+	convBuf_t image={0,0,0};
+	cgmTrace_t trace;
+	unsigned short value;
+	FILE *f;
+	int c;
+	if ((f=fopen(pPath, "rb"))==NULL)
+	{
+		perror(pPath);
+		return 1;
+	}
+	while ((c=fgetc(f))!=EOF)
+		convPut(&image, (unsigned char)c);
+	fclose(f);
+	if (cgmTraceOpen(&trace, image.pData, image.len)!=0)
+	{
+		fprintf(stderr, "%s: not a valid trace\n", pPath);
+		return 1;
+	}
+	while (cgmTraceNext(&trace, &value)==0)
+		printf("%u\n", value);
+	if (trace.cursorSample!=trace.samples)
+	{
+		fprintf(stderr, "%s: corrupted at sample %lu\n", pPath, trace.cursorSample);
+		return 1;
+	}
+	free(image.pData);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned short interval=300, blockSamples=256;
+	unsigned char units=CGM_TRACE_UNITS_MGDL;
+	const char *pName=NULL;
+	convBuf_t image={0,0,0};
+	FILE *pIn, *pOut;
+	unsigned long i;
+	int arg=1;
+	if (argc==3 && strcmp(argv[1], "-d")==0)
+		return convDecode(argv[2]);
+	for (;arg+2<argc && argv[arg][0]=='-';arg++)
+	{
+		if (strcmp(argv[arg], "-m")==0)
+			units=CGM_TRACE_UNITS_MMOL;
+		else if (strcmp(argv[arg], "-i")==0 && arg+3<argc)
+			interval=(unsigned short)atoi(argv[++arg]);
+		else if (strcmp(argv[arg], "-b")==0 && arg+3<argc)
+			blockSamples=(unsigned short)atoi(argv[++arg]);
+		else if (strcmp(argv[arg], "-c")==0 && arg+3<argc)
+			pName=argv[++arg];
+		else
+			break;
+	}
+	if (arg+2!=argc || blockSamples==0)
+	{
+		fprintf(stderr, "usage: %s [-i interval] [-m] [-b samples] [-c name] input.csv output\n"
+			"       %s -d input\n", argv[0], argv[0]);
+		return 2;
+	}
+	if ((pIn=fopen(argv[arg], "r"))==NULL)
+	{
+		perror(argv[arg]);
+		return 1;
+	}
+	if (convEncode(pIn, &image, interval, units, blockSamples)!=0)
+	{
+		fprintf(stderr, "%s: no values, or too many blocks\n", argv[arg]);
+		return 1;
+	}
+	fclose(pIn);
+	if ((pOut=fopen(argv[arg+1], (pName!=NULL) ? "w" : "wb"))==NULL)
+	{
+		perror(argv[arg+1]);
+		return 1;
+	}
+	if (pName!=NULL)
+	{
+		fprintf(pOut, "/* Generated by cgmTraceConv from %s. Open it with cgmTraceOpen(&trace, %s, sizeof(%s)). */\n",
+			argv[arg], pName, pName);
+		fprintf(pOut, "const unsigned char %s[%lu]={", pName, image.len);
+		for (i=0;i<image.len;i++)
+			fprintf(pOut, "%s%u", (i==0) ? "" : ((i%20==0) ? ",\n" : ","), image.pData[i]);
+		fprintf(pOut, "};\n");
+	}
+	else
+		fwrite(image.pData, 1, image.len, pOut);
+	fclose(pOut);
+	free(image.pData);
+	return 0;
+}
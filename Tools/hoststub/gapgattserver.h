@@ -0,0 +1 @@
+#include "ti_host.h"	// Host stand-in, see ti_host.h
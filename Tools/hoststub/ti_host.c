@@ -0,0 +1,756 @@
+/*!
+\file		ti_host.c
+\brief		This file contains the host stand-in of the TI BLE stack declared in ti_host.h.
+\details	It runs one OSAL task. Its events, timers and messages are kept here, and tiHostRun calls the event
+		processor of the task until nothing is left to do, then moves a virtual millisecond clock to the next timer
+		or connection event, so that hours of sensor time pass in a fraction of a second. Every connected link has a
+		connection event each TI_HOST_CONN_INTERVAL ms, which releases its TI_HOST_TX_BUFS TX buffers and sets the
+		event asked for with HCI_EXT_ConnEventNoticeCmd. GATT keeps the attribute tables of the services and their
+		client configurations, and the tiHost functions write them as a collector would. The GAP, bond manager,
+		device information and battery calls accept everything and do nothing.
+\author		Harry Qiu
+\version        1
+\date		2015-March-20
+\copyright	MIT License (MIT)\n
+ Copyright (c) 2014-2015 Center for Global ehealthinnovation
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions: The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include "ti_host.h"
+
+#define TI_HOST_TASK_ID		0	///< The task ID given to the only task
+#define TI_HOST_TIMERS		16	///< The number of timers that may run at the same time
+#define TI_HOST_SERVICES	4	///< The number of attribute tables GATTServApp_RegisterService keeps
+#define TI_HOST_LINKDB_CBS	4	///< The number of link state callbacks linkDB_Register keeps
+#define TI_HOST_FIRST_HANDLE	0x0010	///< The attribute handle given to the first attribute registered
+
+/// \brief An OSAL timer.
+typedef struct {
+	uint8	active;			///< Non zero while the timer runs.
+	uint16	event;			///< The event set when it expires.
+	uint32	deadline;		///< The virtual time it expires at, in ms.
+} tiHostTimer_t;
+
+/// \brief The header kept in front of an OSAL message.
+typedef struct tiHostMsg {
+	struct tiHostMsg	*pNext;	///< The next message of the queue.
+} tiHostMsg_t;
+
+/// \brief A registered attribute table.
+typedef struct {
+	gattAttribute_t		*pAttrs;	///< The attributes.
+	uint16			numAttrs;	///< The number of attributes.
+	const gattServiceCBs_t	*pCBs;		///< The read and write callbacks of the service.
+} tiHostService_t;
+
+/// \brief The state of a link.
+typedef struct {
+	uint8		up;		///< Non zero while connected.
+	uint8		txFree;		///< The TX buffers left until the next connection event.
+	linkDBItem_t	item;		///< The record linkDB_Find returns.
+} tiHostLink_t;
+
+tiHostStats_t	tiHostStats;					///< The counters of the stand-in stack
+tiHostPduCB_t	tiHostPduCB;					///< The function told about every PDU sent, or NULL
+
+static tiHostProcessEvent_t	tiHostProcessEvent;		///< The event processor of the task
+static uint16			tiHostEvents;			///< The events set on the task
+static tiHostTimer_t		tiHostTimers[TI_HOST_TIMERS];	///< The OSAL timers
+static tiHostMsg_t		*pTiHostMsgHead;		///< The oldest message waiting for the task
+static tiHostMsg_t		*pTiHostMsgTail;		///< The newest message waiting for the task
+static uint32			tiHostTime;			///< The virtual time, in ms
+static UTCTime			tiHostClockBase;		///< The OSAL clock at virtual time 0, in seconds
+static uint32			tiHostNextConnEvent;		///< The virtual time of the next connection event
+static uint16			tiHostConnNotice;		///< The event set at every connection event, 0 for none
+static tiHostService_t		tiHostServices[TI_HOST_SERVICES];	///< The registered attribute tables
+static uint8			tiHostServiceNum;		///< The number of registered attribute tables
+static uint16			tiHostNextHandle=TI_HOST_FIRST_HANDLE;	///< The handle of the next attribute registered
+static pfnLinkDBCB_t		tiHostLinkCBs[TI_HOST_LINKDB_CBS];	///< The link state callbacks
+static tiHostLink_t		tiHostLinks[GATT_MAX_NUM_CONN];	///< The links
+static uint16			tiHostLastConn=INVALID_CONNHANDLE;	///< The handle of the last link connected, GAPROLE_CONNHANDLE
+static gapRolesCBs_t		*pTiHostRoleCBs;		///< The GAP role callbacks of GAPRole_StartDevice
+
+const uint8 primaryServiceUUID[ATT_BT_UUID_SIZE]={LO_UINT16(0x2800), HI_UINT16(0x2800)};	///< The primary service declaration UUID
+const uint8 characterUUID[ATT_BT_UUID_SIZE]={LO_UINT16(0x2803), HI_UINT16(0x2803)};		///< The characteristic declaration UUID
+const uint8 clientCharCfgUUID[ATT_BT_UUID_SIZE]={LO_UINT16(GATT_CLIENT_CHAR_CFG_UUID), HI_UINT16(GATT_CLIENT_CHAR_CFG_UUID)};	///< The client characteristic configuration UUID
+
+/*
+ * Host controls
+ */
+
+/**
+@brief Reset the stand-in stack and register the event processor of the task.
+@param pfnProcessEvent - the event processor, e.g. CGM_ProcessEvent.
+@return the task ID to hand to the initialization function of the task.*/
+uint8 tiHostInit(tiHostProcessEvent_t pfnProcessEvent)
+{
+	tiHostProcessEvent=pfnProcessEvent;
+	tiHostEvents=0;
+	tiHostTime=0;
+	tiHostNextConnEvent=TI_HOST_CONN_INTERVAL;
+	tiHostConnNotice=0;
+	memset(tiHostTimers, 0, sizeof(tiHostTimers));
+	memset(tiHostLinks, 0, sizeof(tiHostLinks));
+	memset(&tiHostStats, 0, sizeof(tiHostStats));
+	return TI_HOST_TASK_ID;
+}
+
+/**
+@brief Give the task every event it has, until it has none left.
+@return none*/
+static void tiHostDispatch(void)
+{
+	uint16 events;
+	while (tiHostEvents)
+	{
+		events=tiHostEvents;
+		tiHostEvents=0;
+		tiHostStats.dispatches++;
+		tiHostEvents|=tiHostProcessEvent(TI_HOST_TASK_ID, events);
+	}
+}
+
+/**
+@brief Run the task for a span of virtual time.
+@details The time moves from one timer or connection event to the next, without waiting. The task must not keep an
+	 event set for ever, or this does not return.
+@param ms - the span, in ms.
+@return none*/
+void tiHostRun(uint32 ms)
+{
+	uint32 end=tiHostTime+ms;
+	uint32 next;
+	uint8 i;
+	for (;;)
+	{
+		tiHostDispatch();
+		next=tiHostNextConnEvent;
+		for (i=0;i<TI_HOST_TIMERS;i++)
+			if (tiHostTimers[i].active && tiHostTimers[i].deadline<next)
+				next=tiHostTimers[i].deadline;
+		if (next>end)
+		{
+			tiHostTime=end;
+			return;
+		}
+		tiHostTime=next;
+		for (i=0;i<TI_HOST_TIMERS;i++)
+			if (tiHostTimers[i].active && tiHostTimers[i].deadline<=tiHostTime)
+			{
+				tiHostTimers[i].active=0;
+				tiHostEvents|=tiHostTimers[i].event;
+			}
+		if (tiHostNextConnEvent<=tiHostTime)
+		{
+			tiHostNextConnEvent+=TI_HOST_CONN_INTERVAL;
+			for (i=0;i<GATT_MAX_NUM_CONN;i++)
+				if (tiHostLinks[i].up)
+				{
+					tiHostLinks[i].txFree=TI_HOST_TX_BUFS;
+					tiHostStats.connEvents++;
+					tiHostEvents|=tiHostConnNotice;
+				}
+		}
+	}
+}
+
+/**
+@brief Get the virtual time.
+@return the time since tiHostInit, in ms.*/
+uint32 tiHostNow(void)
+{
+	return tiHostTime;
+}
+
+/**
+@brief Tell the link state callbacks and the GAP role of a change of a link.
+@param connHandle - the link.
+@param changeType - the LINKDB_STATUS_UPDATE_ change.
+@param state - the GAP role state reported.
+@return none*/
+static void tiHostLinkChange(uint16 connHandle, uint8 changeType, gaprole_States_t state)
+{
+	uint8 i;
+	for (i=0;i<TI_HOST_LINKDB_CBS;i++)
+		if (tiHostLinkCBs[i]!=NULL)
+			tiHostLinkCBs[i](connHandle, changeType);
+	if (pTiHostRoleCBs!=NULL && pTiHostRoleCBs->pfnStateChange!=NULL)
+		pTiHostRoleCBs->pfnStateChange(state);
+	tiHostDispatch();
+}
+
+/**
+@brief Connect a collector.
+@param connHandle - the link, below GATT_MAX_NUM_CONN.
+@return none*/
+void tiHostConnect(uint16 connHandle)
+{
+	tiHostLink_t *pLink=tiHostLinks+connHandle;
+	pLink->up=1;
+	pLink->txFree=TI_HOST_TX_BUFS;
+	pLink->item.taskID=TI_HOST_TASK_ID;
+	pLink->item.connectionHandle=connHandle;
+	pLink->item.stateFlags=LINK_CONNECTED;
+	pLink->item.connInterval=TI_HOST_CONN_INTERVAL*4/5;
+	tiHostLastConn=connHandle;
+	tiHostLinkChange(connHandle, LINKDB_STATUS_UPDATE_NEW, GAPROLE_CONNECTED);
+}
+
+/**
+@brief Disconnect a collector.
+@param connHandle - the link.
+@return none*/
+void tiHostDisconnect(uint16 connHandle)
+{
+	tiHostLinks[connHandle].up=0;
+	tiHostLinkChange(connHandle, LINKDB_STATUS_UPDATE_REMOVED, GAPROLE_WAITING);
+}
+
+/**
+@brief Find a registered attribute by its 16-bit type.
+@param uuid - the attribute type.
+@param ppCBs - receives the callbacks of the service holding the attribute.
+@return the first attribute of that type, or NULL if there is none.*/
+static gattAttribute_t *tiHostFindAttr(uint16 uuid, const gattServiceCBs_t **ppCBs)
+{
+	gattAttribute_t *pAttr;
+	uint8 i;
+	uint16 j;
+	for (i=0;i<tiHostServiceNum;i++)
+		for (j=0,pAttr=tiHostServices[i].pAttrs;j<tiHostServices[i].numAttrs;j++,pAttr++)
+			if (pAttr->type.len==ATT_BT_UUID_SIZE && BUILD_UINT16(pAttr->type.uuid[0], pAttr->type.uuid[1])==uuid)
+			{
+				*ppCBs=tiHostServices[i].pCBs;
+				return pAttr;
+			}
+	return NULL;
+}
+
+/**
+@brief Write a characteristic value as a collector would, through the write callback of its service.
+@param connHandle - the link of the collector.
+@param uuid - the characteristic UUID.
+@param pValue - the value.
+@param len - the length of the value.
+@return the status of the write callback, ATT_ERR_ATTR_NOT_FOUND if no characteristic has that UUID.*/
+bStatus_t tiHostWriteChar(uint16 connHandle, uint16 uuid, uint8 *pValue, uint8 len)
+{
+	const gattServiceCBs_t *pCBs;
+	gattAttribute_t *pAttr=tiHostFindAttr(uuid, &pCBs);
+	bStatus_t status;
+	if (pAttr==NULL)
+		return ATT_ERR_ATTR_NOT_FOUND;
+	status=pCBs->pfnWriteAttrCB(connHandle, pAttr, pValue, len, 0);
+	tiHostDispatch();
+	return status;
+}
+
+/**
+@brief Write the client characteristic configuration of a characteristic as a collector would.
+@param connHandle - the link of the collector.
+@param uuid - the characteristic UUID.
+@param cfg - GATT_CLIENT_CFG_NOTIFY, GATT_CLIENT_CFG_INDICATE or 0.
+@return the status of the write callback, ATT_ERR_ATTR_NOT_FOUND if the characteristic has no configuration.*/
+bStatus_t tiHostWriteCCC(uint16 connHandle, uint16 uuid, uint16 cfg)
+{
+	const gattServiceCBs_t *pCBs;
+	gattAttribute_t *pAttr=tiHostFindAttr(uuid, &pCBs);
+	uint8 value[2]={LO_UINT16(cfg), HI_UINT16(cfg)};
+	bStatus_t status;
+	if (pAttr==NULL)
+		return ATT_ERR_ATTR_NOT_FOUND;
+	//The configuration comes after the value, before the next characteristic
+	for (pAttr++;pAttr->type.uuid!=characterUUID && pAttr->type.uuid!=primaryServiceUUID;pAttr++)
+		if (pAttr->type.uuid==clientCharCfgUUID)
+		{
+			status=pCBs->pfnWriteAttrCB(connHandle, pAttr, value, sizeof(value), 0);
+			tiHostDispatch();
+			return status;
+		}
+	return ATT_ERR_ATTR_NOT_FOUND;
+}
+
+/*
+ * OSAL
+ */
+uint8 osal_set_event(uint8 task_id, uint16 event_flag)
+{
+	VOID task_id;
+	tiHostEvents|=event_flag;
+	return SUCCESS;
+}
+
+uint8 osal_clear_event(uint8 task_id, uint16 event_flag)
+{
+	VOID task_id;
+	tiHostEvents&=~event_flag;
+	return SUCCESS;
+}
+
+uint8 osal_start_timerEx(uint8 task_id, uint16 event_id, uint32 timeout_value)
+{
+	tiHostTimer_t *pFree=NULL;
+	uint8 i;
+	VOID task_id;
+	for (i=0;i<TI_HOST_TIMERS;i++)
+	{
+		if (tiHostTimers[i].active && tiHostTimers[i].event==event_id)
+		{
+			pFree=tiHostTimers+i;
+			break;
+		}
+		if (!tiHostTimers[i].active && pFree==NULL)
+			pFree=tiHostTimers+i;
+	}
+	if (pFree==NULL)
+		return NO_TIMER_AVAIL;
+	pFree->active=1;
+	pFree->event=event_id;
+	pFree->deadline=tiHostTime+timeout_value;
+	return SUCCESS;
+}
+
+uint8 osal_stop_timerEx(uint8 task_id, uint16 event_id)
+{
+	uint8 i;
+	VOID task_id;
+	for (i=0;i<TI_HOST_TIMERS;i++)
+		if (tiHostTimers[i].active && tiHostTimers[i].event==event_id)
+		{
+			tiHostTimers[i].active=0;
+			return SUCCESS;
+		}
+	return INVALID_EVENT_ID;
+}
+
+uint32 osal_get_timeoutEx(uint8 task_id, uint16 event_id)
+{
+	uint8 i;
+	VOID task_id;
+	for (i=0;i<TI_HOST_TIMERS;i++)
+		if (tiHostTimers[i].active && tiHostTimers[i].event==event_id)
+			return tiHostTimers[i].deadline-tiHostTime;
+	return 0;
+}
+
+uint8 *osal_msg_allocate(uint16 len)
+{
+	tiHostMsg_t *pMsg=(tiHostMsg_t *)malloc(sizeof(tiHostMsg_t)+len);
+	if (pMsg==NULL)
+		return NULL;
+	pMsg->pNext=NULL;
+	return (uint8 *)(pMsg+1);
+}
+
+uint8 osal_msg_send(uint8 destination_task, uint8 *msg_ptr)
+{
+	tiHostMsg_t *pMsg=(tiHostMsg_t *)msg_ptr-1;
+	VOID destination_task;
+	if (pTiHostMsgTail!=NULL)
+		pTiHostMsgTail->pNext=pMsg;
+	else
+		pTiHostMsgHead=pMsg;
+	pTiHostMsgTail=pMsg;
+	tiHostEvents|=SYS_EVENT_MSG;
+	return SUCCESS;
+}
+
+uint8 *osal_msg_receive(uint8 task_id)
+{
+	tiHostMsg_t *pMsg=pTiHostMsgHead;
+	VOID task_id;
+	if (pMsg==NULL)
+		return NULL;
+	pTiHostMsgHead=pMsg->pNext;
+	if (pTiHostMsgHead==NULL)
+		pTiHostMsgTail=NULL;
+	else
+		tiHostEvents|=SYS_EVENT_MSG;	//The next message is processed at the next dispatch, as OSAL does
+	return (uint8 *)(pMsg+1);
+}
+
+uint8 osal_msg_deallocate(uint8 *msg_ptr)
+{
+	free((tiHostMsg_t *)msg_ptr-1);
+	return SUCCESS;
+}
+
+void *osal_mem_alloc(uint16 size)
+{
+	return malloc(size);
+}
+
+void osal_mem_free(void *ptr)
+{
+	free(ptr);
+}
+
+void *osal_memcpy(void *dst, const void *src, unsigned int len)
+{
+	return memcpy(dst, src, len);
+}
+
+void *osal_memset(void *dest, uint8 value, int len)
+{
+	return memset(dest, value, len);
+}
+
+uint8 osal_memcmp(const void *src1, const void *src2, unsigned int len)
+{
+	return memcmp(src1, src2, len)==0;
+}
+
+UTCTime osal_getClock(void)
+{
+	return tiHostClockBase+tiHostTime/1000;
+}
+
+void osal_setClock(UTCTime newTime)
+{
+	tiHostClockBase=newTime-tiHostTime/1000;
+}
+
+uint32 osal_GetSystemClock(void)
+{
+	return tiHostTime;
+}
+
+#define TI_HOST_LEAP(y)		(((y)%4==0 && (y)%100!=0) || (y)%400==0)	///< Non zero for a leap year
+#define TI_HOST_YEAR_DAYS(y)	(TI_HOST_LEAP(y) ? 366 : 365)			///< The number of days of a year
+
+/**
+@brief Get the number of days of a month.
+@param leap - non zero in a leap year.
+@param month - the month, 0 for January.
+@return the number of days.*/
+static uint8 tiHostMonthDays(uint8 leap, uint8 month)
+{
+	static const uint8 days[12]={31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+	return (month==1 && leap) ? 29 : days[month];
+}
+
+void osal_ConvertUTCTime(UTCTimeStruct *tm, UTCTime secTime)
+{
+	uint32 day=secTime%86400UL;
+	uint16 numDays=(uint16)(secTime/86400UL);
+	tm->seconds=day%60UL;
+	tm->minutes=(day%3600UL)/60UL;
+	tm->hour=day/3600UL;
+	tm->year=2000;
+	while (numDays>=TI_HOST_YEAR_DAYS(tm->year))
+	{
+		numDays-=TI_HOST_YEAR_DAYS(tm->year);
+		tm->year++;
+	}
+	tm->month=0;
+	while (numDays>=tiHostMonthDays(TI_HOST_LEAP(tm->year), tm->month))
+	{
+		numDays-=tiHostMonthDays(TI_HOST_LEAP(tm->year), tm->month);
+		tm->month++;
+	}
+	tm->day=numDays;
+}
+
+UTCTime osal_ConvertUTCSecs(UTCTimeStruct *tm)
+{
+	uint32 days=tm->day;
+	uint16 year;
+	uint8 month;
+	for (month=0;month<tm->month;month++)
+		days+=tiHostMonthDays(TI_HOST_LEAP(tm->year), month);
+	for (year=2000;year<tm->year;year++)
+		days+=TI_HOST_YEAR_DAYS(year);
+	return ((days*24UL+tm->hour)*60UL+tm->minutes)*60UL+tm->seconds;
+}
+
+/*
+ * HCI
+ */
+hciStatus_t HCI_EXT_ConnEventNoticeCmd(uint8 taskID, uint16 taskEvent)
+{
+	VOID taskID;
+	tiHostConnNotice=taskEvent;
+	return SUCCESS;
+}
+
+/*
+ * GATT
+ */
+bStatus_t GATT_Notification(uint16 connHandle, attHandleValueNoti_t *pNoti, uint8 authenticated)
+{
+	VOID authenticated;
+	if (connHandle>=GATT_MAX_NUM_CONN || !tiHostLinks[connHandle].up)
+		return bleNotConnected;
+	if (tiHostLinks[connHandle].txFree==0)
+	{
+		tiHostStats.txRefused++;
+		return MSG_BUFFER_NOT_AVAIL;
+	}
+	tiHostLinks[connHandle].txFree--;
+	tiHostStats.notifications++;
+	if (tiHostPduCB!=NULL)
+		tiHostPduCB(connHandle, pNoti->handle, pNoti->value, pNoti->len, 0);
+	return SUCCESS;
+}
+
+bStatus_t GATT_Indication(uint16 connHandle, attHandleValueInd_t *pInd, uint8 authenticated, uint8 taskId)
+{
+	VOID authenticated;
+	VOID taskId;
+	if (connHandle>=GATT_MAX_NUM_CONN || !tiHostLinks[connHandle].up)
+		return bleNotConnected;
+	if (tiHostLinks[connHandle].txFree==0)
+	{
+		tiHostStats.txRefused++;
+		return MSG_BUFFER_NOT_AVAIL;
+	}
+	tiHostLinks[connHandle].txFree--;
+	tiHostStats.indications++;
+	if (tiHostPduCB!=NULL)
+		tiHostPduCB(connHandle, pInd->handle, pInd->value, pInd->len, 1);
+	return SUCCESS;
+}
+
+bStatus_t GATT_InitClient(void)
+{
+	return SUCCESS;
+}
+
+bStatus_t GATT_RegisterForInd(uint8 taskId)
+{
+	VOID taskId;
+	return SUCCESS;
+}
+
+/**
+@brief Find the configuration of a link in a client characteristic configuration table.
+@param connHandle - the link, or INVALID_CONNHANDLE for a free entry.
+@param charCfgTbl - the table, of GATT_MAX_NUM_CONN entries.
+@return the entry, or NULL if there is none.*/
+static gattCharCfg_t *tiHostFindCharCfg(uint16 connHandle, gattCharCfg_t *charCfgTbl)
+{
+	uint8 i;
+	for (i=0;i<GATT_MAX_NUM_CONN;i++)
+		if (charCfgTbl[i].connHandle==connHandle)
+			return charCfgTbl+i;
+	return NULL;
+}
+
+uint16 GATTServApp_ReadCharCfg(uint16 connHandle, gattCharCfg_t *charCfgTbl)
+{
+	gattCharCfg_t *pCfg=tiHostFindCharCfg(connHandle, charCfgTbl);
+	return (pCfg!=NULL) ? pCfg->value : 0;
+}
+
+void GATTServApp_InitCharCfg(uint16 connHandle, gattCharCfg_t *charCfgTbl)
+{
+	gattCharCfg_t *pCfg;
+	uint8 i;
+	if (connHandle==INVALID_CONNHANDLE)
+	{
+		for (i=0;i<GATT_MAX_NUM_CONN;i++)
+		{
+			charCfgTbl[i].connHandle=INVALID_CONNHANDLE;
+			charCfgTbl[i].value=0;
+		}
+	}
+	else if ((pCfg=tiHostFindCharCfg(connHandle, charCfgTbl))!=NULL)
+	{
+		pCfg->connHandle=INVALID_CONNHANDLE;
+		pCfg->value=0;
+	}
+}
+
+bStatus_t GATTServApp_RegisterService(gattAttribute_t *pAttrs, uint16 numAttrs, const gattServiceCBs_t *pServiceCBs)
+{
+	uint16 i;
+	if (tiHostServiceNum==TI_HOST_SERVICES)
+		return FAILURE;
+	for (i=0;i<numAttrs;i++)
+		pAttrs[i].handle=tiHostNextHandle++;
+	tiHostServices[tiHostServiceNum].pAttrs=pAttrs;
+	tiHostServices[tiHostServiceNum].numAttrs=numAttrs;
+	tiHostServices[tiHostServiceNum].pCBs=pServiceCBs;
+	tiHostServiceNum++;
+	return SUCCESS;
+}
+
+bStatus_t GATTServApp_ProcessCCCWriteReq(uint16 connHandle, gattAttribute_t *pAttr, uint8 *pValue, uint8 len, uint16 offset, uint16 validCfg)
+{
+	gattCharCfg_t *charCfgTbl=(gattCharCfg_t *)pAttr->pValue;
+	gattCharCfg_t *pCfg;
+	uint16 value;
+	if (offset!=0)
+		return ATT_ERR_ATTR_NOT_LONG;
+	if (len!=2)
+		return ATT_ERR_INVALID_VALUE_SIZE;
+	value=BUILD_UINT16(pValue[0], pValue[1]);
+	if (value!=0 && value!=validCfg)
+		return ATT_ERR_INVALID_VALUE;
+	if ((pCfg=tiHostFindCharCfg(connHandle, charCfgTbl))==NULL
+		&& (pCfg=tiHostFindCharCfg(INVALID_CONNHANDLE, charCfgTbl))==NULL)
+		return ATT_ERR_INSUFFICIENT_RESOURCES;
+	pCfg->connHandle=connHandle;
+	pCfg->value=(uint8)value;
+	return SUCCESS;
+}
+
+bStatus_t GATTServApp_AddService(uint32 services)
+{
+	VOID services;
+	return SUCCESS;
+}
+
+/*
+ * Link database
+ */
+uint8 linkDB_Register(pfnLinkDBCB_t pFunc)
+{
+	uint8 i;
+	for (i=0;i<TI_HOST_LINKDB_CBS;i++)
+		if (tiHostLinkCBs[i]==NULL)
+		{
+			tiHostLinkCBs[i]=pFunc;
+			return SUCCESS;
+		}
+	return bleNoResources;
+}
+
+uint8 linkDB_Up(uint16 connectionHandle)
+{
+	return connectionHandle<GATT_MAX_NUM_CONN && tiHostLinks[connectionHandle].up;
+}
+
+uint8 linkDB_State(uint16 connectionHandle, uint8 state)
+{
+	linkDBItem_t *pItem=linkDB_Find(connectionHandle);
+	return (pItem!=NULL) && (pItem->stateFlags & state)==state;
+}
+
+uint8 linkDB_NumActive(void)
+{
+	uint8 i, num=0;
+	for (i=0;i<GATT_MAX_NUM_CONN;i++)
+		num+=tiHostLinks[i].up;
+	return num;
+}
+
+linkDBItem_t *linkDB_Find(uint16 connectionHandle)
+{
+	return linkDB_Up(connectionHandle) ? &tiHostLinks[connectionHandle].item : NULL;
+}
+
+void linkDB_PerformFunc(pfnPerformFuncCB_t cb)
+{
+	uint16 i;
+	for (i=0;i<GATT_MAX_NUM_CONN;i++)
+		if (tiHostLinks[i].up)
+			cb(i);
+}
+
+/*
+ * GAP, GAP role, bond manager
+ */
+bStatus_t GAP_SetParamValue(uint16 paramID, uint16 paramValue)
+{
+	VOID paramID;
+	VOID paramValue;
+	return SUCCESS;
+}
+
+uint16 GAP_GetParamValue(uint16 paramID)
+{
+	VOID paramID;
+	return 0;
+}
+
+bStatus_t GGS_AddService(uint32 services)
+{
+	VOID services;
+	return SUCCESS;
+}
+
+bStatus_t GGS_SetParameter(uint8 param, uint8 len, void *value)
+{
+	VOID param;
+	VOID len;
+	VOID value;
+	return SUCCESS;
+}
+
+bStatus_t GAPRole_SetParameter(uint16 param, uint8 len, void *pValue)
+{
+	VOID param;
+	VOID len;
+	VOID pValue;
+	return SUCCESS;
+}
+
+bStatus_t GAPRole_GetParameter(uint16 param, void *pValue)
+{
+	if (param==GAPROLE_CONNHANDLE)
+		*(uint16 *)pValue=tiHostLastConn;
+	else if (param==GAPROLE_ADVERT_ENABLED)
+		*(uint8 *)pValue=TRUE;
+	else
+		return INVALIDPARAMETER;
+	return SUCCESS;
+}
+
+bStatus_t GAPRole_StartDevice(gapRolesCBs_t *pAppCallbacks)
+{
+	pTiHostRoleCBs=pAppCallbacks;
+	if (pAppCallbacks!=NULL && pAppCallbacks->pfnStateChange!=NULL)
+		pAppCallbacks->pfnStateChange(GAPROLE_ADVERTISING);
+	return SUCCESS;
+}
+
+bStatus_t GAPBondMgr_SetParameter(uint16 param, uint8 len, void *pValue)
+{
+	VOID param;
+	VOID len;
+	VOID pValue;
+	return SUCCESS;
+}
+
+bStatus_t GAPBondMgr_Register(gapBondCBs_t *pCB)
+{
+	VOID pCB;
+	return SUCCESS;
+}
+
+bStatus_t GAPBondMgr_PasscodeRsp(uint16 connectionHandle, uint8 status, uint32 passcode)
+{
+	VOID connectionHandle;
+	VOID status;
+	VOID passcode;
+	return SUCCESS;
+}
+
+/*
+ * Device information and battery services
+ */
+bStatus_t DevInfo_AddService(void)
+{
+	return SUCCESS;
+}
+
+bStatus_t DevInfo_SetParameter(uint8 param, uint8 len, void *value)
+{
+	VOID param;
+	VOID len;
+	VOID value;
+	return SUCCESS;
+}
+
+bStatus_t Batt_AddService(void)
+{
+	return SUCCESS;
+}
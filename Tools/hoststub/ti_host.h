@@ -0,0 +1,336 @@
+/*!
+\file		ti_host.h
+\brief		This file contains host stand-ins for the parts of the TI BLE stack the CGM sources use.
+\details	It declares the types, constants and functions of OSAL, HAL, GAP and GATT that Source/cgm.c and
+		Profiles/CGM/cgmservice.h refer to, with the values of the CC254x stack where they matter. The other
+		headers of this directory carry the names of the stack headers and only include this one, so that the
+		sources build on a host for the tools under Tools/. ti_host.c defines the functions as an in-process stack
+		with one OSAL task, a virtual millisecond clock and a TX buffer budget per connection event, and the
+		tiHost functions declared at the end drive it in the place of the radio and the collectors.
+\author		Harry Qiu
+\version        1
+\date		2015-March-20
+\copyright	MIT License (MIT)\n
+ Copyright (c) 2014-2015 Center for Global ehealthinnovation
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions: The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef __TI_HOST__
+#define __TI_HOST__
+
+#include <string.h>
+
+/*
+ * hal_types.h, comdef.h, bcomdef.h
+ */
+typedef unsigned char	uint8;
+typedef signed char	int8;
+typedef unsigned short	uint16;
+typedef short		int16;
+typedef unsigned int	uint32;
+typedef int		int32;
+typedef uint32		uint24;
+typedef uint8		bool;
+typedef uint8		halIntState_t;
+typedef uint8		bStatus_t;
+typedef uint8		hciStatus_t;
+
+#define TRUE			1
+#define FALSE			0
+#define true			1
+#define false			0
+#define VOID			(void)
+#define CONST			const
+
+#define SUCCESS			0x00
+#define FAILURE			0x01
+#define INVALIDPARAMETER	0x02
+#define MSG_BUFFER_NOT_AVAIL	0x04
+#define INVALID_EVENT_ID	0x06
+#define NO_TIMER_AVAIL		0x08
+#define bleNotReady		0x10
+#define bleMemAllocError	0x13
+#define bleNoResources		0x11
+#define bleNotConnected		0x14
+#define blePending		0x17
+
+#define LO_UINT16(a)		((a) & 0xFF)
+#define HI_UINT16(a)		(((a) >> 8) & 0xFF)
+#define BUILD_UINT16(lo, hi)	((uint16)(((lo) & 0xFF) + (((hi) & 0xFF) << 8)))
+#define BUILD_UINT8(hi, lo)	((uint8)(((lo) & 0x0F) + (((hi) & 0x0F) << 4)))
+#define BREAK_UINT32(v, n)	(((v) >> ((n)*8)) & 0xFF)
+#define BUILD_UINT32(a,b,c,d)	((uint32)(((uint32)(a)&0xFF)+(((uint32)(b)&0xFF)<<8)+(((uint32)(c)&0xFF)<<16)+(((uint32)(d)&0xFF)<<24)))
+
+#define B_ADDR_LEN		6
+#define INVALID_CONNHANDLE	0xFFFF
+#define LOOPBACK_CONNHANDLE	0xFFFE
+
+/*
+ * OSAL.h, OSAL_Clock.h
+ */
+#define INVALID_TASK_ID		0xFF
+#define SYS_EVENT_MSG		0x8000
+#define KEY_CHANGE		0xC0
+#define NV_OPER_FAILED		0x0A
+
+typedef uint32 UTCTime;
+
+typedef struct {
+	uint8	seconds;
+	uint8	minutes;
+	uint8	hour;
+	uint8	day;
+	uint8	month;
+	uint16	year;
+} UTCTimeStruct;
+
+typedef struct {
+	uint8	event;
+	uint8	status;
+} osal_event_hdr_t;
+
+uint8	osal_set_event(uint8 task_id, uint16 event_flag);
+uint8	osal_clear_event(uint8 task_id, uint16 event_flag);
+uint8	osal_start_timerEx(uint8 task_id, uint16 event_id, uint32 timeout_value);
+uint8	osal_stop_timerEx(uint8 task_id, uint16 event_id);
+uint32	osal_get_timeoutEx(uint8 task_id, uint16 event_id);
+uint8	*osal_msg_allocate(uint16 len);
+uint8	osal_msg_send(uint8 destination_task, uint8 *msg_ptr);
+uint8	*osal_msg_receive(uint8 task_id);
+uint8	osal_msg_deallocate(uint8 *msg_ptr);
+void	*osal_mem_alloc(uint16 size);
+void	osal_mem_free(void *ptr);
+void	*osal_memcpy(void *dst, const void *src, unsigned int len);
+void	*osal_memset(void *dest, uint8 value, int len);
+uint8	osal_memcmp(const void *src1, const void *src2, unsigned int len);
+UTCTime	osal_getClock(void);
+void	osal_setClock(UTCTime newTime);
+void	osal_ConvertUTCTime(UTCTimeStruct *tm, UTCTime secTime);
+UTCTime	osal_ConvertUTCSecs(UTCTimeStruct *tm);
+uint32	osal_GetSystemClock(void);
+uint8	osal_snv_read(uint8 id, uint8 len, void *pBuf);
+uint8	osal_snv_write(uint8 id, uint8 len, void *pBuf);
+
+/*
+ * hal_key.h, hal_led.h, OnBoard.h
+ */
+#define HAL_KEY_SW_1		0x01
+#define HAL_KEY_SW_2		0x02
+#define HAL_LED_1		0x01
+#define HAL_LED_2		0x02
+#define HAL_LED_MODE_OFF	0x00
+
+typedef struct {
+	osal_event_hdr_t	hdr;
+	uint8			state;
+	uint8			keys;
+} keyChange_t;
+
+uint8	RegisterForKeys(uint8 task_id);
+uint8	HalLedSet(uint8 led, uint8 mode);
+
+/*
+ * att.h, gatt.h, gatt_uuid.h, gattservapp.h
+ */
+#define ATT_BT_UUID_SIZE		2
+#define ATT_MTU_SIZE			23
+#define ATT_ERR_ATTR_NOT_FOUND		0x0A
+#define ATT_ERR_ATTR_NOT_LONG		0x0B
+#define ATT_ERR_INVALID_VALUE_SIZE	0x0D
+#define ATT_ERR_INSUFFICIENT_RESOURCES	0x11
+#define ATT_ERR_INVALID_VALUE		0x80
+#define GATT_MAX_NUM_CONN		3
+#define GATT_CLIENT_CFG_NOTIFY		0x0001
+#define GATT_CLIENT_CFG_INDICATE	0x0002
+#define GATT_PROP_READ			0x02
+#define GATT_PROP_WRITE			0x08
+#define GATT_PROP_NOTIFY		0x10
+#define GATT_PROP_INDICATE		0x20
+#define GATT_PERMIT_READ		0x01
+#define GATT_PERMIT_WRITE		0x02
+#define GATT_ALL_SERVICES		0xFFFFFFFF
+#define GATT_CLIENT_CHAR_CFG_UUID	0x2902
+#define GATT_NUM_ATTRS(attrs)		(sizeof(attrs) / sizeof(attrs[0]))
+
+typedef struct {
+	uint16	handle;
+	uint8	len;
+	uint8	value[ATT_MTU_SIZE-3];
+} attHandleValueNoti_t;
+
+typedef struct {
+	uint16	handle;
+	uint8	len;
+	uint8	value[ATT_MTU_SIZE-3];
+} attHandleValueInd_t;
+
+typedef struct {
+	uint16	connHandle;
+	uint8	value;
+} gattCharCfg_t;
+
+typedef struct {
+	uint8		len;
+	const uint8	*uuid;
+} gattAttrType_t;
+
+typedef struct {
+	gattAttrType_t	type;
+	uint8		permissions;
+	uint16		handle;
+	uint8 * const	pValue;
+} gattAttribute_t;
+
+typedef uint8 (*pfnGATTReadAttrCB_t)(uint16 connHandle, gattAttribute_t *pAttr, uint8 *pValue, uint8 *pLen, uint16 offset, uint8 maxLen);
+typedef bStatus_t (*pfnGATTWriteAttrCB_t)(uint16 connHandle, gattAttribute_t *pAttr, uint8 *pValue, uint8 len, uint16 offset);
+
+typedef struct {
+	pfnGATTReadAttrCB_t	pfnReadAttrCB;
+	pfnGATTWriteAttrCB_t	pfnWriteAttrCB;
+	void			*pfnAuthorizeAttrCB;
+} gattServiceCBs_t;
+
+extern const uint8 primaryServiceUUID[];
+extern const uint8 characterUUID[];
+extern const uint8 clientCharCfgUUID[];
+
+bStatus_t	GATT_Notification(uint16 connHandle, attHandleValueNoti_t *pNoti, uint8 authenticated);
+bStatus_t	GATT_Indication(uint16 connHandle, attHandleValueInd_t *pInd, uint8 authenticated, uint8 taskId);
+bStatus_t	GATT_InitClient(void);
+bStatus_t	GATT_RegisterForInd(uint8 taskId);
+uint16		GATTServApp_ReadCharCfg(uint16 connHandle, gattCharCfg_t *charCfgTbl);
+void		GATTServApp_InitCharCfg(uint16 connHandle, gattCharCfg_t *charCfgTbl);
+bStatus_t	GATTServApp_RegisterService(gattAttribute_t *pAttrs, uint16 numAttrs, const gattServiceCBs_t *pServiceCBs);
+bStatus_t	GATTServApp_ProcessCCCWriteReq(uint16 connHandle, gattAttribute_t *pAttr, uint8 *pValue, uint8 len, uint16 offset, uint16 validCfg);
+bStatus_t	GATTServApp_AddService(uint32 services);
+
+/*
+ * linkdb.h
+ */
+#define LINKDB_STATUS_UPDATE_NEW	0
+#define LINKDB_STATUS_UPDATE_REMOVED	1
+#define LINKDB_STATUS_UPDATE_STATEFLAGS	2
+#define LINK_CONNECTED			0x01
+#define LINK_BOUND			0x02
+
+typedef struct {
+	uint8	taskID;
+	uint16	connectionHandle;
+	uint8	stateFlags;
+	uint8	addrType;
+	uint8	addr[B_ADDR_LEN];
+	uint16	connInterval;
+} linkDBItem_t;
+
+typedef void (*pfnLinkDBCB_t)(uint16 connectionHandle, uint8 changeType);
+typedef void (*pfnPerformFuncCB_t)(uint16 connectionHandle);
+
+uint8		linkDB_Register(pfnLinkDBCB_t pFunc);
+uint8		linkDB_Up(uint16 connectionHandle);
+uint8		linkDB_State(uint16 connectionHandle, uint8 state);
+uint8		linkDB_NumActive(void);
+linkDBItem_t	*linkDB_Find(uint16 connectionHandle);
+void		linkDB_PerformFunc(pfnPerformFuncCB_t cb);
+
+/*
+ * gap.h, gapgattserver.h, peripheral.h, gapbondmgr.h
+ */
+#define GAP_DEVICE_NAME_LEN			21
+#define GAP_ADTYPE_FLAGS			0x01
+#define GAP_ADTYPE_16BIT_MORE			0x02
+#define GAP_ADTYPE_FLAGS_LIMITED		0x01
+#define GAP_ADTYPE_FLAGS_BREDR_NOT_SUPPORTED	0x04
+#define GAPBOND_PAIRING_MODE_NO_PAIRING		0x00
+#define GAPBOND_IO_CAP_DISPLAY_ONLY		0x00
+#define GAPBOND_PAIRING_STATE_COMPLETE		0x01
+#define GAPBOND_PAIRING_STATE_BONDED		0x02
+
+enum {
+	GAPROLE_ADVERT_ENABLED, GAPROLE_ADVERT_OFF_TIME, GAPROLE_SCAN_RSP_DATA, GAPROLE_ADVERT_DATA,
+	GAPROLE_PARAM_UPDATE_ENABLE, GAPROLE_MIN_CONN_INTERVAL, GAPROLE_MAX_CONN_INTERVAL, GAPROLE_SLAVE_LATENCY,
+	GAPROLE_TIMEOUT_MULTIPLIER, GAPROLE_BD_ADDR, GAPROLE_CONNHANDLE, GGS_DEVICE_NAME_ATT,
+	GAPBOND_DEFAULT_PASSCODE, GAPBOND_PAIRING_MODE, GAPBOND_MITM_PROTECTION, GAPBOND_IO_CAPABILITIES,
+	GAPBOND_BONDING_ENABLED, TGAP_LIM_DISC_ADV_INT_MIN, TGAP_LIM_DISC_ADV_INT_MAX, TGAP_LIM_ADV_TIMEOUT
+};
+
+typedef enum {
+	GAPROLE_INIT, GAPROLE_STARTED, GAPROLE_ADVERTISING, GAPROLE_WAITING, GAPROLE_WAITING_AFTER_TIMEOUT,
+	GAPROLE_CONNECTED
+} gaprole_States_t;
+
+typedef void (*gapRolesStateNotify_t)(gaprole_States_t newState);
+
+typedef struct {
+	gapRolesStateNotify_t	pfnStateChange;
+	void			*pfnRssiRead;
+} gapRolesCBs_t;
+
+typedef struct {
+	void	(*passcodeCB)(uint8 *deviceAddr, uint16 connectionHandle, uint8 uiInputs, uint8 uiOutputs);
+	void	(*pairStateCB)(uint16 connectionHandle, uint8 state, uint8 status);
+} gapBondCBs_t;
+
+bStatus_t	GAP_SetParamValue(uint16 paramID, uint16 paramValue);
+uint16		GAP_GetParamValue(uint16 paramID);
+bStatus_t	GGS_AddService(uint32 services);
+bStatus_t	GGS_SetParameter(uint8 param, uint8 len, void *value);
+bStatus_t	GAPRole_SetParameter(uint16 param, uint8 len, void *pValue);
+bStatus_t	GAPRole_GetParameter(uint16 param, void *pValue);
+bStatus_t	GAPRole_StartDevice(gapRolesCBs_t *pAppCallbacks);
+bStatus_t	GAPBondMgr_SetParameter(uint16 param, uint8 len, void *pValue);
+bStatus_t	GAPBondMgr_Register(gapBondCBs_t *pCB);
+bStatus_t	GAPBondMgr_PasscodeRsp(uint16 connectionHandle, uint8 status, uint32 passcode);
+
+/*
+ * hci.h
+ */
+hciStatus_t	HCI_EXT_ConnEventNoticeCmd(uint8 taskID, uint16 taskEvent);
+
+/*
+ * devinfoservice.h, battservice.h
+ */
+#define DEVINFO_SERV_UUID	0x180A
+#define DEVINFO_SYSTEM_ID	0
+#define DEVINFO_SYSTEM_ID_LEN	8
+
+bStatus_t	DevInfo_AddService(void);
+bStatus_t	DevInfo_SetParameter(uint8 param, uint8 len, void *value);
+bStatus_t	Batt_AddService(void);
+
+/*
+ * Host controls, defined in ti_host.c
+ */
+#define TI_HOST_TX_BUFS		4	///< The number of PDUs the link layer takes from a connection per connection event
+#define TI_HOST_CONN_INTERVAL	30	///< The connection interval of every link, in ms
+
+/// \brief The counters of the stand-in stack.
+typedef struct {
+	uint32	dispatches;		///< The calls of the task event processor.
+	uint32	connEvents;		///< The connection events, over all links.
+	uint32	notifications;		///< The notifications accepted.
+	uint32	indications;		///< The indications accepted.
+	uint32	txRefused;		///< The notifications and indications refused for lack of TX buffers.
+} tiHostStats_t;
+
+/// \brief The function called with every notification or indication the stand-in stack accepts.
+typedef void (*tiHostPduCB_t)(uint16 connHandle, uint16 handle, uint8 *pValue, uint8 len, uint8 indication);
+
+typedef uint16 (*tiHostProcessEvent_t)(uint8 task_id, uint16 events);
+
+extern tiHostStats_t	tiHostStats;
+extern tiHostPduCB_t	tiHostPduCB;
+
+uint8		tiHostInit(tiHostProcessEvent_t pfnProcessEvent);
+void		tiHostRun(uint32 ms);
+uint32		tiHostNow(void);
+void		tiHostConnect(uint16 connHandle);
+void		tiHostDisconnect(uint16 connHandle);
+bStatus_t	tiHostWriteChar(uint16 connHandle, uint16 uuid, uint8 *pValue, uint8 len);
+bStatus_t	tiHostWriteCCC(uint16 connHandle, uint16 uuid, uint16 cfg);
+
+#endif
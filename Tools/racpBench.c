@@ -0,0 +1,459 @@
+/*!
+\file		racpBench.c
+\brief		This file contains a host benchmark of the RACP record transfer, its abort and the live measurements that preempt it.
+\details	Usage: racpBench [transfers]\n
+		The tool includes cgm.c and replaces the stack with the stand-ins of this file: one connection, whose link
+		layer takes BENCH_TX_BUFS PDUs per connection event. Each transfer (200 by default) fills the history
+		database, reports all its records, and takes a live measurement every 7th connection event; every other
+		transfer is aborted at a random record. The tool times each cgmTxSchedRun call and each abort with the
+		host clock, and prints the average and worst run, the worst abort, and the most PDUs queued between an abort
+		request and its response. It exits with 1 when a record is sent out of order, a record is queued after the
+		abort response, or a live measurement is lost, and with 0 otherwise.
+		The times are those of the host, not of the 8051; they compare versions of cgm.c rather than predict the target.
+		Build it with: cc -O2 -Ihoststub -I../Source -I../Profiles/CGM -DCGM_MEAS_DB_SIZE=500 -o racpBench racpBench.c ../Source/crc.c ../Source/cgmSimData.c ../Source/cgmTrace.c ../Source/sfloat.c
+\author		Harry Qiu
+\version        1
+\date		2015-March-20
+\copyright	MIT License (MIT)\n
+ Copyright (c) 2014-2015 Center for Global ehealthinnovation
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions: The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../Source/cgm.c"
+
+#define BENCH_TX_BUFS		3	///< The number of PDUs the link layer takes per connection event
+#define BENCH_LIVE_EVERY	7	///< The number of connection events between two live measurements
+#define BENCH_CONN		0	///< The handle of the only connection
+
+static int	benchTxFree;		///< The TX buffers left in the current connection event
+static long	benchQueued;		///< The number of PDUs queued since the start of the transfer
+static long	benchRspAt;		///< The value of benchQueued when the RACP response was indicated, or -1
+static long	benchLiveTx;		///< The number of live measurements queued in the transfer
+static int	benchRecSeen;		///< Non zero once the transfer has queued a record
+static uint16	benchRecLast;		///< The time offset of the last record queued
+static long	benchOrderBad;		///< The number of records queued out of order
+static long	benchAfterRsp;		///< The number of records queued after the response ending the transfer
+static UTCTime	benchClock;		///< The time of osal_getClock
+
+/*
+ * The stack stand-ins reached by cgm.c
+ */
+void *osal_mem_alloc(uint16 size)
+{
+	return malloc(size);
+}
+
+void osal_mem_free(void *ptr)
+{
+	free(ptr);
+}
+
+void *osal_memcpy(void *dst, const void *src, unsigned int len)
+{
+	return memcpy(dst, src, len);
+}
+
+void *osal_memset(void *dest, uint8 value, int len)
+{
+	return memset(dest, value, len);
+}
+
+uint8 osal_memcmp(const void *src1, const void *src2, unsigned int len)
+{
+	return memcmp(src1, src2, len)==0;
+}
+
+uint8 osal_set_event(uint8 task_id, uint16 event_flag)
+{
+	VOID task_id;
+	VOID event_flag;
+	return SUCCESS;
+}
+
+uint8 osal_clear_event(uint8 task_id, uint16 event_flag)
+{
+	VOID task_id;
+	VOID event_flag;
+	return SUCCESS;
+}
+
+uint8 osal_start_timerEx(uint8 task_id, uint16 event_id, uint32 timeout_value)
+{
+	VOID task_id;
+	VOID event_id;
+	VOID timeout_value;
+	return SUCCESS;
+}
+
+uint8 osal_stop_timerEx(uint8 task_id, uint16 event_id)
+{
+	VOID task_id;
+	VOID event_id;
+	return SUCCESS;
+}
+
+uint32 osal_get_timeoutEx(uint8 task_id, uint16 event_id)
+{
+	VOID task_id;
+	VOID event_id;
+	return 0;
+}
+
+uint8 *osal_msg_allocate(uint16 len)
+{
+	return malloc(len);
+}
+
+uint8 osal_msg_send(uint8 destination_task, uint8 *msg_ptr)
+{
+	VOID destination_task;
+	free(msg_ptr);
+	return SUCCESS;
+}
+
+uint8 *osal_msg_receive(uint8 task_id)
+{
+	VOID task_id;
+	return NULL;
+}
+
+uint8 osal_msg_deallocate(uint8 *msg_ptr)
+{
+	free(msg_ptr);
+	return SUCCESS;
+}
+
+UTCTime osal_getClock(void)
+{
+	return benchClock;
+}
+
+void osal_setClock(UTCTime newTime)
+{
+	benchClock=newTime;
+}
+
+void osal_ConvertUTCTime(UTCTimeStruct *tm, UTCTime secTime)
+{
+	memset(tm, 0, sizeof(*tm));
+	tm->seconds=secTime%60;
+	tm->minutes=(secTime/60)%60;
+	tm->hour=(secTime/3600)%24;
+	tm->year=2000;
+}
+
+UTCTime osal_ConvertUTCSecs(UTCTimeStruct *tm)
+{
+	return tm->seconds+60*(tm->minutes+60*(UTCTime)tm->hour);
+}
+
+uint8 osal_snv_read(uint8 id, uint8 len, void *pBuf)
+{
+	VOID id;
+	VOID len;
+	VOID pBuf;
+	return NV_OPER_FAILED;
+}
+
+uint8 osal_snv_write(uint8 id, uint8 len, void *pBuf)
+{
+	VOID id;
+	VOID len;
+	VOID pBuf;
+	return SUCCESS;
+}
+
+hciStatus_t HCI_EXT_ConnEventNoticeCmd(uint8 taskID, uint16 taskEvent)
+{
+	VOID taskID;
+	VOID taskEvent;
+	return SUCCESS;
+}
+
+bool CGM_SetSendState(uint16 connHandle, bool input)
+{
+	VOID connHandle;
+	return input;
+}
+
+/// Queues a notification on the only connection while it has TX buffers left, and checks the order of the records.
+bStatus_t CGM_MeasSend(uint16 connHandle, attHandleValueNoti_t *pNoti, uint8 taskId)
+{
+	uint16 offset;
+
+	VOID taskId;
+	if (connHandle!=BENCH_CONN)
+		return bleNotConnected;
+	if (!benchTxFree)
+		return MSG_BUFFER_NOT_AVAIL;
+	benchTxFree--;
+	benchQueued++;
+	if (pNoti==&CGMMeas)
+	{
+		benchLiveTx++;
+		return SUCCESS;
+	}
+	offset=BUILD_UINT16(pNoti->value[4], pNoti->value[5]);
+	if (benchRecSeen && offset<=benchRecLast)
+		benchOrderBad++;
+	if (benchRspAt>=0)
+		benchAfterRsp++;
+	benchRecLast=offset;
+	benchRecSeen=1;
+	return SUCCESS;
+}
+
+uint8 CGM_MeasBroadcast(uint8 connMask, attHandleValueNoti_t *pNoti)
+{
+	bStatus_t status;
+
+	if (!(connMask & CGM_CONN_BIT(BENCH_CONN)))
+		return 0;
+	status=CGM_MeasSend(BENCH_CONN, pNoti, 0);
+	return CGM_TX_BUSY(status) ? CGM_CONN_BIT(BENCH_CONN) : 0;
+}
+
+bStatus_t CGM_CtlPntIndicate(uint16 connHandle, attHandleValueInd_t *pInd, uint8 taskId)
+{
+	VOID connHandle;
+	VOID pInd;
+	VOID taskId;
+	return SUCCESS;
+}
+
+/// Records how many PDUs were queued when the response ending the transfer, or its abort, was indicated.
+bStatus_t CGM_RACPIndicate(uint16 connHandle, attHandleValueInd_t *pInd, uint8 taskId)
+{
+	VOID connHandle;
+	VOID taskId;
+	if (pInd->value[0]==CTL_PNT_OP_REQ_RSP && (pInd->value[2]==CTL_PNT_OP_REQ || pInd->value[2]==CTL_PNT_OP_ABORT))
+		benchRspAt=benchQueued;
+	return SUCCESS;
+}
+
+/*
+ * The stand-ins of the set-up and GAP calls of cgm.c, which the benchmark does not reach
+ */
+bStatus_t GAP_SetParamValue(uint16 paramID, uint16 paramValue)
+{
+	VOID paramID;
+	VOID paramValue;
+	return SUCCESS;
+}
+
+uint16 GAP_GetParamValue(uint16 paramID)
+{
+	VOID paramID;
+	return 0;
+}
+
+bStatus_t GAPRole_SetParameter(uint16 param, uint8 len, void *pValue)
+{
+	VOID param;
+	VOID len;
+	VOID pValue;
+	return SUCCESS;
+}
+
+bStatus_t GAPRole_GetParameter(uint16 param, void *pValue)
+{
+	VOID param;
+	VOID pValue;
+	return FAILURE;
+}
+
+bStatus_t GAPRole_StartDevice(gapRolesCBs_t *pAppCallbacks)
+{
+	VOID pAppCallbacks;
+	return SUCCESS;
+}
+
+bStatus_t GAPBondMgr_SetParameter(uint16 param, uint8 len, void *pValue)
+{
+	VOID param;
+	VOID len;
+	VOID pValue;
+	return SUCCESS;
+}
+
+bStatus_t GAPBondMgr_Register(gapBondCBs_t *pCB)
+{
+	VOID pCB;
+	return SUCCESS;
+}
+
+bStatus_t GAPBondMgr_PasscodeRsp(uint16 connectionHandle, uint8 status, uint32 passcode)
+{
+	VOID connectionHandle;
+	VOID status;
+	VOID passcode;
+	return SUCCESS;
+}
+
+bStatus_t GGS_AddService(uint32 services)
+{
+	VOID services;
+	return SUCCESS;
+}
+
+bStatus_t GGS_SetParameter(uint8 param, uint8 len, void *value)
+{
+	VOID param;
+	VOID len;
+	VOID value;
+	return SUCCESS;
+}
+
+bStatus_t GATTServApp_AddService(uint32 services)
+{
+	VOID services;
+	return SUCCESS;
+}
+
+bStatus_t GATT_InitClient(void)
+{
+	return SUCCESS;
+}
+
+bStatus_t GATT_RegisterForInd(uint8 taskId)
+{
+	VOID taskId;
+	return SUCCESS;
+}
+
+bStatus_t DevInfo_AddService(void)
+{
+	return SUCCESS;
+}
+
+bStatus_t DevInfo_SetParameter(uint8 param, uint8 len, void *value)
+{
+	VOID param;
+	VOID len;
+	VOID value;
+	return SUCCESS;
+}
+
+bStatus_t Batt_AddService(void)
+{
+	return SUCCESS;
+}
+
+linkDBItem_t *linkDB_Find(uint16 connectionHandle)
+{
+	VOID connectionHandle;
+	return NULL;
+}
+
+bStatus_t CGM_AddService(uint32 services)
+{
+	VOID services;
+	return SUCCESS;
+}
+
+void CGM_Register(CGMServiceCB_t pfnServiceCB)
+{
+	VOID pfnServiceCB;
+}
+
+void CGM_MeasSubscriberSync(uint16 connHandle)
+{
+	VOID connHandle;
+}
+
+/*
+ * The benchmark
+ */
+static double benchNow(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec*1e9+t.tv_nsec;
+}
+
+int main(int argc, char *argv[])
+{
+	long transfers=(argc>1) ? atol(argv[1]) : 200;
+	long trial, ev, abortAt, lives, worstQueued=0, lost=0, runs=0;
+	double t0, d, sumRun=0, worstRun=0, worstAbort=0;
+	cgmSensor_t *pSensor=&cgmSensor;
+	cgmRACPMsg_t abortMsg;
+	int i;
+
+	srand(1);
+	for (trial=0; trial<transfers; trial++)
+	{
+		cgmSensorInit(pSensor, CGM_MEAS_DB_SIZE);
+		cgmSessionFind(pSensor, BENCH_CONN, true);
+		for (i=0; i<CGM_MEAS_DB_SIZE; i++)
+		{
+			cgmNewGlucoseMeas(pSensor, &pSensor->currentMeas);
+			cgmAddRecord(pSensor, &pSensor->currentMeas);
+		}
+		benchTxFree=BENCH_TX_BUFS;
+		benchQueued=0;
+		benchRspAt=-1;
+		benchLiveTx=0;
+		benchRecSeen=0;
+		cgmSearchMeasDB(pSensor, &pSensor->session[0], CTL_PNT_OPER_ALL, 0, 0);
+		cgmRACPStartSend(pSensor, &pSensor->session[0]);
+		abortAt=(trial%2) ? rand()%(CGM_MEAS_DB_SIZE/BENCH_TX_BUFS) : -1;
+		lives=0;
+		for (ev=0; pSensor->session[0].racp.state || pSensor->tx.livePending; ev++)
+		{
+			benchTxFree=BENCH_TX_BUFS;	// A connection event: the link layer sent what was queued
+			if (ev==abortAt)
+			{
+				long before=benchQueued;
+
+				memset(&abortMsg, 0, sizeof(abortMsg));
+				abortMsg.connHandle=BENCH_CONN;
+				abortMsg.len=2;
+				abortMsg.data[0]=CTL_PNT_OP_ABORT;
+				t0=benchNow();
+				cgmProcessRACPMsg(&abortMsg);
+				d=benchNow()-t0;
+				if (d>worstAbort)
+					worstAbort=d;
+				if (benchRspAt<0)
+					benchAfterRsp++;
+				else if (benchRspAt-before>worstQueued)
+					worstQueued=benchRspAt-before;
+				continue;
+			}
+			t0=benchNow();
+			cgmTxSchedRun(pSensor);
+			d=benchNow()-t0;
+			sumRun+=d;
+			runs++;
+			if (d>worstRun)
+				worstRun=d;
+			if (ev%BENCH_LIVE_EVERY==BENCH_LIVE_EVERY-1)
+			{
+				cgmNewGlucoseMeas(pSensor, &pSensor->currentMeas);
+				cgmAddRecord(pSensor, &pSensor->currentMeas);
+				cgmMeasSend(pSensor);
+				lives++;
+			}
+		}
+		if (benchLiveTx+pSensor->tx.liveSuperseded!=lives)
+			lost+=lives-benchLiveTx-pSensor->tx.liveSuperseded;
+	}
+	printf("%ld transfers of %d records, %d TX buffers per connection event\n", transfers, CGM_MEAS_DB_SIZE, BENCH_TX_BUFS);
+	printf("run: average %.0f ns, worst %.0f ns\n", runs ? sumRun/runs : 0, worstRun);
+	printf("abort: worst %.0f ns, at most %ld PDUs queued before the response\n", worstAbort, worstQueued);
+	printf("records out of order %ld, records after the abort response %ld, live measurements lost %ld\n", benchOrderBad, benchAfterRsp, lost);
+	return (benchOrderBad || benchAfterRsp || lost) ? 1 : 0;
+}
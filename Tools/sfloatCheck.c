@@ -0,0 +1,250 @@
+/*!
+\file		sfloatCheck.c
+\brief		This file contains a host tool checking the SFLOAT arithmetic of sfloat.c over all the 65,536 encodings.
+\details	Usage: sfloatCheck [operands]\n
+		Every encoding is checked for its classification, normalization, scaling to integers and re-encoding, and
+		is compared with and added to the special values and a fixed random set of operands (512 by default).
+		The results are checked against an exact reference working on 64-bit integers in units of 10^-8, the
+		smallest exponent. The tool prints the first mismatch and exits with 1, or exits with 0 when all agree.
+		Build it with: cc -I../Source -o sfloatCheck sfloatCheck.c ../Source/sfloat.c
+\author		Harry Qiu
+\version        1
+\date		2015-March-20
+\copyright	MIT License (MIT)\n
+ Copyright (c) 2014-2015 Center for Global ehealthinnovation
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions: The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "sfloat.h"
+
+#define CHECK_SCALE	8	///< The reference values are integers in units of 10^-CHECK_SCALE
+#define CHECK_OPERANDS	512	///< The default number of random operands each encoding is compared with and added to
+
+/// \brief The reference class of an encoding.
+typedef enum { CHECK_FINITE, CHECK_NAN, CHECK_POS_INF, CHECK_NEG_INF } checkClass_t;
+
+/**
+@brief The reference class of an encoding.
+@param value - the SFLOAT.
+@return its class.*/
+static checkClass_t checkClass(SFLOAT value)
+{
+	switch (value)
+	{
+	case SFLOAT_NAN: case SFLOAT_NRES: case SFLOAT_RESERVED:
+		return CHECK_NAN;
+	case SFLOAT_POS_INFINITY:
+		return CHECK_POS_INF;
+	case SFLOAT_NEG_INFINITY:
+		return CHECK_NEG_INF;
+	default:
+		return CHECK_FINITE;
+	}
+}
+
+/**
+@brief 10 to a power.
+@param n - the power, 0 to 18.
+@return 10^n.*/
+static long long checkPow10(int n)
+{
+	long long p=1;
+	while (n-->0)
+		p*=10;
+	return p;
+}
+
+/**
+@brief The exact value of a finite encoding.
+@param value - the SFLOAT.
+@return the value in units of 10^-CHECK_SCALE.*/
+static long long checkExact(SFLOAT value)
+{
+	int mantissa=(value&0x0800) ? (int)(value&0x0FFF)-0x1000 : (int)(value&0x0FFF);
+	int exponent=(value&0x8000) ? (int)(value>>12)-16 : (int)(value>>12);
+	return mantissa*checkPow10(exponent+CHECK_SCALE);
+}
+
+/**
+@brief Divide by a power of ten, rounding half away from zero.
+@param value - the dividend.
+@param decades - the power of ten.
+@return the rounded quotient.*/
+static long long checkDivRound(long long value, int decades)
+{
+	long long divisor=checkPow10(decades);
+	long long quotient=value/divisor, remainder=value%divisor;
+	if (2*remainder>=divisor)
+		quotient++;
+	else if (-2*remainder>=divisor)
+		quotient--;
+	return quotient;
+}
+
+/**
+@brief The reference encoding of an exact value: the smallest exponent whose rounded mantissa fits.
+@param exact - the value in units of 10^-CHECK_SCALE.
+@return the SFLOAT.*/
+static SFLOAT checkEncode(long long exact)
+{
+	int exponent;
+	long long mantissa;
+	for (exponent=SFLOAT_EXPONENT_MIN;exponent<=SFLOAT_EXPONENT_MAX;exponent++)
+	{
+		mantissa=checkDivRound(exact, exponent+CHECK_SCALE);
+		if (exponent==0 ? (mantissa>=-SFLOAT_MANTISSA_MAX && mantissa<=SFLOAT_MANTISSA_MAX)
+				: (mantissa>=SFLOAT_MANTISSA_MIN_EXP && mantissa<=SFLOAT_MANTISSA_MAX_EXP))
+			return (SFLOAT)(((unsigned)exponent<<12) | ((unsigned)mantissa & 0x0FFF));
+	}
+	return (exact>0) ? SFLOAT_POS_INFINITY : SFLOAT_NEG_INFINITY;
+}
+
+/**
+@brief The reference comparison.
+@param a - the first SFLOAT.
+@param b - the second SFLOAT.
+@return the result sfloatCompare should return.*/
+static signed char checkCompare(SFLOAT a, SFLOAT b)
+{
+	checkClass_t ca=checkClass(a), cb=checkClass(b);
+	int ra, rb;
+	long long ea, eb;
+	if (ca==CHECK_NAN || cb==CHECK_NAN)
+		return SFLOAT_UNORDERED;
+	ra=(ca==CHECK_POS_INF) ? 1 : ((ca==CHECK_NEG_INF) ? -1 : 0);
+	rb=(cb==CHECK_POS_INF) ? 1 : ((cb==CHECK_NEG_INF) ? -1 : 0);
+	if (ra!=0 || rb!=0)
+		return (ra>rb) ? 1 : ((ra<rb) ? -1 : 0);
+	ea=checkExact(a);
+	eb=checkExact(b);
+	return (ea>eb) ? 1 : ((ea<eb) ? -1 : 0);
+}
+
+/**
+@brief The reference sum.
+@param a - the first SFLOAT.
+@param b - the second SFLOAT.
+@return the result sfloatAdd should return.*/
+static SFLOAT checkAdd(SFLOAT a, SFLOAT b)
+{
+	checkClass_t ca=checkClass(a), cb=checkClass(b);
+	if (ca==CHECK_NAN || cb==CHECK_NAN)
+		return SFLOAT_NAN;
+	if ((ca==CHECK_POS_INF && cb==CHECK_NEG_INF) || (ca==CHECK_NEG_INF && cb==CHECK_POS_INF))
+		return SFLOAT_NAN;
+	if (ca==CHECK_POS_INF || cb==CHECK_POS_INF)
+		return SFLOAT_POS_INFINITY;
+	if (ca==CHECK_NEG_INF || cb==CHECK_NEG_INF)
+		return SFLOAT_NEG_INFINITY;
+	return checkEncode(checkExact(a)+checkExact(b));
+}
+
+/**
+@brief The reference difference, for a finite subtrahend.
+@param a - the SFLOAT subtracted from.
+@param b - the SFLOAT subtracted.
+@return the result sfloatSub should return.*/
+static SFLOAT checkEncodeSub(SFLOAT a, SFLOAT b)
+{
+	checkClass_t ca=checkClass(a);
+	if (ca!=CHECK_FINITE)
+		return (ca==CHECK_NAN) ? SFLOAT_NAN : a;
+	return checkEncode(checkExact(a)-checkExact(b));
+}
+
+/**
+@brief Tell whether a result is the reference one. Finite results need the same value only, as the exponent of a sum
+	 follows its operands.
+@param got - the result of sfloat.c.
+@param want - the reference result.
+@return 1 if they match, 0 otherwise.*/
+static unsigned char checkSame(SFLOAT got, SFLOAT want)
+{
+	if (checkClass(got)==CHECK_FINITE && checkClass(want)==CHECK_FINITE)
+		return (checkExact(got)==checkExact(want)) ? 1 : 0;
+	return (got==want) ? 1 : 0;
+}
+
+/**
+@brief Report a mismatch and exit.
+@param what - the function that disagrees.
+@param a - the first operand.
+@param b - the second operand, if any.
+@param got - the result of sfloat.c.
+@param want - the reference result.
+@return none*/
+static void checkFail(const char *what, SFLOAT a, SFLOAT b, long got, long want)
+{
+	printf("%s(0x%04x, 0x%04x) is %ld (0x%04lx) instead of %ld (0x%04lx)\n", what, a, b, got, got&0xFFFF, want, want&0xFFFF);
+	exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+	static const SFLOAT specials[]={0x0000, SFLOAT_NAN, SFLOAT_NRES, SFLOAT_RESERVED, SFLOAT_POS_INFINITY, SFLOAT_NEG_INFINITY,
+					0x07FD, 0x0803, 0x77FF, 0x7800, 0x8001, 0x87FF, 0x17FE, 0xF001};
+	int num=(argc>1) ? atoi(argv[1]) : CHECK_OPERANDS;
+	int nspecial=(int)(sizeof(specials)/sizeof(specials[0]));
+	SFLOAT *pOperands;
+	long a, i, checks=0;
+	int exponent;
+	long long want;
+
+	if ((pOperands=malloc(sizeof(SFLOAT)*(num+nspecial)))==NULL)
+		return 1;
+	srand(1);
+	for (i=0;i<nspecial;i++)
+		pOperands[i]=specials[i];
+	for (;i<num+nspecial;i++)
+		pOperands[i]=(SFLOAT)(rand()&0xFFFF);
+	for (a=0;a<0x10000;a++)
+	{
+		SFLOAT value=(SFLOAT)a;
+		checkClass_t cls=checkClass(value);
+		if (sfloatIsFinite(value)!=(cls==CHECK_FINITE))
+			checkFail("sfloatIsFinite", value, 0, sfloatIsFinite(value), cls==CHECK_FINITE);
+		if (cls==CHECK_FINITE)
+		{
+			//The normal form keeps the value, and is the same for all the encodings of it
+			SFLOAT normal=sfloatNormalize(value);
+			if (checkExact(normal)!=checkExact(value) || sfloatNormalize(normal)!=normal)
+				checkFail("sfloatNormalize", value, 0, normal, value);
+			if (normal!=sfloatNormalize(checkEncode(checkExact(value))))
+				checkFail("sfloatNormalize", value, 0, normal, sfloatNormalize(checkEncode(checkExact(value))));
+			//Every finite encoding is re-encoded exactly
+			if (sfloatEncode(SFLOAT_MANTISSA(value), SFLOAT_EXPONENT(value))!=value)
+				checkFail("sfloatEncode", value, 0, sfloatEncode(SFLOAT_MANTISSA(value), SFLOAT_EXPONENT(value)), value);
+			for (exponent=-3;exponent<=3;exponent++)
+			{
+				want=checkDivRound(checkExact(value), exponent+CHECK_SCALE);
+				if (want>SFLOAT_INT_MAX)
+					want=SFLOAT_INT_MAX;
+				else if (want<-SFLOAT_INT_MAX)
+					want=-SFLOAT_INT_MAX;
+				if (sfloatToInt(value, (signed char)exponent)!=want)
+					checkFail("sfloatToInt", value, (SFLOAT)exponent, sfloatToInt(value, (signed char)exponent), (long)want);
+			}
+		}
+		for (i=0;i<num+nspecial;i++)
+		{
+			SFLOAT b=pOperands[i];
+			if (sfloatCompare(value, b)!=checkCompare(value, b))
+				checkFail("sfloatCompare", value, b, sfloatCompare(value, b), checkCompare(value, b));
+			if (!checkSame(sfloatAdd(value, b), checkAdd(value, b)))
+				checkFail("sfloatAdd", value, b, sfloatAdd(value, b), checkAdd(value, b));
+			if (checkClass(b)==CHECK_FINITE && !checkSame(sfloatSub(value, b), checkEncodeSub(value, b)))
+				checkFail("sfloatSub", value, b, sfloatSub(value, b), checkEncodeSub(value, b));
+			checks++;
+		}
+	}
+	printf("65536 encodings match, %ld pairs compared and added\n", checks);
+	free(pOperands);
+	return 0;
+}